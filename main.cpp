@@ -1,10 +1,18 @@
 #include "src/emulator.hpp"
 #include "src/assembler.hpp"
+#include "src/batch_runner.hpp"
+#include "src/cpu/lockstep_engine.hpp"
+#include "src/instance_pack.hpp"
+#include "src/profile_report.hpp"
+#include "src/cache_report.hpp"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <string>
 #include <vector>
+#include <chrono>
+#include <iomanip>
+#include <map>
 
 // Helper function to read file
 std::string read_file(const std::string& filename) {
@@ -17,45 +25,694 @@ std::string read_file(const std::string& filename) {
     return buffer.str();
 }
 
+// Run once from the start snapshot and report host throughput
+void run_timed(emulator::CPUEmulator& emu, const emulator::Snapshot& start_state, const std::string& label,
+               uint64_t max_cycles) {
+    emu.restore(start_state);
+    // Every run reads the same input from the top (files only; a pipe carries on)
+    cpu::ConsoleInput* input = emu.get_input();
+    if (input) input->rewind();
+    
+    uint64_t bytes_before = emu.get_console().get_bytes();
+    uint64_t dma_bytes_before = emu.get_dma().get_bytes();
+    uint64_t dma_cycles_before = emu.get_dma().get_cycles();
+    auto start = std::chrono::steady_clock::now();
+    emu.run_for(max_cycles);
+    auto end = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(end - start).count();
+    uint64_t cycles = emu.get_cycle_count();
+    uint64_t bytes = emu.get_console().get_bytes() - bytes_before;
+    uint64_t input_bytes = input ? input->get_consumed() : 0;
+    uint64_t dma_bytes = emu.get_dma().get_bytes() - dma_bytes_before;
+    uint64_t dma_cycles = emu.get_dma().get_cycles() - dma_cycles_before;
+    
+    std::cout << std::left << std::setw(12) << label << std::right
+              << " instructions: " << cycles
+              << "  time: " << std::fixed << std::setprecision(3) << seconds << " s";
+    if (seconds > 0) {
+        std::cout << "  MIPS: " << std::setprecision(1) << (cycles / seconds / 1e6)
+                  << "  ns/instr: " << std::setprecision(2) << (seconds * 1e9 / cycles);
+        if (bytes > 0) {
+            std::cout << "  output: " << bytes << " bytes, " << std::setprecision(1)
+                      << (bytes / seconds / 1e6) << " MB/s";
+        }
+        if (input_bytes > 0) {
+            std::cout << "  input: " << input_bytes << " bytes, " << std::setprecision(1)
+                      << (input_bytes / seconds / 1e6) << " MB/s";
+        }
+    }
+    // Modeled DMA time is not part of the instruction count
+    if (dma_bytes > 0) std::cout << "  DMA: " << dma_bytes << " bytes, " << dma_cycles << " cycles charged";
+    std::cout << std::defaultfloat << std::endl;
+}
+
+// Run the program to completion once per engine and report host throughput
+// Each run restores the freshly loaded image so engines see identical work.
+// The switch engine is measured with both eager and lazy flags.
+void run_benchmark(emulator::CPUEmulator& emu, const std::vector<uint16_t>& program,
+                   const std::vector<cpu::Engine>& engines, uint64_t max_cycles) {
+    cpu::Engine selected = emu.get_engine();
+    bool lazy = emu.get_lazy_flags();
+    emu.reset();
+    emu.load_program(program);
+    emulator::Snapshot start_state = emu.snapshot();
+    std::cout << "\n=== Benchmark ===" << std::endl;
+    // Recording, profiling and the timing models always run the switch
+    // interpreter, so one row covers them
+    if (emu.is_trace_file_open() || emu.is_profiling() || emu.is_mapping_heat() || emu.is_timing_pipeline() ||
+        emu.is_predicting_branches() || emu.is_caching()) {
+        run_timed(emu, start_state, emu.is_trace_file_open() ? "recorded" : "profiled", max_cycles);
+        emu.print_stats();
+        return;
+    }
+    for (cpu::Engine engine : engines) {
+        emu.set_engine(engine);
+        emu.set_lazy_flags(false);
+        run_timed(emu, start_state, cpu::engine_name(engine), max_cycles);
+        if (engine == cpu::Engine::SWITCH) {
+            emu.set_lazy_flags(true);
+            run_timed(emu, start_state, std::string(cpu::engine_name(engine)) + "-lazy", max_cycles);
+        }
+    }
+    emu.set_engine(selected);
+    emu.set_lazy_flags(lazy);
+    emu.print_stats();
+}
+
+// Print the profile against the loaded program's labels and source lines,
+// and write it as JSON too if json_path is set
+void report_profile(const emulator::CPUEmulator& emu, const assembler::Assembler& assembler, size_t top,
+                    const std::string& json_path) {
+    const cpu::Profiler* profiler = emu.get_profiler();
+    if (!profiler) {
+        std::cout << "No profile. Use 'profile on' or --profile first." << std::endl;
+        return;
+    }
+    emulator::ProfileReport report(*profiler, assembler.get_labels(), assembler.get_source_lines());
+    report.print(top);
+    if (json_path.empty()) return;
+    try {
+        report.write_json(json_path);
+        std::cout << "Profile written to " << json_path << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
+
+// Print both caches' miss rates, then misses by label and instruction
+void report_caches(const emulator::CPUEmulator& emu, const assembler::Assembler& assembler, size_t top) {
+    const cpu::CacheSystem* caches = emu.get_caches();
+    if (!caches) {
+        std::cout << "No caches. Use 'cache on' or --cache first." << std::endl;
+        return;
+    }
+    caches->print_summary();
+    emulator::CacheReport(*caches, assembler.get_labels(), assembler.get_source_lines()).print(top);
+}
+
+// Print the heat map, and write it as JSON too if json_path is set
+void report_heat_map(const emulator::CPUEmulator& emu, size_t top, const std::string& json_path) {
+    if (!emu.get_heat_map()) {
+        std::cout << "No heat map. Use 'heat on' or --heat first." << std::endl;
+        return;
+    }
+    emu.print_heat_map(top);
+    if (json_path.empty()) return;
+    try {
+        emu.write_heat_map(json_path);
+        std::cout << "Heat map written to " << json_path << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
+
+// 'ram save <file> [addr len] [changed]' and 'ram load <file>'
+void image_command(emulator::CPUEmulator& emu, const std::string& verb, std::stringstream& ss) {
+    std::string filename;
+    ss >> filename;
+    if (filename.empty()) {
+        std::cout << "Usage: ram save <file> [addr len] [changed] | ram load <file>" << std::endl;
+        return;
+    }
+    try {
+        auto start = std::chrono::steady_clock::now();
+        cpu::ImageFile::Summary summary;
+        if (verb == "save") {
+            uint32_t addr = 0;
+            uint32_t len = cpu::Memory::MEMORY_SIZE;
+            bool changed = false;
+            std::vector<std::string> words;
+            std::string word;
+            while (ss >> word) {
+                if (word == "changed") {
+                    changed = true;
+                } else {
+                    words.push_back(word);
+                }
+            }
+            if (words.size() >= 1) addr = static_cast<uint32_t>(std::stoul(words[0], nullptr, 0));
+            if (words.size() >= 2) len = static_cast<uint32_t>(std::stoul(words[1], nullptr, 0));
+            summary = emu.memory_dump(filename, addr, len, changed);
+        } else {
+            summary = emu.memory_load(filename);
+        }
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        std::cout << (verb == "save" ? "Saved " : "Loaded ") << summary.pages
+                  << (summary.changed_only ? " changed" : "") << " pages (" << summary.file_bytes << " bytes"
+                  << (summary.mapped ? ", mapped" : "") << ") in " << std::fixed << std::setprecision(1) << us
+                  << " us" << std::defaultfloat << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+    }
+}
+
+// Byte count with an optional K or M suffix ("16k", "4M")
+size_t parse_size(const std::string& text) {
+    size_t used = 0;
+    size_t value = std::stoul(text, &used);
+    std::string suffix = text.substr(used);
+    if (suffix == "k" || suffix == "K") return value << 10;
+    if (suffix == "m" || suffix == "M") return value << 20;
+    if (!suffix.empty()) throw std::invalid_argument("bad size suffix: " + suffix);
+    return value;
+}
+
+// Limits applied to 'run' (from --max-cycles and --timeout-ms)
+struct RunLimits {
+    uint64_t max_cycles = UINT64_MAX;
+    uint64_t timeout_ms = 0;  // 0 = no wall-clock limit
+};
+
+emulator::RunResult run_limited(emulator::CPUEmulator& emu, const RunLimits& limits) {
+    if (limits.timeout_ms == 0) return emu.run_for(limits.max_cycles);
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.timeout_ms);
+    return emu.run_until_deadline(deadline, limits.max_cycles);
+}
+
+// Report why a bounded run stopped, unless it simply halted
+void report_stop(const emulator::CPUEmulator& emu, const emulator::RunResult& result) {
+    if (result.reason == emulator::StopReason::HALTED) return;
+    std::cout << "Stopped: " << emulator::stop_reason_name(result.reason) << " after "
+              << result.instructions << " instructions at PC 0x" << std::hex << std::setw(4)
+              << std::setfill('0') << emu.get_pc() << std::dec << std::setfill(' ') << std::endl;
+}
+
+// Parse a number with an optional 0x prefix
+uint64_t parse_number(const std::string& text) {
+    if (text.substr(0, 2) == "0x") return std::stoull(text.substr(2), nullptr, 16);
+    return std::stoull(text);
+}
+
+// Read a batch manifest: one job per line,
+//   <file.asm> [repeat=<n>] [max-cycles=<n>] [<addr>=<value>]...
+// where each <addr>=<value> stores a word before the job runs. Blank lines
+// and lines starting with '#' are ignored.
+std::vector<emulator::BatchJob> load_batch(const std::string& manifest, uint64_t default_budget) {
+    std::vector<emulator::BatchJob> jobs;
+    std::map<std::string, std::vector<uint16_t>> programs;  // Assemble each file once
+    std::stringstream lines(read_file(manifest));
+    std::string line;
+    int line_number = 0;
+    while (std::getline(lines, line)) {
+        line_number++;
+        std::stringstream ss(line);
+        std::string path;
+        if (!(ss >> path) || path[0] == '#') continue;
+        
+        emulator::BatchJob job;
+        job.name = path;
+        job.max_cycles = default_budget;
+        uint64_t repeat = 1;
+        std::string field;
+        try {
+            while (ss >> field) {
+                size_t eq = field.find('=');
+                if (eq == std::string::npos) throw std::invalid_argument(field);
+                std::string key = field.substr(0, eq);
+                uint64_t value = parse_number(field.substr(eq + 1));
+                if (key == "repeat") {
+                    repeat = value;
+                } else if (key == "max-cycles") {
+                    job.max_cycles = value;
+                } else {
+                    job.inputs.push_back({static_cast<uint16_t>(parse_number(key)),
+                                          static_cast<uint16_t>(value)});
+                }
+            }
+        } catch (const std::exception&) {
+            throw std::runtime_error(manifest + ":" + std::to_string(line_number) + ": bad field: " + field);
+        }
+        
+        auto it = programs.find(path);
+        if (it == programs.end()) {
+            assembler::Assembler batch_assembler;
+            it = programs.emplace(path, batch_assembler.assemble(read_file(path))).first;
+        }
+        job.program = it->second;
+        for (uint64_t i = 0; i < repeat; i++) jobs.push_back(job);
+    }
+    return jobs;
+}
+
+// Per-instance input: R<n>=<start>[:<step>] or <addr>=<start>[:<step>] gives
+// instance i the value start + i * step (step defaults to 1)
+struct SweepSpec {
+    bool is_register = false;
+    int reg = 0;
+    uint16_t address = 0;
+    int64_t start = 0;
+    int64_t step = 1;
+
+    uint16_t value(size_t index) const {
+        return static_cast<uint16_t>(start + static_cast<int64_t>(index) * step);
+    }
+};
+
+SweepSpec parse_sweep_spec(const std::string& spec) {
+    size_t eq = spec.find('=');
+    if (eq == std::string::npos) throw std::runtime_error("bad sweep spec: " + spec);
+    std::string target = spec.substr(0, eq);
+    std::string range = spec.substr(eq + 1);
+    size_t colon = range.find(':');
+    SweepSpec parsed;
+    try {
+        parsed.start = static_cast<int64_t>(parse_number(range.substr(0, colon)));
+        if (colon != std::string::npos) parsed.step = std::stoll(range.substr(colon + 1));
+    } catch (const std::exception&) {
+        throw std::runtime_error("bad sweep spec: " + spec);
+    }
+    parsed.is_register = (target.size() == 2 && (target[0] == 'R' || target[0] == 'r') &&
+                          target[1] >= '0' && target[1] <= '7');
+    if (parsed.is_register) {
+        parsed.reg = target[1] - '0';
+    } else {
+        try {
+            parsed.address = static_cast<uint16_t>(parse_number(target));
+        } catch (const std::exception&) {
+            throw std::runtime_error("bad sweep spec: " + spec);
+        }
+    }
+    return parsed;
+}
+
+// Run the program in lockstep on many lanes with per-lane inputs
+void run_sweep(const std::vector<uint16_t>& program, const std::vector<std::string>& specs,
+               size_t lane_count, cpu::Engine scalar_engine, uint64_t max_cycles) {
+    cpu::LockstepEngine lockstep(lane_count);
+    lockstep.load_program(program);
+    lockstep.set_scalar_engine(scalar_engine);
+    for (const auto& text : specs) {
+        SweepSpec spec = parse_sweep_spec(text);
+        for (size_t lane = 0; lane < lane_count; lane++) {
+            if (spec.is_register) {
+                lockstep.set_register(lane, spec.reg, static_cast<int16_t>(spec.value(lane)));
+            } else {
+                lockstep.write_word(lane, spec.address, spec.value(lane));
+            }
+        }
+    }
+    lockstep.run(max_cycles);
+    lockstep.print_report();
+}
+
+// Pack many instances onto one shared program image and run them all
+void run_pack(const std::vector<uint16_t>& program, const std::vector<std::string>& specs,
+              size_t count, const emulator::CPUEmulator& settings, uint64_t max_cycles) {
+    emulator::InstancePack pack(program, count);
+    pack.set_engine(settings.get_engine());
+    pack.set_lazy_flags(settings.get_lazy_flags());
+    for (const auto& text : specs) {
+        SweepSpec spec = parse_sweep_spec(text);
+        for (size_t i = 0; i < count; i++) {
+            if (spec.is_register) {
+                pack.set_register(i, spec.reg, static_cast<int16_t>(spec.value(i)));
+            } else {
+                pack.write_word(i, spec.address, spec.value(i));
+            }
+        }
+    }
+    pack.run(max_cycles);
+    pack.print_report();
+}
+
 // Interactive command interface
 void print_help() {
     std::cout << "\n=== CPU Emulator Commands ===" << std::endl;
     std::cout << "load <file>     - Load and assemble program from file" << std::endl;
     std::cout << "run             - Run program until halt" << std::endl;
     std::cout << "step            - Execute one instruction" << std::endl;
+    std::cout << "until <addr>    - Run until PC reaches addr, HLT, or the cycle limit" << std::endl;
     std::cout << "gpr             - Print General Purpose Registers" << std::endl;
     std::cout << "spr             - Print Special Purpose Registers" << std::endl;
     std::cout << "ram [addr] [len]- Print RAM dump (default: 0x0000, 256 bytes)" << std::endl;
+    std::cout << "ram save <file> [addr len] [changed] - Write registers and RAM to a binary image" << std::endl;
+    std::cout << "ram load <file> - Map a binary image written by 'ram save'" << std::endl;
+    std::cout << "ram heat [addr] [len] - RAM dump with the heat map's access counts beside each row" << std::endl;
     std::cout << "dec [addr] [cnt]- Print memory as decimal numbers (default: 0x0040, 10 words)" << std::endl;
     std::cout << "state           - Print complete CPU state" << std::endl;
+    std::cout << "stats           - Print engine statistics (decode cache, threaded and block engines)" << std::endl;
+    std::cout << "bench [engine]  - Run program on each engine (or one) and report MIPS" << std::endl;
+    std::cout << "engine [name]   - Show or select engine: switch, threaded, block, jit" << std::endl;
+    std::cout << "fusion [on|off] - Show fusion report, or turn superinstruction fusion on/off" << std::endl;
+    std::cout << "flags [mode]    - Show or select flag evaluation: eager, lazy (switch engine)" << std::endl;
+    std::cout << "validate on/off - Check block/JIT results against the switch interpreter" << std::endl;
     std::cout << "trace on/off    - Enable/disable instruction tracing" << std::endl;
+    std::cout << "trace file <file> [delta] - Record a binary trace (decode with trace_decode); 'trace off' closes it" << std::endl;
+    std::cout << "profile on/off  - Count executions per PC, opcode and jump outcome" << std::endl;
+    std::cout << "profile [n]     - Print the profile by opcode, label and source line (top n, default 10)" << std::endl;
+    std::cout << "profile json <file> - Write the profile as JSON; 'profile clear' zeroes it" << std::endl;
+    std::cout << "heat on/off     - Count fetches and LD/ST accesses per address and the working set" << std::endl;
+    std::cout << "heat [n]        - Print the hottest 16-byte lines and 256-byte pages (top n, default 10)" << std::endl;
+    std::cout << "heat window <n> - Instructions per working-set sample (clears the heat map)" << std::endl;
+    std::cout << "heat json <file> - Write the heat map as JSON; 'heat clear' zeroes it" << std::endl;
+    std::cout << "pipeline on/off - Time instructions on a five-stage pipeline model" << std::endl;
+    std::cout << "pipeline        - Print CPI and the stall breakdown; 'pipeline clear' zeroes it" << std::endl;
+    std::cout << "pipeline set <spec> - Configure the model, e.g. forward=off,branch=3,mem=2,LD=2" << std::endl;
+    std::cout << "predict on/off  - Run branch predictors side by side on the executed JZ/JNZ stream" << std::endl;
+    std::cout << "predict [n]     - Print accuracy and MPKI per predictor and the top n jumps (default 10)" << std::endl;
+    std::cout << "predict set <spec> - Choose predictors, e.g. static,bimodal:12,gshare:12:8,btb:64" << std::endl;
+    std::cout << "cache on/off    - Simulate L1 I- and D-caches on fetch and LD/ST" << std::endl;
+    std::cout << "cache [n]       - Print miss rates by cache, label and instruction (top n, default 10)" << std::endl;
+    std::cout << "cache set <spec> - Configure the caches, e.g. size=2048,line=32,d.ways=4,write=through,miss=20" << std::endl;
+    std::cout << "snapshot        - Save registers, cycle/halt state and memory" << std::endl;
+    std::cout << "restore         - Return to the saved snapshot (copies only dirty pages)" << std::endl;
+    std::cout << "fork            - Run a copy of the machine to halt; this one is unchanged" << std::endl;
     std::cout << "reset           - Reset CPU to initial state" << std::endl;
     std::cout << "help            - Show this help message" << std::endl;
     std::cout << "quit/exit       - Exit emulator" << std::endl;
 }
 
+void print_usage(const char* program_name) {
+    std::cout << "Usage: " << program_name << " [options] [file.asm [run|bench]]" << std::endl;
+    std::cout << "       " << program_name << " [options] batch <manifest>" << std::endl;
+    std::cout << "       " << program_name << " [options] file.asm sweep [R<n>|<addr>=<start>[:<step>]]..." << std::endl;
+    std::cout << "       " << program_name << " [options] file.asm pack [R<n>|<addr>=<start>[:<step>]]..." << std::endl;
+    std::cout << "Options:" << std::endl;
+    std::cout << "  --engine=<name>      Interpreter core: switch (default), threaded, block, jit" << std::endl;
+    std::cout << "  --max-cycles=<n>     Stop run/bench after n instructions (for programs that may not halt)" << std::endl;
+    std::cout << "  --timeout-ms=<n>     Stop run after n milliseconds of wall-clock time" << std::endl;
+    std::cout << "  --no-fusion          Disable superinstruction fusion (block, jit)" << std::endl;
+    std::cout << "  --lazy-flags         Compute condition flags only when read (switch engine)" << std::endl;
+    std::cout << "  --jit-threshold=<n>  Block runs before the JIT compiles a block (default 16)" << std::endl;
+    std::cout << "  --validate-jit       Check every block/JIT block against the switch interpreter" << std::endl;
+    std::cout << "  --threads=<n>        Worker threads for batch (default: one per hardware thread)" << std::endl;
+    std::cout << "  --lanes=<n>          Lockstep lanes for sweep (default 64)" << std::endl;
+    std::cout << "  --console=<file>     Write guest console output to file instead of stdout" << std::endl;
+    std::cout << "  --console-buffer=<n> Console ring buffer bytes; flushes when half full (default 65536)" << std::endl;
+    std::cout << "  --console-flush-ms=<n> Longest guest output waits before a flush (default 50, 0 = off)" << std::endl;
+    std::cout << "  --mmu=<window>[:<store>] Bank-switched windows (4k or 16k) onto a larger store (default 4M)" << std::endl;
+    std::cout << "  --input=<file|->     Feed guest STDIN from a file or pipe ('-' = stdin; no REPL afterwards)" << std::endl;
+    std::cout << "  --input-buffer=<n>   Input ring buffer bytes (default 65536)" << std::endl;
+    std::cout << "  --instances=<n>      Instances sharing one program image for pack (default 100000)" << std::endl;
+    std::cout << "  --trace-file=<file>  Record every instruction to a binary trace (decode with trace_decode)" << std::endl;
+    std::cout << "  --trace-delta        Delta-compress the binary trace" << std::endl;
+    std::cout << "  --profile[=<file>]   Profile execution; run prints the report (and writes it as JSON)" << std::endl;
+    std::cout << "  --heat[=<file>]      Map memory accesses; run prints the report (and writes it as JSON)" << std::endl;
+    std::cout << "  --heat-window=<n>    Instructions per working-set sample (default 65536)" << std::endl;
+    std::cout << "  --pipeline[=<spec>]  Time instructions on a pipeline model; run prints CPI and stalls" << std::endl;
+    std::cout << "  --predict[=<spec>]   Compare branch predictors; the first drives the pipeline model" << std::endl;
+    std::cout << "  --cache[=<spec>]     Simulate L1 I/D caches; run and batch report miss rates" << std::endl;
+}
+
 int main(int argc, char* argv[]) {
     emulator::CPUEmulator emu(false);  // Start with trace off
     assembler::Assembler asm_assembler;
     bool program_loaded = false;
+    std::vector<uint16_t> program;
+    RunLimits limits;
+    unsigned batch_threads = 0;
+    size_t sweep_lanes = 64;
+    size_t pack_instances = 100000;
+    cpu::ConsoleBuffer::Options console_options;
+    std::string input_path;
+    size_t input_buffer = 1 << 16;
+    std::unique_ptr<cpu::ConsoleInput> input;
+    std::string trace_path;
+    bool trace_delta = false;
+    bool profile = false;
+    std::string profile_json;
+    bool heat = false;
+    std::string heat_json;
+    bool pipeline = false;
+    bool predict = false;
+    bool cache = false;
+    std::string cache_spec;
+    emulator::Snapshot saved;
+    bool have_snapshot = false;
+    
+    // Split options from positional arguments (file, action)
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.rfind("--engine=", 0) == 0) {
+            cpu::Engine engine;
+            if (!cpu::parse_engine(arg.substr(9), engine)) {
+                std::cerr << "Error: unknown engine: " << arg.substr(9) << std::endl;
+                return 1;
+            }
+            emu.set_engine(engine);
+        } else if (arg.rfind("--jit-threshold=", 0) == 0) {
+            try {
+                emu.set_jit_threshold(std::stoull(arg.substr(16)));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid JIT threshold: " << arg.substr(16) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--max-cycles=", 0) == 0) {
+            try {
+                limits.max_cycles = std::stoull(arg.substr(13));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid cycle limit: " << arg.substr(13) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--timeout-ms=", 0) == 0) {
+            try {
+                limits.timeout_ms = std::stoull(arg.substr(13));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid timeout: " << arg.substr(13) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--threads=", 0) == 0) {
+            try {
+                batch_threads = static_cast<unsigned>(std::stoul(arg.substr(10)));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid thread count: " << arg.substr(10) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--lanes=", 0) == 0) {
+            try {
+                sweep_lanes = std::stoul(arg.substr(8));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid lane count: " << arg.substr(8) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--instances=", 0) == 0) {
+            try {
+                pack_instances = std::stoul(arg.substr(12));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid instance count: " << arg.substr(12) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--console=", 0) == 0) {
+            console_options.fd = cpu::ConsoleBuffer::open_file(arg.substr(10));
+            if (console_options.fd < 0) {
+                std::cerr << "Error: cannot open console output: " << arg.substr(10) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--console-buffer=", 0) == 0) {
+            try {
+                console_options.capacity = std::stoul(arg.substr(17));
+                console_options.flush_threshold = console_options.capacity / 2;
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid console buffer size: " << arg.substr(17) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--console-flush-ms=", 0) == 0) {
+            try {
+                console_options.flush_interval_ms = std::stoull(arg.substr(19));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid console flush interval: " << arg.substr(19) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--mmu=", 0) == 0) {
+            std::string spec = arg.substr(6);
+            size_t colon = spec.find(':');
+            try {
+                size_t window = parse_size(spec.substr(0, colon));
+                size_t store = colon == std::string::npos ? size_t(4) << 20 : parse_size(spec.substr(colon + 1));
+                emu.enable_mmu(window, store);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: invalid MMU configuration: " << spec << " (" << e.what() << ")" << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--input=", 0) == 0) {
+            input_path = arg.substr(8);
+        } else if (arg.rfind("--input-buffer=", 0) == 0) {
+            try {
+                input_buffer = std::stoul(arg.substr(15));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid input buffer size: " << arg.substr(15) << std::endl;
+                return 1;
+            }
+        } else if (arg.rfind("--trace-file=", 0) == 0) {
+            trace_path = arg.substr(13);
+        } else if (arg == "--trace-delta") {
+            trace_delta = true;
+        } else if (arg == "--heat") {
+            heat = true;
+        } else if (arg.rfind("--heat=", 0) == 0) {
+            heat = true;
+            heat_json = arg.substr(7);
+        } else if (arg.rfind("--heat-window=", 0) == 0) {
+            try {
+                emu.set_heat_window(std::stoull(arg.substr(14)));
+            } catch (const std::exception&) {
+                std::cerr << "Error: invalid heat map window: " << arg.substr(14) << std::endl;
+                return 1;
+            }
+        } else if (arg == "--pipeline") {
+            pipeline = true;
+        } else if (arg.rfind("--pipeline=", 0) == 0) {
+            pipeline = true;
+            try {
+                emu.configure_pipeline(arg.substr(11));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        } else if (arg == "--predict") {
+            predict = true;
+        } else if (arg.rfind("--predict=", 0) == 0) {
+            predict = true;
+            try {
+                emu.configure_branch_predictors(arg.substr(10));
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        } else if (arg == "--cache") {
+            cache = true;
+        } else if (arg.rfind("--cache=", 0) == 0) {
+            cache = true;
+            cache_spec = arg.substr(8);
+            try {
+                emu.configure_caches(cache_spec);
+            } catch (const std::exception& e) {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg.rfind("--profile=", 0) == 0) {
+            profile = true;
+            profile_json = arg.substr(10);
+        } else if (arg == "--no-fusion") {
+            emu.set_fusion(false);
+        } else if (arg == "--lazy-flags") {
+            emu.set_lazy_flags(true);
+        } else if (arg == "--validate-jit") {
+            emu.set_jit_validation(true);
+        } else if (arg == "--help" || arg == "-h") {
+            print_usage(argv[0]);
+            return 0;
+        } else if (arg.rfind("--", 0) == 0) {
+            std::cerr << "Error: unknown option: " << arg << std::endl;
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            args.push_back(arg);
+        }
+    }
+    
+    cpu::ConsoleBuffer::standard().configure(console_options);
+    if (!input_path.empty()) {
+        input = cpu::ConsoleInput::open(input_path, input_buffer);
+        if (!input) {
+            std::cerr << "Error: cannot open input: " << input_path << std::endl;
+            return 1;
+        }
+        emu.set_input(input.get());
+    }
+    emu.set_profiling(profile);
+    emu.set_heat_map(heat);
+    emu.set_pipeline(pipeline);
+    emu.set_branch_prediction(predict);
+    emu.set_caches(cache);
+    if (!trace_path.empty()) {
+        try {
+            emu.start_trace_file(trace_path, trace_delta);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+    }
+    
+    // Batch mode runs the manifest on a thread pool and exits
+    if (!args.empty() && args[0] == "batch") {
+        if (args.size() < 2) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        try {
+            std::vector<emulator::BatchJob> jobs = load_batch(args[1], limits.max_cycles);
+            emulator::BatchOptions options;
+            options.threads = batch_threads;
+            options.engine = emu.get_engine();
+            options.fusion = emu.get_fusion();
+            options.lazy_flags = emu.get_lazy_flags();
+            options.jit_threshold = emu.get_jit_threshold();
+            options.caches = cache;
+            options.cache_spec = cache_spec;
+            emulator::BatchRunner runner(options);
+            std::vector<emulator::BatchResult> results = runner.run(jobs);
+            runner.print_report(jobs, results);
+        } catch (const std::exception& e) {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
     
     std::cout << "=== Simple CPU Emulator ===" << std::endl;
     std::cout << "Type 'help' for commands" << std::endl;
     
     // If file provided as argument, load it
-    if (argc > 1) {
+    if (!args.empty()) {
         try {
-            std::string source = read_file(argv[1]);
-            auto program = asm_assembler.assemble(source);
+            std::string source = read_file(args[0]);
+            program = asm_assembler.assemble(source);
             emu.load_program(program);
             program_loaded = true;
             std::cout << "Program loaded: " << program.size() << " instructions" << std::endl;
             
             // If second argument is "run", execute immediately
-            if (argc > 2 && std::string(argv[2]) == "run") {
+            if (args.size() > 1 && args[1] == "run") {
                 emu.enable_trace(false);
-                emu.run();
+                report_stop(emu, run_limited(emu, limits));
                 emu.print_state();
+                if (profile) report_profile(emu, asm_assembler, 10, profile_json);
+                if (heat) report_heat_map(emu, 10, heat_json);
+                if (predict) emu.print_branch_prediction();
+                if (cache) report_caches(emu, asm_assembler, 10);
+                if (pipeline) emu.print_pipeline();
+            } else if (args.size() > 1 && args[1] == "bench") {
+                emu.enable_trace(false);
+                run_benchmark(emu, program, std::vector<cpu::Engine>(std::begin(cpu::ALL_ENGINES),
+                                                                     std::end(cpu::ALL_ENGINES)),
+                              limits.max_cycles);
+            } else if (args.size() > 1 && args[1] == "sweep") {
+                run_sweep(program, std::vector<std::string>(args.begin() + 2, args.end()),
+                          sweep_lanes, emu.get_engine(), limits.max_cycles);
+                return 0;
+            } else if (args.size() > 1 && args[1] == "pack") {
+                run_pack(program, std::vector<std::string>(args.begin() + 2, args.end()),
+                         pack_instances, emu, limits.max_cycles);
+                return 0;
+            }
+            // Standard input belongs to the guest, so there is no REPL to read
+            if (input_path == "-" && args.size() > 1) {
+                emu.stop_trace_file();
+                return 0;
             }
         } catch (const std::exception& e) {
             std::cerr << "Error: " << e.what() << std::endl;
@@ -88,7 +745,7 @@ int main(int argc, char* argv[]) {
             }
             try {
                 std::string source = read_file(filename);
-                auto program = asm_assembler.assemble(source);
+                program = asm_assembler.assemble(source);
                 emu.load_program(program);
                 program_loaded = true;
                 std::cout << "Program loaded: " << program.size() << " instructions" << std::endl;
@@ -110,8 +767,28 @@ int main(int argc, char* argv[]) {
                 std::cout << "No program loaded. Use 'load <file>' first." << std::endl;
                 continue;
             }
-            emu.run();
+            report_stop(emu, run_limited(emu, limits));
             emu.print_state();
+        } else if (cmd == "until") {
+            if (!program_loaded) {
+                std::cout << "No program loaded. Use 'load <file>' first." << std::endl;
+                continue;
+            }
+            std::string addr_str;
+            ss >> addr_str;
+            if (addr_str.empty()) {
+                std::cout << "Usage: until <addr>" << std::endl;
+                continue;
+            }
+            uint16_t addr;
+            if (addr_str.substr(0, 2) == "0x") {
+                addr = static_cast<uint16_t>(std::stoul(addr_str, nullptr, 16));
+            } else {
+                addr = static_cast<uint16_t>(std::stoul(addr_str));
+            }
+            emulator::RunResult result = emu.run_until(addr, limits.max_cycles);
+            report_stop(emu, result);
+            if (result.reason == emulator::StopReason::HALTED) emu.print_state();
         } else if (cmd == "step") {
             if (!program_loaded) {
                 std::cout << "No program loaded. Use 'load <file>' first." << std::endl;
@@ -131,7 +808,22 @@ int main(int argc, char* argv[]) {
             uint16_t addr = 0x0000;
             uint16_t len = 256;
             std::string addr_str, len_str;
-            ss >> addr_str >> len_str;
+            ss >> addr_str;
+            if (addr_str == "save" || addr_str == "load") {
+                image_command(emu, addr_str, ss);
+                if (addr_str == "load") program_loaded = true;
+                continue;
+            }
+            bool heat = addr_str == "heat";
+            if (heat) {
+                if (!emu.get_heat_map()) {
+                    std::cout << "No heat map. Use 'heat on' or --heat first." << std::endl;
+                    continue;
+                }
+                addr_str.clear();
+                ss >> addr_str;
+            }
+            ss >> len_str;
             if (!addr_str.empty()) {
                 if (addr_str.substr(0, 2) == "0x") {
                     addr = static_cast<uint16_t>(std::stoul(addr_str, nullptr, 16));
@@ -142,7 +834,11 @@ int main(int argc, char* argv[]) {
             if (!len_str.empty()) {
                 len = static_cast<uint16_t>(std::stoul(len_str));
             }
-            emu.print_ram(addr, len);
+            if (heat) {
+                emu.print_ram_heat(addr, len);
+            } else {
+                emu.print_ram(addr, len);
+            }
         } else if (cmd == "dec" || cmd == "decimal" || cmd == "print") {
             uint16_t addr = 0x0040;  // Default to Fibonacci storage address
             uint16_t count = 10;      // Default to 10 numbers
@@ -161,6 +857,73 @@ int main(int argc, char* argv[]) {
             emu.print_decimal(addr, count);
         } else if (cmd == "state") {
             emu.print_state();
+        } else if (cmd == "stats") {
+            emu.print_stats();
+        } else if (cmd == "bench") {
+            if (!program_loaded) {
+                std::cout << "No program loaded. Use 'load <file>' first." << std::endl;
+                continue;
+            }
+            std::vector<cpu::Engine> engines(std::begin(cpu::ALL_ENGINES), std::end(cpu::ALL_ENGINES));
+            std::string name;
+            ss >> name;
+            if (!name.empty()) {
+                cpu::Engine engine;
+                if (!cpu::parse_engine(name, engine)) {
+                    std::cout << "Unknown engine: " << name << std::endl;
+                    continue;
+                }
+                engines = {engine};
+            }
+            run_benchmark(emu, program, engines, limits.max_cycles);
+        } else if (cmd == "engine") {
+            std::string name;
+            ss >> name;
+            if (name.empty()) {
+                std::cout << "Engine: " << cpu::engine_name(emu.get_engine()) << std::endl;
+            } else {
+                cpu::Engine engine;
+                if (cpu::parse_engine(name, engine)) {
+                    emu.set_engine(engine);
+                    std::cout << "Engine set to " << cpu::engine_name(engine) << std::endl;
+                } else {
+                    std::cout << "Usage: engine switch|threaded|block|jit" << std::endl;
+                }
+            }
+        } else if (cmd == "fusion") {
+            std::string on_off;
+            ss >> on_off;
+            if (on_off.empty()) {
+                emu.print_fusion_report();
+            } else if (on_off == "on" || on_off == "off") {
+                emu.set_fusion(on_off == "on");
+                std::cout << "Fusion " << (on_off == "on" ? "enabled" : "disabled") << std::endl;
+            } else {
+                std::cout << "Usage: fusion [on|off]" << std::endl;
+            }
+        } else if (cmd == "flags") {
+            std::string mode;
+            ss >> mode;
+            if (mode.empty()) {
+                std::cout << "Flags: " << (emu.get_lazy_flags() ? "lazy" : "eager") << std::endl;
+            } else if (mode == "lazy" || mode == "eager") {
+                emu.set_lazy_flags(mode == "lazy");
+                std::cout << "Flag evaluation set to " << mode << std::endl;
+            } else {
+                std::cout << "Usage: flags eager|lazy" << std::endl;
+            }
+        } else if (cmd == "validate") {
+            std::string on_off;
+            ss >> on_off;
+            if (on_off == "on") {
+                emu.set_jit_validation(true);
+                std::cout << "JIT validation enabled" << std::endl;
+            } else if (on_off == "off") {
+                emu.set_jit_validation(false);
+                std::cout << "JIT validation disabled" << std::endl;
+            } else {
+                std::cout << "Usage: validate on|off" << std::endl;
+            }
         } else if (cmd == "trace") {
             std::string on_off;
             ss >> on_off;
@@ -169,10 +932,220 @@ int main(int argc, char* argv[]) {
                 std::cout << "Trace enabled" << std::endl;
             } else if (on_off == "off") {
                 emu.enable_trace(false);
+                emu.stop_trace_file();
                 std::cout << "Trace disabled" << std::endl;
+            } else if (on_off == "file") {
+                std::string path, mode;
+                ss >> path >> mode;
+                if (path.empty() || (!mode.empty() && mode != "delta")) {
+                    std::cout << "Usage: trace file <file> [delta]" << std::endl;
+                    continue;
+                }
+                try {
+                    emu.start_trace_file(path, mode == "delta");
+                    std::cout << "Recording binary trace to " << path << (mode.empty() ? "" : " (delta)") << std::endl;
+                } catch (const std::exception& e) {
+                    std::cout << "Error: " << e.what() << std::endl;
+                }
+            } else {
+                std::cout << "Usage: trace on|off | trace file <file> [delta]" << std::endl;
+            }
+        } else if (cmd == "profile") {
+            std::string arg;
+            ss >> arg;
+            if (arg == "on") {
+                emu.set_profiling(true);
+                std::cout << "Profiling enabled" << std::endl;
+            } else if (arg == "off") {
+                emu.set_profiling(false);
+                std::cout << "Profiling disabled (counts kept)" << std::endl;
+            } else if (arg == "clear") {
+                emu.clear_profile();
+                std::cout << "Profile cleared" << std::endl;
+            } else if (arg == "json") {
+                std::string path;
+                ss >> path;
+                if (path.empty()) {
+                    std::cout << "Usage: profile json <file>" << std::endl;
+                    continue;
+                }
+                report_profile(emu, asm_assembler, 10, path);
             } else {
-                std::cout << "Usage: trace on|off" << std::endl;
+                size_t top = 10;
+                try {
+                    if (!arg.empty()) top = std::stoul(arg);
+                } catch (const std::exception&) {
+                    std::cout << "Usage: profile [on|off|clear|json <file>|<n>]" << std::endl;
+                    continue;
+                }
+                report_profile(emu, asm_assembler, top, "");
+            }
+        } else if (cmd == "heat") {
+            std::string arg;
+            ss >> arg;
+            if (arg == "on") {
+                emu.set_heat_map(true);
+                std::cout << "Heat map enabled" << std::endl;
+            } else if (arg == "off") {
+                emu.set_heat_map(false);
+                std::cout << "Heat map disabled (counts kept)" << std::endl;
+            } else if (arg == "clear") {
+                emu.clear_heat_map();
+                std::cout << "Heat map cleared" << std::endl;
+            } else if (arg == "window") {
+                std::string count;
+                ss >> count;
+                try {
+                    emu.set_heat_window(std::stoull(count));
+                    std::cout << "Working set sampled every " << emu.get_heat_map()->get_window() << " instructions"
+                              << std::endl;
+                } catch (const std::exception&) {
+                    std::cout << "Usage: heat window <instructions>" << std::endl;
+                }
+            } else if (arg == "json") {
+                std::string path;
+                ss >> path;
+                if (path.empty()) {
+                    std::cout << "Usage: heat json <file>" << std::endl;
+                    continue;
+                }
+                report_heat_map(emu, 10, path);
+            } else {
+                size_t top = 10;
+                try {
+                    if (!arg.empty()) top = std::stoul(arg);
+                } catch (const std::exception&) {
+                    std::cout << "Usage: heat [on|off|clear|window <n>|json <file>|<n>]" << std::endl;
+                    continue;
+                }
+                report_heat_map(emu, top, "");
+            }
+        } else if (cmd == "pipeline") {
+            std::string arg;
+            ss >> arg;
+            if (arg == "on") {
+                emu.set_pipeline(true);
+                std::cout << "Pipeline model enabled: " << emu.get_pipeline()->describe() << std::endl;
+            } else if (arg == "off") {
+                emu.set_pipeline(false);
+                std::cout << "Pipeline model disabled (counts kept)" << std::endl;
+            } else if (arg == "clear") {
+                emu.clear_pipeline();
+                std::cout << "Pipeline model cleared" << std::endl;
+            } else if (arg == "set") {
+                std::string spec;
+                ss >> spec;
+                try {
+                    emu.configure_pipeline(spec);
+                    std::cout << "Pipeline model: " << emu.get_pipeline()->describe() << std::endl;
+                } catch (const std::exception& e) {
+                    std::cout << "Error: " << e.what() << std::endl;
+                }
+            } else if (arg.empty()) {
+                if (!emu.get_pipeline()) {
+                    std::cout << "No pipeline model. Use 'pipeline on' or --pipeline first." << std::endl;
+                    continue;
+                }
+                emu.print_pipeline();
+            } else {
+                std::cout << "Usage: pipeline [on|off|clear|set <spec>]" << std::endl;
+            }
+        } else if (cmd == "predict") {
+            std::string arg;
+            ss >> arg;
+            if (arg == "on") {
+                emu.set_branch_prediction(true);
+                std::cout << "Branch prediction enabled" << std::endl;
+            } else if (arg == "off") {
+                emu.set_branch_prediction(false);
+                std::cout << "Branch prediction disabled (counts kept)" << std::endl;
+            } else if (arg == "clear") {
+                emu.clear_branch_prediction();
+                std::cout << "Branch predictors cleared" << std::endl;
+            } else if (arg == "set") {
+                std::string spec;
+                ss >> spec;
+                try {
+                    emu.configure_branch_predictors(spec);
+                    const cpu::BranchPredictorSet* set = emu.get_branch_predictors();
+                    std::cout << "Branch predictors:";
+                    for (size_t i = 0; i < set->size(); i++) std::cout << " " << set->name(i);
+                    std::cout << std::endl;
+                } catch (const std::exception& e) {
+                    std::cout << "Error: " << e.what() << std::endl;
+                }
+            } else {
+                size_t top = 10;
+                try {
+                    if (!arg.empty()) top = std::stoul(arg);
+                } catch (const std::exception&) {
+                    std::cout << "Usage: predict [on|off|clear|set <spec>|<n>]" << std::endl;
+                    continue;
+                }
+                if (!emu.get_branch_predictors()) {
+                    std::cout << "No branch predictors. Use 'predict on' or --predict first." << std::endl;
+                    continue;
+                }
+                emu.print_branch_prediction(top);
+            }
+        } else if (cmd == "cache") {
+            std::string arg;
+            ss >> arg;
+            if (arg == "on") {
+                emu.set_caches(true);
+                std::cout << "Caches enabled" << std::endl;
+            } else if (arg == "off") {
+                emu.set_caches(false);
+                std::cout << "Caches disabled (counts kept)" << std::endl;
+            } else if (arg == "clear") {
+                emu.clear_caches();
+                std::cout << "Caches emptied" << std::endl;
+            } else if (arg == "set") {
+                std::string spec;
+                ss >> spec;
+                try {
+                    emu.configure_caches(spec);
+                    std::cout << "I-cache: " << emu.get_caches()->get_icache().describe() << std::endl;
+                    std::cout << "D-cache: " << emu.get_caches()->get_dcache().describe() << std::endl;
+                } catch (const std::exception& e) {
+                    std::cout << "Error: " << e.what() << std::endl;
+                }
+            } else {
+                size_t top = 10;
+                try {
+                    if (!arg.empty()) top = std::stoul(arg);
+                } catch (const std::exception&) {
+                    std::cout << "Usage: cache [on|off|clear|set <spec>|<n>]" << std::endl;
+                    continue;
+                }
+                report_caches(emu, asm_assembler, top);
+            }
+        } else if (cmd == "snapshot") {
+            auto start = std::chrono::steady_clock::now();
+            saved = emu.snapshot();
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            have_snapshot = true;
+            std::cout << "Snapshot taken at cycle " << saved.cycle_count << " (" << std::fixed
+                      << std::setprecision(1) << us << " us)" << std::defaultfloat << std::endl;
+        } else if (cmd == "restore") {
+            if (!have_snapshot) {
+                std::cout << "No snapshot. Use 'snapshot' first." << std::endl;
+                continue;
+            }
+            auto start = std::chrono::steady_clock::now();
+            size_t pages = emu.restore(saved);
+            double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+            std::cout << "Restored cycle " << saved.cycle_count << ": " << pages << " dirty pages copied ("
+                      << std::fixed << std::setprecision(1) << us << " us)" << std::defaultfloat << std::endl;
+        } else if (cmd == "fork") {
+            if (!program_loaded) {
+                std::cout << "No program loaded. Use 'load <file>' first." << std::endl;
+                continue;
             }
+            std::unique_ptr<emulator::CPUEmulator> child = emu.fork();
+            std::cout << "=== Forked child ===" << std::endl;
+            report_stop(*child, run_limited(*child, limits));
+            child->print_state();
         } else if (cmd == "reset") {
             emu.reset();
             std::cout << "CPU reset" << std::endl;
@@ -181,6 +1154,7 @@ int main(int argc, char* argv[]) {
         }
     }
     
+    emu.stop_trace_file();
     return 0;
 }
 
@@ -0,0 +1,53 @@
+; Banked memory demo
+; Fills 48 banks (192KB, three times the address space) through the 4KB
+; window at 0x4000, then sums every word of every bank. Bank n holds 2048
+; copies of n, so R0 ends as 2048 * (1 + ... + 48) mod 65536 = 0xC000.
+; Without an MMU every bank is the same RAM and R0 ends as 0x8000.
+;   ./cpu_emulator --mmu=4k programs/banked_sum.asm run
+
+start:
+    ; Build I/O address 0xFF00 in R6: 0xFFFF XOR 0x00FF
+    LDI R7, #0         ; Zero register for relative jumps
+    NOT R6, R7         ; R6 = 0xFFFF
+    LDI R5, #1
+    SHL R4, R5, #8     ; R4 = 256
+    SUB R4, R4, R5     ; R4 = 0x00FF
+    XOR R6, R6, R4     ; R6 = 0xFF00
+    LDI R4, #2         ; Word stride
+    LDI R3, #24
+    ADD R3, R3, R3     ; 48 banks, filled from the top
+
+fill:
+    ST R3, R6, #24     ; Window 4 (0x4000) select register at 0xFF18
+    LDI R1, #1
+    SHL R1, R1, #14    ; R1 = 0x4000
+    SHL R2, R5, #11    ; 2048 words
+
+fill_word:
+    ST R3, R1, #0
+    ADD R1, R1, R4
+    SUB R2, R2, R5
+    JNZ R7, fill_word
+    SUB R3, R3, R5
+    JNZ R7, fill
+
+    LDI R0, #0
+    LDI R3, #24
+    ADD R3, R3, R3
+
+sum:
+    ST R3, R6, #24
+    LDI R1, #1
+    SHL R1, R1, #14
+    SHL R2, R5, #11
+
+sum_word:
+    LD R4, R1, #0
+    ADD R0, R0, R4
+    ADD R1, R1, R5
+    ADD R1, R1, R5
+    SUB R2, R2, R5
+    JNZ R7, sum_word
+    SUB R3, R3, R5
+    JNZ R7, sum
+    HLT
@@ -0,0 +1,30 @@
+; Benchmark loop
+; Runs the Fibonacci inner loop 4096 x 4096 times (~117M instructions)
+; so engine throughput (MIPS) can be measured on a long-running guest
+
+start:
+    LDI R5, #1         ; Counter decrement
+    LDI R7, #0         ; Zero register for relative jumps
+    LDI R2, #31
+    SHL R2, R2, #2     ; R2 = 124 = 0x007C, scratch store address
+    LDI R4, #1
+    SHL R4, R4, #12    ; Outer counter = 4096
+
+outer:
+    LDI R3, #1
+    SHL R3, R3, #12    ; Inner counter = 4096
+    LDI R0, #0         ; F(0)
+    LDI R1, #1         ; F(1)
+
+inner:
+    ADD R6, R0, R1     ; F(n) = F(n-1) + F(n-2)
+    ST R6, R2, #0      ; Store F(n)
+    LDI R0, #0         ; F(n-2) = F(n-1)
+    ADD R0, R1, R0
+    LDI R1, #0         ; F(n-1) = F(n)
+    ADD R1, R6, R1
+    SUB R3, R3, R5     ; Decrement inner counter
+    JNZ R7, inner      ; Loop while counter != 0
+    SUB R4, R4, R5     ; Decrement outer counter
+    JNZ R7, outer
+    HLT
@@ -0,0 +1,31 @@
+; Collatz sequence length
+; Counts the steps (R2) for the start value in R1 to reach 1. Meant for a
+; lockstep sweep over R1, e.g.: ./cpu_emulator programs/collatz.asm sweep R1=1:1
+; R1 = 0 (no input) is treated as 27.
+
+start:
+    LDI R7, #0         ; Zero register for relative jumps
+    LDI R5, #1         ; Constant 1
+    LDI R2, #0         ; Step counter
+    OR R1, R1, R7      ; Z = (R1 == 0)
+    JNZ R7, loop
+    LDI R1, #27
+
+loop:
+    SUB R6, R1, R5     ; Done when R1 == 1
+    JZ R7, done
+    AND R6, R1, R5     ; Odd?
+    JNZ R7, odd
+    SHR R1, R1, #1     ; Even: n / 2
+    ADD R2, R2, R5
+    JMP R7, loop
+
+odd:
+    ADD R6, R1, R1     ; Odd: 3n + 1
+    ADD R1, R6, R1
+    ADD R1, R1, R5
+    ADD R2, R2, R5
+    JMP R7, loop
+
+done:
+    HLT
@@ -0,0 +1,56 @@
+; DMA demo
+; Clears a 4KB buffer at 0x4000 to '*' with a synchronous fill, copies it to
+; 0x5000 with a timed transfer while counting polls of the DONE bit in R0,
+; then prints the first 32 bytes of the copy. Each transfer is a handful of
+; instructions; a word loop would take about 10000 per buffer.
+;   ./cpu_emulator programs/dma_copy.asm run
+
+start:
+    ; Build I/O address 0xFF00 in R6: 0xFFFF XOR 0x00FF
+    LDI R7, #0         ; Zero register for relative jumps
+    NOT R6, R7         ; R6 = 0xFFFF
+    LDI R5, #1
+    SHL R4, R5, #8     ; R4 = 256
+    SUB R4, R4, R5     ; R4 = 0x00FF
+    XOR R6, R6, R4     ; R6 = 0xFF00
+    LDI R0, #0         ; Polls
+
+    ; Fill: SRC low byte is the value
+    LDI R1, #21
+    ADD R1, R1, R1     ; R1 = 42 = '*'
+    ST R1, R6, #4      ; SRC
+    SHL R2, R5, #14    ; R2 = 0x4000
+    ST R2, R6, #6      ; DST
+    SHL R3, R5, #12    ; R3 = 4096 bytes
+    ST R3, R6, #8      ; LEN
+    LDI R4, #3
+    ST R4, R6, #10     ; CTRL = GO | FILL (done before the store returns)
+
+    ; Timed copy 0x4000 -> 0x5000
+    ST R2, R6, #4      ; SRC
+    LDI R1, #5
+    SHL R1, R1, #12    ; R1 = 0x5000
+    ST R1, R6, #6      ; DST
+    LDI R4, #5
+    ST R4, R6, #10     ; CTRL = GO | TIMED
+    LDI R3, #2         ; DONE bit
+
+wait:
+    ADD R0, R0, R5
+    LD R4, R6, #10     ; CTRL status
+    AND R4, R4, R3
+    JZ R7, wait
+    ST R7, R6, #10     ; Acknowledge: clears DONE
+
+    LDI R3, #16
+    ADD R3, R3, R3     ; 32 bytes to print
+
+print:
+    LD R2, R1, #0
+    ST R2, R6, #0      ; STDOUT takes the low byte
+    ADD R1, R1, R5
+    SUB R3, R3, R5
+    JNZ R7, print
+    LDI R2, #10
+    ST R2, R6, #0
+    HLT
@@ -0,0 +1,31 @@
+; Console throughput loop
+; Prints the alphabet on 32768 lines (~885KB) so guest output speed can be
+; measured, e.g.: ./cpu_emulator --console=/dev/null programs/print_loop.asm bench
+
+start:
+    ; Build I/O address 0xFF00 in R6: 0xFFFF XOR 0x00FF
+    LDI R7, #0         ; Zero register for relative jumps
+    NOT R6, R7         ; R6 = 0xFFFF
+    LDI R5, #1         ; Constant 1
+    SHL R4, R5, #8     ; R4 = 256
+    SUB R4, R4, R5     ; R4 = 0x00FF
+    XOR R6, R6, R4     ; R6 = 0xFF00
+    SHL R4, R5, #15    ; Line counter = 32768
+
+line:
+    LDI R1, #31
+    ADD R1, R1, R1     ; R1 = 62
+    LDI R2, #3
+    ADD R1, R1, R2     ; R1 = 'A'
+    LDI R3, #26        ; Letters per line
+
+letter:
+    ST R1, R6, #0      ; Output the letter
+    ADD R1, R1, R5
+    SUB R3, R3, R5
+    JNZ R7, letter
+    LDI R2, #10
+    ST R2, R6, #0      ; Newline
+    SUB R4, R4, R5
+    JNZ R7, line
+    HLT
@@ -0,0 +1,65 @@
+; Timer interrupt example
+; Counts down from 9 to 0 like timer.asm, but the main loop sleeps in WFI
+; and a periodic timer interrupt prints each digit, 32768 cycles apart.
+; The emulator skips the idle cycles instead of executing them, so the
+; run takes about 100 instructions for over 300000 cycles.
+;   ./cpu_emulator programs/timer_irq.asm run
+
+start:
+    JMP R0, main       ; R0 is 0 at reset; the handler must sit at a known address
+
+; Interrupt handler (vector 0x0002). Entry saved R0-R7, so it works on
+; main's registers freely; R6 = 0xFF00 and R4 = 0xFF30 as main set them.
+isr:
+    LDI R2, #1
+    ST R2, R4, #0      ; Acknowledge the timer line (PENDING, write 1 to clear)
+    LDI R2, #24
+    ADD R2, R2, R2     ; R2 = 48 = '0'
+    ADD R2, R0, R2
+    ST R2, R6, #0      ; Print the digit
+    LDI R2, #10
+    ST R2, R6, #0      ; Newline
+    LDI R2, #1
+    SUB R0, R0, R2
+    ST R0, R4, #16     ; Saved R0: main sees the new count after RTI
+    RTI
+
+main:
+    ; Build I/O address 0xFF00 in R6: 0xFFFF XOR 0x00FF
+    LDI R7, #0         ; Zero register for relative jumps
+    NOT R6, R7         ; R6 = 0xFFFF
+    LDI R5, #1
+    SHL R4, R5, #8     ; R4 = 256
+    SUB R4, R4, R5     ; R4 = 0x00FF
+    XOR R6, R6, R4     ; R6 = 0xFF00
+    LDI R3, #24
+    ADD R3, R3, R3
+    ADD R4, R6, R3     ; R4 = 0xFF30, interrupt controller
+    LDI R3, #16
+    ADD R5, R4, R3
+    ADD R5, R5, R3     ; R5 = 0xFF50, timer
+    LDI R0, #9         ; Counter
+
+    LDI R1, #2
+    ST R1, R4, #4      ; VECTOR = isr
+    LDI R1, #1
+    ST R1, R4, #2      ; MASK = timer line
+    ST R1, R5, #0      ; PERIOD = 1
+    LDI R1, #15
+    SHL R1, R1, #4     ; Prescale 15: 1 << 15 cycles per tick
+    LDI R2, #3
+    OR R1, R1, R2
+    ST R1, R5, #2      ; Timer CTRL = ENABLE | PERIODIC
+    LDI R1, #1
+    ST R1, R4, #6      ; Interrupt CTRL = IE
+
+idle:
+    WFI
+    LDI R1, #1
+    ADD R1, R0, R1     ; Zero once the handler has counted past 0
+    JZ R7, done
+    JMP R7, idle
+
+done:
+    ST R7, R5, #2      ; Stop the timer
+    HLT
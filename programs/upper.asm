@@ -0,0 +1,51 @@
+; Uppercase filter
+; Copies console input to console output, upper-casing a-z, and halts once
+; the input is closed and drained. STDIN never blocks, so the guest polls
+; STATUS (bit 1 = a byte is waiting, bit 2 = input closed).
+;   ./cpu_emulator --input=notes.txt programs/upper.asm run
+;   echo hello | ./cpu_emulator --input=- programs/upper.asm run
+
+start:
+    ; Build I/O address 0xFF00 in R6: 0xFFFF XOR 0x00FF
+    LDI R7, #0         ; Zero register for relative jumps
+    NOT R6, R7         ; R6 = 0xFFFF
+    LDI R5, #1
+    SHL R4, R5, #8     ; R4 = 256
+    SUB R4, R4, R5     ; R4 = 0x00FF (byte mask)
+    XOR R6, R6, R4     ; R6 = 0xFF00
+    LDI R0, #3
+    SHL R0, R0, #5     ; R0 = 96
+    ADD R0, R0, R5     ; R0 = 'a'
+    LDI R3, #20        ; R3 = address of poll (too far back for a relative jump)
+
+poll:
+    LD R1, R6, #2      ; STATUS
+    LDI R2, #2
+    AND R2, R1, R2     ; Byte waiting?
+    JNZ R7, read
+    LDI R2, #4
+    AND R2, R1, R2     ; Input closed?
+    JNZ R7, done
+    JMP R7, poll
+
+done:
+    HLT
+
+read:
+    LD R1, R6, #1      ; STDIN (the high byte is STATUS)
+    AND R1, R1, R4
+    SUB R2, R1, R0     ; Below 'a'?
+    SHR R2, R2, #15
+    JNZ R7, emit
+    LDI R5, #26
+    SUB R2, R1, R0
+    SUB R2, R2, R5     ; Past 'z'?
+    SHR R2, R2, #15
+    JZ R7, emit
+    LDI R5, #16
+    ADD R5, R5, R5     ; R5 = 32
+    SUB R1, R1, R5     ; To upper case
+
+emit:
+    ST R1, R6, #0      ; STDOUT
+    JMP R3, #0
@@ -10,11 +10,18 @@
 
 namespace assembler {
 
+// Where an assembled instruction came from
+struct SourceLine {
+    int number;          // 1-based line in the source
+    std::string text;    // Instruction text, without label or comment
+};
+
 // Assembler for converting assembly code to machine code
 class Assembler {
 private:
     std::map<std::string, uint16_t> labels;  // Label -> address mapping
     std::vector<std::string> lines;
+    std::vector<SourceLine> source_lines;    // One per instruction, by address / 2
     uint16_t current_address;
     
     // Tokenize a line
@@ -66,6 +73,15 @@ private:
         }
     }
     
+    // System operation carried in HLT's RD field (WFI, RTI)
+    uint8_t parse_system_op(const std::string& op) {
+        std::string op_upper = op;
+        std::transform(op_upper.begin(), op_upper.end(), op_upper.begin(), ::toupper);
+        if (op_upper == "WFI") return static_cast<uint8_t>(cpu::SystemOp::WFI);
+        if (op_upper == "RTI") return static_cast<uint8_t>(cpu::SystemOp::RTI);
+        return static_cast<uint8_t>(cpu::SystemOp::HALT);
+    }
+    
     // Convert opcode string to enum
     cpu::Opcode parse_opcode(const std::string& op) {
         std::string op_upper = op;
@@ -87,6 +103,7 @@ private:
         if (op_upper == "JZ") return cpu::Opcode::JZ;
         if (op_upper == "JNZ") return cpu::Opcode::JNZ;
         if (op_upper == "HLT") return cpu::Opcode::HLT;
+        if (op_upper == "WFI" || op_upper == "RTI") return cpu::Opcode::HLT;
         
         throw std::runtime_error("Unknown opcode: " + op);
     }
@@ -98,14 +115,17 @@ public:
     std::vector<uint16_t> assemble(const std::string& source) {
         labels.clear();
         lines.clear();
+        source_lines.clear();
         current_address = 0;
         
         // First pass: collect labels
         std::stringstream ss(source);
         std::string line;
         uint16_t addr = 0;
+        int line_number = 0;
         
         while (std::getline(ss, line)) {
+            line_number++;
             // Remove comments
             size_t comment_pos = line.find(';');
             if (comment_pos != std::string::npos) {
@@ -132,10 +152,12 @@ public:
                 rest.erase(0, rest.find_first_not_of(" \t"));
                 if (!rest.empty()) {
                     lines.push_back(rest);
+                    source_lines.push_back({line_number, rest});
                     addr += 2;
                 }
             } else {
                 lines.push_back(line);
+                source_lines.push_back({line_number, line});
                 addr += 2;
             }
         }
@@ -155,8 +177,8 @@ public:
             switch (instr.opcode) {
                 case cpu::Opcode::NOP:
                 case cpu::Opcode::HLT:
-                    // No operands
-                    instr.rd = 0;
+                    // No operands (WFI and RTI are HLT with a system op in RD)
+                    instr.rd = instr.opcode == cpu::Opcode::HLT ? parse_system_op(tokens[0]) : 0;
                     instr.rs1 = 0;
                     instr.rs2 = 0;
                     instr.imm = 0;
@@ -257,6 +279,11 @@ public:
     const std::map<std::string, uint16_t>& get_labels() const {
         return labels;
     }
+    
+    // Source line of each instruction of the last program, by address / 2
+    const std::vector<SourceLine>& get_source_lines() const {
+        return source_lines;
+    }
 };
 
 } // namespace assembler
@@ -0,0 +1,258 @@
+#pragma once
+
+#include "emulator.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace emulator {
+
+// One independent guest run: a program, the words it reads as input and a budget
+struct BatchJob {
+    struct Input {
+        uint16_t address;
+        uint16_t value;
+    };
+
+    std::string name;
+    std::vector<uint16_t> program;
+    std::vector<Input> inputs;      // Stored after the program is loaded
+    uint64_t max_cycles = UINT64_MAX;
+};
+
+// What a job left behind
+struct BatchResult {
+    RunResult run{StopReason::HALTED, 0};
+    uint16_t pc = 0;
+    cpu::GPRs gprs;
+    std::vector<std::string> output;  // Console lines, in order
+    double seconds = 0;
+    unsigned worker = 0;
+    cpu::Cache::Stats icache;         // Only with BatchOptions::caches
+    cpu::Cache::Stats dcache;
+};
+
+// Settings shared by every emulator instance in the pool
+struct BatchOptions {
+    unsigned threads = 0;  // 0 = one per hardware thread
+    cpu::Engine engine = cpu::Engine::SWITCH;
+    bool fusion = true;
+    bool lazy_flags = false;
+    uint64_t jit_threshold = 16;
+    bool caches = false;   // Simulate L1 caches (runs use the switch interpreter)
+    std::string cache_spec;
+};
+
+// Runs many independent jobs across a pool of emulator instances
+// Each worker thread owns one CPUEmulator and a deque of job indices. It
+// takes work from the back of its own deque and, once that is empty, steals
+// from the front of the others, so long-running jobs do not leave cores
+// idle. Console output is captured per job and never reaches std::cout
+// while workers are running.
+class BatchRunner {
+private:
+    // Collects one job's console lines
+    class CaptureSink : public cpu::Memory::OutputSink {
+    public:
+        std::vector<std::string>* lines = nullptr;
+        void write_line(const std::string& line) override { lines->push_back(line); }
+    };
+
+    struct Worker {
+        std::mutex lock;
+        std::deque<size_t> queue;
+        std::unique_ptr<CPUEmulator> emu;
+        CaptureSink sink;
+        uint64_t jobs_run = 0;
+        uint64_t steals = 0;
+    };
+
+    BatchOptions options;
+    std::vector<std::unique_ptr<Worker>> workers;
+    double wall_seconds = 0;
+
+    static unsigned pool_size(unsigned requested, size_t jobs) {
+        unsigned threads = requested ? requested : std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+        if (jobs > 0 && threads > jobs) threads = static_cast<unsigned>(jobs);
+        return threads;
+    }
+
+    bool pop_own(Worker& worker, size_t& job) {
+        std::lock_guard<std::mutex> guard(worker.lock);
+        if (worker.queue.empty()) return false;
+        job = worker.queue.back();
+        worker.queue.pop_back();
+        return true;
+    }
+
+    bool steal(unsigned self, size_t& job) {
+        for (size_t i = 1; i < workers.size(); i++) {
+            Worker& victim = *workers[(self + i) % workers.size()];
+            std::lock_guard<std::mutex> guard(victim.lock);
+            if (victim.queue.empty()) continue;
+            job = victim.queue.front();
+            victim.queue.pop_front();
+            return true;
+        }
+        return false;
+    }
+
+    void run_job(unsigned index, const BatchJob& job, BatchResult& result) {
+        Worker& worker = *workers[index];
+        CPUEmulator& emu = *worker.emu;
+        worker.sink.lines = &result.output;
+
+        emu.reset();
+        emu.clear_memory();
+        emu.clear_caches();
+        emu.load_program(job.program);
+        for (const auto& input : job.inputs) {
+            emu.write_word(input.address, input.value);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        result.run = emu.run_for(job.max_cycles);
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        result.pc = emu.get_pc();
+        result.gprs = emu.get_gprs();
+        result.worker = index;
+        if (options.caches) {
+            result.icache = emu.get_caches()->get_icache().get_stats();
+            result.dcache = emu.get_caches()->get_dcache().get_stats();
+        }
+        worker.jobs_run++;
+    }
+
+    void work(unsigned index, const std::vector<BatchJob>& jobs, std::vector<BatchResult>& results) {
+        size_t job;
+        // Every queue is filled before the threads start, so once both the
+        // own deque and every victim are empty there is nothing left to do
+        while (true) {
+            if (!pop_own(*workers[index], job)) {
+                if (!steal(index, job)) return;
+                workers[index]->steals++;
+            }
+            run_job(index, jobs[job], results[job]);
+        }
+    }
+
+public:
+    explicit BatchRunner(const BatchOptions& opts) : options(opts) {}
+
+    // Run every job and return results in job order. Throws
+    // std::invalid_argument if the cache spec is bad.
+    std::vector<BatchResult> run(const std::vector<BatchJob>& jobs) {
+        std::vector<BatchResult> results(jobs.size());
+        unsigned threads = pool_size(options.threads, jobs.size());
+
+        workers.clear();
+        for (unsigned i = 0; i < threads; i++) {
+            auto worker = std::make_unique<Worker>();
+            worker->emu = std::make_unique<CPUEmulator>(false);
+            worker->emu->set_engine(options.engine);
+            worker->emu->set_fusion(options.fusion);
+            worker->emu->set_lazy_flags(options.lazy_flags);
+            worker->emu->set_jit_threshold(options.jit_threshold);
+            worker->emu->set_output_sink(&worker->sink);
+            if (options.caches) {
+                worker->emu->configure_caches(options.cache_spec);
+                worker->emu->set_caches(true);
+            }
+            workers.push_back(std::move(worker));
+        }
+        // Deal jobs round-robin; stealing evens out the uneven ones
+        for (size_t j = 0; j < jobs.size(); j++) {
+            workers[j % threads]->queue.push_back(j);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < threads; i++) {
+            pool.emplace_back(&BatchRunner::work, this, i, std::cref(jobs), std::ref(results));
+        }
+        work(0, jobs, results);
+        for (auto& thread : pool) thread.join();
+        wall_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return results;
+    }
+
+    unsigned get_threads() const { return static_cast<unsigned>(workers.size()); }
+    double get_wall_seconds() const { return wall_seconds; }
+
+    uint64_t get_steals() const {
+        uint64_t total = 0;
+        for (const auto& worker : workers) total += worker->steals;
+        return total;
+    }
+
+    // Print each job's outcome and output, then aggregate throughput
+    void print_report(const std::vector<BatchJob>& jobs, const std::vector<BatchResult>& results) const {
+        uint64_t total = 0;
+        std::cout << "\n=== Batch Results ===" << std::endl;
+        for (size_t j = 0; j < results.size(); j++) {
+            const BatchResult& result = results[j];
+            total += result.run.instructions;
+            std::cout << "[" << j << "] " << jobs[j].name << ": "
+                      << stop_reason_name(result.run.reason) << " after "
+                      << result.run.instructions << " instructions, PC 0x" << std::hex
+                      << std::setw(4) << std::setfill('0') << result.pc << ", regs";
+            for (int r = 0; r < 8; r++) {
+                std::cout << " " << std::setw(4) << static_cast<uint16_t>(result.gprs[r]);
+            }
+            std::cout << std::dec << std::setfill(' ') << " (worker " << result.worker << ", "
+                      << std::fixed << std::setprecision(3) << result.seconds * 1e3 << " ms";
+            if (options.caches) {
+                std::cout << std::setprecision(2) << ", I-miss "
+                          << cpu::CacheSystem::percent(result.icache.misses(), result.icache.accesses()) << "%, D-miss "
+                          << cpu::CacheSystem::percent(result.dcache.misses(), result.dcache.accesses()) << "%";
+            }
+            std::cout << ")" << std::defaultfloat << std::endl;
+            for (const auto& line : result.output) {
+                std::cout << "    " << line << std::endl;
+            }
+        }
+
+        std::cout << "=== Batch Summary ===" << std::endl;
+        std::cout << "Jobs: " << results.size() << " on " << get_threads() << " threads ("
+                  << cpu::engine_name(options.engine) << " engine), " << get_steals() << " steals" << std::endl;
+        std::cout << "Per worker:";
+        for (size_t i = 0; i < workers.size(); i++) {
+            std::cout << " " << workers[i]->jobs_run;
+        }
+        std::cout << " jobs" << std::endl;
+        std::cout << "Instructions: " << total << "  wall time: " << std::fixed << std::setprecision(3)
+                  << wall_seconds << " s";
+        if (wall_seconds > 0) {
+            std::cout << "  aggregate MIPS: " << std::setprecision(1) << (total / wall_seconds / 1e6);
+        }
+        std::cout << std::defaultfloat << std::endl;
+        if (options.caches) {
+            cpu::Cache::Stats icache, dcache;
+            for (const BatchResult& result : results) {
+                icache.reads += result.icache.reads;
+                icache.read_misses += result.icache.read_misses;
+                dcache.reads += result.dcache.reads;
+                dcache.writes += result.dcache.writes;
+                dcache.read_misses += result.dcache.read_misses;
+                dcache.write_misses += result.dcache.write_misses;
+                dcache.writebacks += result.dcache.writebacks;
+            }
+            std::cout << std::fixed << std::setprecision(2) << "Caches: I-miss "
+                      << cpu::CacheSystem::percent(icache.misses(), icache.accesses()) << "% of " << icache.accesses()
+                      << " fetches, D-miss " << cpu::CacheSystem::percent(dcache.misses(), dcache.accesses())
+                      << "% of " << dcache.accesses() << " accesses, " << dcache.writebacks << " writebacks"
+                      << std::defaultfloat << std::endl;
+        }
+    }
+};
+
+} // namespace emulator
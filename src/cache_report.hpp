@@ -0,0 +1,112 @@
+#pragma once
+
+#include "assembler.hpp"
+#include "cpu/cache.hpp"
+#include "profile_report.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace emulator {
+
+// Cache misses matched up with the program's labels and source lines
+// Fetch misses are charged to the instruction fetched and data misses to
+// the LD/ST that made the access, the same way ProfileReport assigns
+// executions to labels.
+class CacheReport {
+public:
+    struct Row {
+        std::string label;
+        uint16_t pc;           // Start of the label range, or the instruction
+        int line;              // 0 = outside the program, or a label row
+        std::string text;
+        uint64_t fetches;
+        uint64_t fetch_misses;
+        uint64_t data_accesses;
+        uint64_t data_misses;
+        uint64_t misses() const { return fetch_misses + data_misses; }
+    };
+
+private:
+    std::vector<Row> labels;   // Most misses first
+    std::vector<Row> lines;
+
+    static void print_rates(const Row& row) {
+        std::cout << std::setw(12) << row.fetches << std::setw(8)
+                  << cpu::CacheSystem::percent(row.fetch_misses, row.fetches) << "%" << std::setw(12)
+                  << row.data_accesses << std::setw(8) << cpu::CacheSystem::percent(row.data_misses, row.data_accesses)
+                  << "%";
+    }
+
+    static void print_header(const char* first) {
+        std::cout << "  " << std::left << std::setw(30) << first << std::right << std::setw(12) << "fetches"
+                  << std::setw(9) << "I-miss" << std::setw(12) << "data" << std::setw(9) << "D-miss" << std::endl;
+    }
+
+public:
+    CacheReport(const cpu::CacheSystem& caches, const std::map<std::string, uint16_t>& label_map,
+                const std::vector<assembler::SourceLine>& source_lines) {
+        std::vector<LabelRange> ranges = label_ranges(label_map, source_lines);
+        size_t range = 0;
+        std::vector<Row> by_label;
+        for (const LabelRange& r : ranges) by_label.push_back({r.label, r.start, 0, "", 0, 0, 0, 0});
+        for (uint32_t pc = 0; pc < cpu::Memory::MEMORY_SIZE; pc++) {
+            while (pc >= ranges[range].end) range++;
+            uint16_t at = static_cast<uint16_t>(pc);
+            uint64_t fetches = caches.get_executions(at);
+            if (fetches == 0) continue;
+            Row row{ranges[range].label, at, 0, "", fetches, caches.get_fetch_misses(at),
+                    caches.get_data_accesses(at), caches.get_data_misses(at)};
+            if (pc % 2 == 0 && pc / 2 < source_lines.size()) {
+                row.line = source_lines[pc / 2].number;
+                row.text = source_lines[pc / 2].text;
+            }
+            Row& total = by_label[range];
+            total.fetches += row.fetches;
+            total.fetch_misses += row.fetch_misses;
+            total.data_accesses += row.data_accesses;
+            total.data_misses += row.data_misses;
+            if (row.misses() > 0) lines.push_back(row);
+        }
+        for (const Row& row : by_label) {
+            if (row.fetches > 0) labels.push_back(row);
+        }
+        auto most_misses = [](const Row& a, const Row& b) { return a.misses() > b.misses(); };
+        std::stable_sort(labels.begin(), labels.end(), most_misses);
+        std::stable_sort(lines.begin(), lines.end(), most_misses);
+    }
+
+    const std::vector<Row>& get_labels() const { return labels; }
+    const std::vector<Row>& get_lines() const { return lines; }
+
+    // Miss rates for every label, then the top instructions by misses
+    void print(size_t top = 10) const {
+        std::cout << std::fixed << std::setprecision(1) << std::setfill(' ');
+        std::cout << "By label:" << std::endl;
+        print_header("label");
+        for (const Row& row : labels) {
+            std::cout << "  " << std::left << std::setw(16) << row.label << std::right << " 0x" << std::hex
+                      << std::setw(4) << std::setfill('0') << row.pc << std::dec << std::setfill(' ')
+                      << std::setw(7) << "";
+            print_rates(row);
+            std::cout << std::endl;
+        }
+        std::cout << "Instructions with the most misses (top " << std::min(top, lines.size()) << "):" << std::endl;
+        print_header("pc      line  source");
+        for (size_t i = 0; i < lines.size() && i < top; i++) {
+            const Row& row = lines[i];
+            std::cout << "  0x" << std::hex << std::setw(4) << std::setfill('0') << row.pc << std::dec
+                      << std::setfill(' ') << " " << std::setw(5) << row.line << "  " << std::left << std::setw(16)
+                      << (row.line ? row.text.substr(0, 16) : "?") << std::right;
+            print_rates(row);
+            std::cout << std::endl;
+        }
+        std::cout << std::defaultfloat;
+    }
+};
+
+} // namespace emulator
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "compiler.hpp"
 #include <cstdint>
 
 namespace cpu {
@@ -18,7 +19,7 @@ struct ALUResult {
 class ALU {
 public:
     // Add two 16-bit signed integers
-    static ALUResult add(int16_t a, int16_t b) {
+    static CPU_ALWAYS_INLINE ALUResult add(int16_t a, int16_t b) {
         ALUResult result;
         int32_t sum = static_cast<int32_t>(a) + static_cast<int32_t>(b);
         
@@ -33,12 +34,12 @@ public:
     }
 
     // Subtract b from a
-    static ALUResult subtract(int16_t a, int16_t b) {
+    static CPU_ALWAYS_INLINE ALUResult subtract(int16_t a, int16_t b) {
         return add(a, -b);
     }
 
     // Bitwise AND
-    static ALUResult and_op(int16_t a, int16_t b) {
+    static CPU_ALWAYS_INLINE ALUResult and_op(int16_t a, int16_t b) {
         ALUResult result;
         result.output = a & b;
         result.carry = false;
@@ -49,7 +50,7 @@ public:
     }
 
     // Bitwise OR
-    static ALUResult or_op(int16_t a, int16_t b) {
+    static CPU_ALWAYS_INLINE ALUResult or_op(int16_t a, int16_t b) {
         ALUResult result;
         result.output = a | b;
         result.carry = false;
@@ -60,7 +61,7 @@ public:
     }
 
     // Bitwise XOR
-    static ALUResult xor_op(int16_t a, int16_t b) {
+    static CPU_ALWAYS_INLINE ALUResult xor_op(int16_t a, int16_t b) {
         ALUResult result;
         result.output = a ^ b;
         result.carry = false;
@@ -71,7 +72,7 @@ public:
     }
 
     // Shift left
-    static ALUResult shift_left(int16_t a, int16_t shift) {
+    static CPU_ALWAYS_INLINE ALUResult shift_left(int16_t a, int16_t shift) {
         ALUResult result;
         if (shift < 0 || shift > 15) {
             result.output = 0;
@@ -87,7 +88,7 @@ public:
     }
 
     // Shift right (arithmetic)
-    static ALUResult shift_right(int16_t a, int16_t shift) {
+    static CPU_ALWAYS_INLINE ALUResult shift_right(int16_t a, int16_t shift) {
         ALUResult result;
         if (shift < 0 || shift > 15) {
             result.output = 0;
@@ -103,7 +104,7 @@ public:
     }
 
     // Compare (subtract without storing result)
-    static ALUResult compare(int16_t a, int16_t b) {
+    static CPU_ALWAYS_INLINE ALUResult compare(int16_t a, int16_t b) {
         return subtract(a, b);
     }
 };
@@ -0,0 +1,675 @@
+#pragma once
+
+#include "isa.hpp"
+#include "registers.hpp"
+#include "alu.hpp"
+#include "memory.hpp"
+#include "compiler.hpp"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace cpu {
+
+// Basic-block translation engine
+// Guest code is split into basic blocks that end at JMP/JZ/JNZ/HLT. Each block
+// is translated once into a compact micro-op sequence plus a terminator, and
+// blocks are chained to their successors so hot edges (loop back-edges) go
+// straight from one block to the next without a dispatcher lookup. Common
+// instruction idioms are fused into superinstructions at translation time.
+class BlockEngine {
+public:
+    static constexpr size_t MAX_BLOCK_LENGTH = 64;
+    static constexpr size_t PAGE_SIZE = 256;  // Granularity of the invalidation index
+
+    // Micro-op kinds (terminators are kept separately on the block)
+    enum MicroOpKind : uint8_t {
+        UOP_NOP,
+        UOP_ADD, UOP_SUB, UOP_AND, UOP_OR, UOP_XOR,
+        UOP_NOT,
+        UOP_SHL, UOP_SHR, UOP_SHIFT_ZERO,
+        UOP_LD, UOP_ST,
+        UOP_LDI,
+        // Superinstructions: rk = imm2, then the ALU op (same order as UOP_ADD..UOP_XOR)
+        UOP_LDI_ADD, UOP_LDI_SUB, UOP_LDI_AND, UOP_LDI_OR, UOP_LDI_XOR,
+        // Folded LDI;LDI;ALU: rk = imm2; rs1 = imm; rd = value; flags = flag_bits
+        UOP_LDI2_ALU
+    };
+
+    // Fusion patterns, for the fusion report
+    enum FusionKind : uint8_t {
+        FUSE_LDI2_ALU,    // LDI; LDI; ADD/SUB/AND/OR/XOR on the loaded registers
+        FUSE_LDI_ALU,     // LDI; ALU op reading the loaded register
+        FUSE_ALU_BRANCH,  // ALU op (possibly fused) feeding the block's JZ/JNZ
+        FUSION_KINDS
+    };
+
+    static const char* fusion_name(FusionKind kind) {
+        switch (kind) {
+            case FUSE_LDI2_ALU: return "LDI;LDI;ALU";
+            case FUSE_LDI_ALU: return "LDI;ALU";
+            case FUSE_ALU_BRANCH: return "ALU;JZ/JNZ";
+            default: return "unknown";
+        }
+    }
+
+    struct MicroOp {
+        uint8_t kind;
+        uint8_t rd;
+        uint8_t rs1;
+        uint8_t rs2;
+        int8_t imm;
+        uint8_t rk = 0;            // Register loaded by a fused LDI
+        int8_t imm2 = 0;           // Value loaded into rk
+        uint8_t boundary = 0;      // Guest instructions of the block completed after this op
+        uint8_t flag_bits = 0;     // Folded flags (Flags::to_byte layout)
+        int16_t value = 0;         // Folded result
+    };
+
+    // How a block ends
+    enum TerminatorKind : uint8_t {
+        TERM_FALLTHROUGH,  // Length limit or page boundary: continue at end
+        TERM_JMP,
+        TERM_JZ,
+        TERM_JNZ,
+        TERM_HLT
+    };
+
+    struct Block;
+
+    // State handed to a natively compiled block body
+    struct NativeFrame {
+        GPRs* gprs;
+        SPRs::Flags* flags;
+        const uintptr_t* pages;        // Memory's page table for the direct load/store path
+        const uint64_t* code_bitmap;   // Memory's code-word bits
+        Memory* memory;                // For MMIO and code-page stores
+        const Block* block;            // Block being executed
+        uint8_t* dirty_pages;          // Memory's per-page dirty bytes
+        uint64_t cycle;                // Cycle count before the block's first instruction
+    };
+
+    // Native body: returns the number of body ops completed (short only when a
+    // store invalidated the block itself or ended the run slice)
+    using NativeBody = uint32_t (*)(NativeFrame*);
+
+    // Backend that turns hot blocks into native code
+    class Compiler {
+    public:
+        virtual ~Compiler() = default;
+        virtual NativeBody compile(const Block& block) = 0;  // nullptr if not possible
+        virtual void flush() = 0;                            // Drop all native code
+        virtual bool exhausted() const { return false; }     // Out of code space
+    };
+
+    // Notified after every block (and block fragment) the engine executes
+    class Observer {
+    public:
+        virtual ~Observer() = default;
+        virtual void after_block(const Block& block, uint32_t instructions, uint16_t next_pc,
+                                 const GPRs& gprs, const SPRs& sprs) = 0;
+    };
+
+    struct Block {
+        uint16_t start = 0;             // Address of the first instruction
+        uint16_t end = 0;               // Address just past the terminator
+        std::vector<MicroOp> ops;       // Body, excluding the terminator
+        TerminatorKind term = TERM_FALLTHROUGH;
+        uint8_t term_rs1 = 0;
+        int8_t term_imm = 0;
+        bool term_fused = false;        // JZ/JNZ tests term_reg, written by the last body op
+        uint8_t term_reg = 0;
+        uint8_t fusions[FUSION_KINDS] = {};  // Fusion sites in this block
+        Block* taken = nullptr;         // Chained successor for a relative jump
+        Block* fallthrough = nullptr;   // Chained successor at end
+        uint64_t hits = 0;
+        NativeBody native = nullptr;    // Compiled body, once the block is hot
+        bool uncompilable = false;      // Backend declined it; stay interpreted
+        bool valid = true;
+
+        // Guest instructions covered, including the terminator
+        uint32_t length() const {
+            return static_cast<uint32_t>(end - start) / 2;
+        }
+    };
+
+    static bool cacheable(uint16_t pc) {
+        return (pc & 1) == 0 && pc < 0xFF00;
+    }
+
+private:
+    std::vector<std::unique_ptr<Block>> blocks;      // Live blocks
+    std::vector<std::unique_ptr<Block>> retired;     // Invalidated, freed between runs
+    std::vector<Block*> block_at;                    // Entry PC / 2 -> block
+    std::vector<std::vector<Block*>> page_blocks;    // 256-byte page -> overlapping blocks
+
+    uint64_t block_executions = 0;
+    uint64_t block_instructions = 0;
+    uint64_t chained_transitions = 0;
+    uint64_t dispatcher_lookups = 0;
+    uint64_t translations = 0;
+    uint64_t invalidations = 0;
+    uint64_t native_executions = 0;
+    uint64_t compiled_blocks = 0;
+
+    Compiler* compiler = nullptr;
+    Observer* observer = nullptr;
+    uint64_t compile_threshold = 16;
+    bool fusion_enabled = true;
+    uint64_t fusion_sites[FUSION_KINDS] = {};
+    uint64_t retired_fusion_hits[FUSION_KINDS] = {};  // From blocks no longer live
+
+    static MicroOp make_op(MicroOpKind kind, const Instruction& instr) {
+        MicroOp op{};
+        op.kind = static_cast<uint8_t>(kind);
+        op.rd = instr.rd;
+        op.rs1 = instr.rs1;
+        op.rs2 = instr.rs2;
+        op.imm = instr.imm;
+        return op;
+    }
+
+    static bool is_alu(uint8_t kind) {
+        return kind >= UOP_ADD && kind <= UOP_XOR;
+    }
+
+    static bool is_fused_alu(uint8_t kind) {
+        return kind >= UOP_LDI_ADD && kind <= UOP_LDI_XOR;
+    }
+
+    static CPU_ALWAYS_INLINE ALUResult alu_result(uint8_t kind, int16_t a, int16_t b) {
+        switch (kind) {
+            case UOP_ADD: return ALU::add(a, b);
+            case UOP_SUB: return ALU::subtract(a, b);
+            case UOP_AND: return ALU::and_op(a, b);
+            case UOP_OR:  return ALU::or_op(a, b);
+            default:      return ALU::xor_op(a, b);
+        }
+    }
+
+    // Rewrite idioms in a freshly translated body into superinstructions
+    // Fused ops never span a store, so a block that invalidates itself still
+    // stops at an exact instruction boundary.
+    void fuse(Block& block) {
+        std::vector<MicroOp>& ops = block.ops;
+        std::vector<MicroOp> fused;
+        fused.reserve(ops.size());
+        for (size_t i = 0; i < ops.size();) {
+            const MicroOp& first = ops[i];
+            if (first.kind == UOP_LDI && i + 2 < ops.size() && ops[i + 1].kind == UOP_LDI &&
+                is_alu(ops[i + 2].kind)) {
+                const MicroOp& second = ops[i + 1];
+                const MicroOp& alu = ops[i + 2];
+                auto loaded = [&](uint8_t reg) { return reg == second.rd || reg == first.rd; };
+                if (loaded(alu.rs1) && loaded(alu.rs2)) {
+                    // Both operands are known at translation time: fold the result and flags
+                    auto value_of = [&](uint8_t reg) -> int16_t {
+                        return reg == second.rd ? second.imm : first.imm;
+                    };
+                    ALUResult r = alu_result(alu.kind, value_of(alu.rs1), value_of(alu.rs2));
+                    SPRs::Flags flags;
+                    flags.Z = r.zero;
+                    flags.N = r.negative;
+                    flags.C = r.carry;
+                    flags.V = r.overflow;
+                    MicroOp op = alu;
+                    op.kind = UOP_LDI2_ALU;
+                    op.rk = first.rd;
+                    op.imm2 = first.imm;
+                    op.rs1 = second.rd;
+                    op.imm = second.imm;
+                    op.value = r.output;
+                    op.flag_bits = flags.to_byte();
+                    fused.push_back(op);
+                    block.fusions[FUSE_LDI2_ALU]++;
+                    i += 3;
+                    continue;
+                }
+            }
+            if (first.kind == UOP_LDI && i + 1 < ops.size() && is_alu(ops[i + 1].kind) &&
+                (ops[i + 1].rs1 == first.rd || ops[i + 1].rs2 == first.rd)) {
+                MicroOp op = ops[i + 1];
+                op.kind = static_cast<uint8_t>(UOP_LDI_ADD + (op.kind - UOP_ADD));
+                op.rk = first.rd;
+                op.imm2 = first.imm;
+                fused.push_back(op);
+                block.fusions[FUSE_LDI_ALU]++;
+                i += 2;
+                continue;
+            }
+            fused.push_back(first);
+            i++;
+        }
+
+        // An ALU result feeding the conditional branch is tested directly
+        // (Z is exactly "result register is zero" right after an ALU op)
+        if ((block.term == TERM_JZ || block.term == TERM_JNZ) && !fused.empty() &&
+            (is_alu(fused.back().kind) || is_fused_alu(fused.back().kind) ||
+             fused.back().kind == UOP_LDI2_ALU)) {
+            block.term_fused = true;
+            block.term_reg = fused.back().rd;
+            block.fusions[FUSE_ALU_BRANCH]++;
+        }
+        ops.swap(fused);
+        for (int k = 0; k < FUSION_KINDS; k++) fusion_sites[k] += block.fusions[k];
+    }
+
+    // Decode guest code from pc up to and including the next block terminator
+    Block* translate(Memory& memory, Memory::CodeWatcher* watcher, uint16_t pc) {
+        auto block = std::make_unique<Block>();
+        block->start = pc;
+
+        while (true) {
+            memory.watch_code(pc, watcher);
+            Instruction instr = Instruction::decode(memory.read_word(pc));
+            pc = static_cast<uint16_t>(pc + 2);
+
+            bool terminated = true;
+            switch (instr.opcode) {
+                case Opcode::JMP: block->term = TERM_JMP; break;
+                case Opcode::JZ:  block->term = TERM_JZ; break;
+                case Opcode::JNZ: block->term = TERM_JNZ; break;
+                case Opcode::HLT: block->term = TERM_HLT; break;
+                default: terminated = false; break;
+            }
+            if (terminated) {
+                block->term_rs1 = instr.rs1;
+                block->term_imm = instr.imm;
+                break;
+            }
+
+            switch (instr.opcode) {
+                case Opcode::ADD: block->ops.push_back(make_op(UOP_ADD, instr)); break;
+                case Opcode::SUB: block->ops.push_back(make_op(UOP_SUB, instr)); break;
+                case Opcode::AND: block->ops.push_back(make_op(UOP_AND, instr)); break;
+                case Opcode::OR:  block->ops.push_back(make_op(UOP_OR, instr)); break;
+                case Opcode::XOR: block->ops.push_back(make_op(UOP_XOR, instr)); break;
+                case Opcode::NOT: block->ops.push_back(make_op(UOP_NOT, instr)); break;
+                case Opcode::SHL:
+                case Opcode::SHR: {
+                    MicroOpKind kind = (instr.opcode == Opcode::SHL) ? UOP_SHL : UOP_SHR;
+                    if (instr.imm < 0 || instr.imm > 15) kind = UOP_SHIFT_ZERO;
+                    block->ops.push_back(make_op(kind, instr));
+                    break;
+                }
+                case Opcode::LD:  block->ops.push_back(make_op(UOP_LD, instr)); break;
+                case Opcode::ST:  block->ops.push_back(make_op(UOP_ST, instr)); break;
+                case Opcode::LDI: block->ops.push_back(make_op(UOP_LDI, instr)); break;
+                default:          block->ops.push_back(make_op(UOP_NOP, instr)); break;
+            }
+            block->ops.back().boundary = static_cast<uint8_t>(block->ops.size());
+
+            if (block->ops.size() >= MAX_BLOCK_LENGTH || !cacheable(pc)) break;
+        }
+        block->end = pc;
+        if (fusion_enabled) fuse(*block);
+
+        Block* raw = block.get();
+        uint16_t last = static_cast<uint16_t>(block->end - 1);
+        for (size_t page = block->start / PAGE_SIZE; page <= last / PAGE_SIZE; page++) {
+            page_blocks[page].push_back(raw);
+        }
+        block_at[block->start >> 1] = raw;
+        blocks.push_back(std::move(block));
+        translations++;
+        return raw;
+    }
+
+    Block* lookup(Memory& memory, Memory::CodeWatcher* watcher, uint16_t pc) {
+        dispatcher_lookups++;
+        Block* block = block_at[pc >> 1];
+        return block ? block : translate(memory, watcher, pc);
+    }
+
+    // Forget every chain link; used when a block goes away
+    void unlink_all() {
+        for (auto& block : blocks) {
+            block->taken = nullptr;
+            block->fallthrough = nullptr;
+        }
+    }
+
+    static CPU_ALWAYS_INLINE void set_flags(SPRs& sprs, const ALUResult& result) {
+        sprs.flags.Z = result.zero;
+        sprs.flags.N = result.negative;
+        sprs.flags.C = result.carry;
+        sprs.flags.V = result.overflow;
+    }
+
+    static CPU_ALWAYS_INLINE void set_shift_flags(SPRs& sprs, const ALUResult& result) {
+        sprs.flags.Z = result.zero;
+        sprs.flags.N = result.negative;
+        sprs.flags.C = result.carry;
+    }
+
+    // Execute a block body; returns the number of guest instructions
+    // completed, which is short of the full body only if a store invalidated
+    // the block itself or ended the run slice. cycle is the cycle count
+    // before the block's first instruction. Kept out of line so run()'s
+    // dispatch stays small; everything it calls per micro-op is pinned inline.
+    static CPU_NOINLINE size_t execute_body(const Block& block, Memory& memory, GPRs& gprs, SPRs& sprs,
+                                            uint64_t cycle) {
+        const MicroOp* ops = block.ops.data();
+        size_t count = block.ops.size();
+        for (size_t i = 0; i < count; i++) {
+            const MicroOp& op = ops[i];
+            switch (op.kind) {
+                case UOP_NOP:
+                    break;
+                case UOP_LDI_ADD:
+                    gprs[op.rk] = static_cast<int16_t>(op.imm2);
+                    [[fallthrough]];
+                case UOP_ADD: {
+                    ALUResult r = ALU::add(gprs[op.rs1], gprs[op.rs2]);
+                    gprs[op.rd] = r.output;
+                    set_flags(sprs, r);
+                    break;
+                }
+                case UOP_LDI_SUB:
+                    gprs[op.rk] = static_cast<int16_t>(op.imm2);
+                    [[fallthrough]];
+                case UOP_SUB: {
+                    ALUResult r = ALU::subtract(gprs[op.rs1], gprs[op.rs2]);
+                    gprs[op.rd] = r.output;
+                    set_flags(sprs, r);
+                    break;
+                }
+                case UOP_LDI_AND:
+                    gprs[op.rk] = static_cast<int16_t>(op.imm2);
+                    [[fallthrough]];
+                case UOP_AND: {
+                    ALUResult r = ALU::and_op(gprs[op.rs1], gprs[op.rs2]);
+                    gprs[op.rd] = r.output;
+                    set_flags(sprs, r);
+                    break;
+                }
+                case UOP_LDI_OR:
+                    gprs[op.rk] = static_cast<int16_t>(op.imm2);
+                    [[fallthrough]];
+                case UOP_OR: {
+                    ALUResult r = ALU::or_op(gprs[op.rs1], gprs[op.rs2]);
+                    gprs[op.rd] = r.output;
+                    set_flags(sprs, r);
+                    break;
+                }
+                case UOP_LDI_XOR:
+                    gprs[op.rk] = static_cast<int16_t>(op.imm2);
+                    [[fallthrough]];
+                case UOP_XOR: {
+                    ALUResult r = ALU::xor_op(gprs[op.rs1], gprs[op.rs2]);
+                    gprs[op.rd] = r.output;
+                    set_flags(sprs, r);
+                    break;
+                }
+                case UOP_NOT: {
+                    int16_t value = ~gprs[op.rs1];
+                    gprs[op.rd] = value;
+                    sprs.flags.Z = (value == 0);
+                    sprs.flags.N = (value < 0);
+                    break;
+                }
+                case UOP_SHL: {
+                    ALUResult r = ALU::shift_left(gprs[op.rs1], op.imm);
+                    gprs[op.rd] = r.output;
+                    set_shift_flags(sprs, r);
+                    break;
+                }
+                case UOP_SHR: {
+                    ALUResult r = ALU::shift_right(gprs[op.rs1], op.imm);
+                    gprs[op.rd] = r.output;
+                    set_shift_flags(sprs, r);
+                    break;
+                }
+                case UOP_SHIFT_ZERO:
+                    gprs[op.rd] = 0;
+                    sprs.flags.Z = true;
+                    sprs.flags.N = false;
+                    sprs.flags.C = false;
+                    break;
+                case UOP_LD: {
+                    uint16_t addr = static_cast<uint16_t>(gprs[op.rs1] + op.imm);
+                    gprs[op.rd] = static_cast<int16_t>(memory.read_word(addr));
+                    break;
+                }
+                case UOP_ST: {
+                    uint16_t addr = static_cast<uint16_t>(gprs[op.rs1] + op.imm);
+                    memory.write_word(addr, static_cast<uint16_t>(gprs[op.rd]), cycle + op.boundary - 1);
+                    if (!block.valid || memory.is_slice_ended()) return op.boundary;
+                    break;
+                }
+                case UOP_LDI:
+                    gprs[op.rd] = static_cast<int16_t>(op.imm);
+                    break;
+                case UOP_LDI2_ALU:
+                    gprs[op.rk] = static_cast<int16_t>(op.imm2);
+                    gprs[op.rs1] = static_cast<int16_t>(op.imm);
+                    gprs[op.rd] = op.value;
+                    sprs.flags.from_byte(op.flag_bits);
+                    break;
+            }
+        }
+        return block.length();
+    }
+
+public:
+    BlockEngine() : page_blocks(0x10000 / PAGE_SIZE) {}
+
+    // Drop every block overlapping a written byte (self-modifying code)
+    void invalidate(uint16_t address) {
+        std::vector<Block*>& list = page_blocks[address / PAGE_SIZE];
+        bool removed = false;
+        for (size_t i = 0; i < list.size();) {
+            Block* block = list[i];
+            if (address >= block->start && address < block->end) {
+                retire(block);  // Also erases it from list
+                removed = true;
+            } else {
+                i++;
+            }
+        }
+        if (removed) unlink_all();
+    }
+
+    // Attach a native backend; blocks that reach the threshold get compiled
+    // and cold blocks keep running on the micro-op interpreter
+    void set_compiler(Compiler* c, uint64_t threshold = 16) {
+        compiler = c;
+        compile_threshold = threshold;
+    }
+
+    // Drop native code for every block (e.g. when the backend is flushed)
+    void drop_native() {
+        for (auto& block : blocks) block->native = nullptr;
+    }
+
+    void set_observer(Observer* o) { observer = o; }
+
+    // Turn superinstruction fusion on or off; existing blocks are retranslated
+    void set_fusion(bool enable) {
+        if (enable == fusion_enabled) return;
+        fusion_enabled = enable;
+        clear();
+    }
+
+    bool get_fusion() const { return fusion_enabled; }
+
+    // Fusion sites translated so far
+    uint64_t get_fusion_sites(FusionKind kind) const { return fusion_sites[kind]; }
+
+    // Times fused ops of a kind were executed
+    uint64_t get_fusion_hits(FusionKind kind) const {
+        uint64_t total = retired_fusion_hits[kind];
+        for (const auto& block : blocks) total += block->hits * block->fusions[kind];
+        return total;
+    }
+
+    void clear() {
+        for (auto& block : blocks) {
+            count_retired_fusions(*block);
+            block->valid = false;
+            retired.push_back(std::move(block));
+        }
+        blocks.clear();
+        block_at.assign(block_at.size(), nullptr);
+        for (auto& list : page_blocks) list.clear();
+    }
+
+    uint64_t get_block_executions() const { return block_executions; }
+    uint64_t get_block_instructions() const { return block_instructions; }
+    uint64_t get_chained_transitions() const { return chained_transitions; }
+    uint64_t get_dispatcher_lookups() const { return dispatcher_lookups; }
+    uint64_t get_translations() const { return translations; }
+    uint64_t get_invalidations() const { return invalidations; }
+    uint64_t get_native_executions() const { return native_executions; }
+    uint64_t get_compiled_blocks() const { return compiled_blocks; }
+    size_t get_block_count() const { return blocks.size(); }
+
+    // Average guest instructions executed per block entry
+    double average_block_length() const {
+        return block_executions ? static_cast<double>(block_instructions) / block_executions : 0.0;
+    }
+
+    // Live blocks, for per-block hit reports
+    std::vector<const Block*> get_blocks() const {
+        std::vector<const Block*> result;
+        for (const auto& block : blocks) result.push_back(block.get());
+        return result;
+    }
+
+    // Run from sprs.PC for at most budget instructions
+    // Returns the number of instructions executed. Stops early on HLT (setting
+    // halted), when the next block does not fit in the remaining budget, or at
+    // a PC that cannot be translated; the caller single-steps from there.
+    // cycle is the cycle count before the first instruction, the time a
+    // device sees for the stores that follow.
+    uint64_t run(Memory& memory, GPRs& gprs, SPRs& sprs, Memory::CodeWatcher* watcher,
+                 uint64_t cycle, uint64_t budget, bool& halted) {
+        retired.clear();
+        if (!cacheable(sprs.PC)) return 0;
+        if (block_at.empty()) block_at.assign(0xFF00 / 2, nullptr);
+
+        uint64_t executed = 0;
+        Block* block = lookup(memory, watcher, sprs.PC);
+        NativeFrame frame{&gprs, &sprs.flags, memory.page_table(), memory.code_bitmap(),
+                          &memory, nullptr, memory.dirty_page_bytes(), cycle};
+
+        while (true) {
+            if (budget - executed < block->length()) {
+                sprs.PC = block->start;
+                break;
+            }
+
+            size_t done;
+            if (compiler && block->native) {
+                frame.block = block;
+                frame.cycle = cycle + executed;
+                done = block->native(&frame);
+                native_executions++;
+            } else {
+                done = execute_body(*block, memory, gprs, sprs, cycle + executed);
+                // >= so blocks that got hot without a compiler (or lost their
+                // code in a flush) compile on their next run
+                if (compiler && block->valid && !block->uncompilable &&
+                    block->hits + 1 >= compile_threshold) {
+                    block->native = compiler->compile(*block);
+                    if (!block->native && compiler->exhausted()) {
+                        // Code buffer full: start over and let hot blocks recompile
+                        drop_native();
+                        compiler->flush();
+                        block->native = compiler->compile(*block);
+                    }
+                    if (block->native) {
+                        compiled_blocks++;
+                    } else {
+                        block->uncompilable = true;
+                    }
+                }
+            }
+            block->hits++;
+            block_executions++;
+            if (!block->valid || memory.is_slice_ended()) {
+                // A store rewrote this block, or asked for the devices to be
+                // looked at; resume after the store (the rest of a rewritten
+                // block, including the terminator, is translated afresh)
+                executed += done;
+                block_instructions += done;
+                sprs.PC = static_cast<uint16_t>(block->start + done * 2);
+                if (observer) observer->after_block(*block, static_cast<uint32_t>(done), sprs.PC, gprs, sprs);
+                break;
+            }
+            executed += block->length();
+            block_instructions += block->length();
+
+            // Resolve the terminator
+            uint16_t next_pc = block->end;
+            bool take = false;
+            switch (block->term) {
+                case TERM_FALLTHROUGH: break;
+                case TERM_JMP: take = true; break;
+                case TERM_JZ: take = block->term_fused ? gprs[block->term_reg] == 0 : sprs.flags.Z; break;
+                case TERM_JNZ: take = block->term_fused ? gprs[block->term_reg] != 0 : !sprs.flags.Z; break;
+                case TERM_HLT:
+                    halted = true;
+                    sprs.PC = static_cast<uint16_t>(block->end - 2);
+                    if (observer) observer->after_block(*block, block->length(), sprs.PC, gprs, sprs);
+                    return executed;
+            }
+
+            Block** link = &block->fallthrough;
+            if (take) {
+                int16_t base_reg = gprs[block->term_rs1];
+                uint16_t base = (base_reg == 0) ? block->end : static_cast<uint16_t>(base_reg);
+                next_pc = static_cast<uint16_t>(base + static_cast<int16_t>(block->term_imm));
+                // Only relative jumps have a fixed target worth chaining
+                link = (base_reg == 0) ? &block->taken : nullptr;
+            }
+            if (observer) observer->after_block(*block, block->length(), next_pc, gprs, sprs);
+
+            if (!cacheable(next_pc)) {
+                sprs.PC = next_pc;
+                break;
+            }
+
+            Block* next = link ? *link : nullptr;
+            if (next) {
+                chained_transitions++;
+            } else {
+                next = lookup(memory, watcher, next_pc);
+                if (link) *link = next;
+            }
+            block = next;
+        }
+        return executed;
+    }
+
+private:
+    void count_retired_fusions(const Block& block) {
+        for (int k = 0; k < FUSION_KINDS; k++) retired_fusion_hits[k] += block.hits * block.fusions[k];
+    }
+
+    void retire(Block* block) {
+        count_retired_fusions(*block);
+        block->valid = false;
+        invalidations++;
+        block_at[block->start >> 1] = nullptr;
+        uint16_t last = static_cast<uint16_t>(block->end - 1);
+        for (size_t page = block->start / PAGE_SIZE; page <= last / PAGE_SIZE; page++) {
+            std::vector<Block*>& list = page_blocks[page];
+            for (size_t i = 0; i < list.size(); i++) {
+                if (list[i] == block) {
+                    list.erase(list.begin() + i);
+                    break;
+                }
+            }
+        }
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (blocks[i].get() == block) {
+                retired.push_back(std::move(blocks[i]));
+                blocks.erase(blocks.begin() + i);
+                break;
+            }
+        }
+    }
+};
+
+} // namespace cpu
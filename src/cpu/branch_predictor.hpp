@@ -0,0 +1,343 @@
+#pragma once
+
+#include "isa.hpp"
+#include "memory.hpp"
+#include "registers.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cpu {
+
+// Branch predictor interface
+// A predictor guesses the direction (and, if it stores them, the target) of
+// a conditional jump from its PC, then learns the real outcome. JZ and JNZ
+// are the only conditional jumps. JMP always goes, so only a predictor that
+// stores targets has anything to say about it; those see JMPs as jumps that
+// are always taken.
+class BranchPredictor {
+public:
+    struct Prediction {
+        bool taken;
+        bool has_target;     // target is only meaningful when set
+        uint16_t target;
+    };
+
+    virtual ~BranchPredictor() = default;
+    virtual std::string name() const = 0;
+    virtual Prediction predict(uint16_t pc) const = 0;
+    virtual void update(uint16_t pc, bool taken, uint16_t target) = 0;
+    virtual void reset() = 0;
+    virtual bool has_targets() const { return false; }
+
+    // A direction guessed wrong, or a taken jump sent to a stale target
+    static bool mispredicted(const Prediction& guess, bool taken, uint16_t target) {
+        return guess.taken != taken || (taken && guess.has_target && guess.target != target);
+    }
+
+protected:
+    // Two-bit saturating counters: 0-1 predict not taken, 2-3 taken
+    static bool counter_taken(uint8_t counter) { return counter >= 2; }
+    static void train(uint8_t& counter, bool taken) {
+        if (taken) {
+            if (counter < 3) counter++;
+        } else if (counter > 0) {
+            counter--;
+        }
+    }
+};
+
+// Always predicts fall-through; the baseline the pipeline model uses
+// without a predictor
+class StaticNotTaken : public BranchPredictor {
+public:
+    std::string name() const override { return "static"; }
+    Prediction predict(uint16_t) const override { return {false, false, 0}; }
+    void update(uint16_t, bool, uint16_t) override {}
+    void reset() override {}
+};
+
+// One two-bit counter per PC, indexed by the low bits of the word address
+class Bimodal : public BranchPredictor {
+private:
+    unsigned bits;
+    std::vector<uint8_t> counters;
+
+    size_t index(uint16_t pc) const { return (pc >> 1) & (counters.size() - 1); }
+
+public:
+    explicit Bimodal(unsigned index_bits) : bits(index_bits), counters(size_t(1) << index_bits, 1) {}
+
+    std::string name() const override { return "bimodal:" + std::to_string(bits); }
+    Prediction predict(uint16_t pc) const override { return {counter_taken(counters[index(pc)]), false, 0}; }
+    void update(uint16_t pc, bool taken, uint16_t) override { train(counters[index(pc)], taken); }
+    void reset() override { std::fill(counters.begin(), counters.end(), 1); }
+};
+
+// Two-bit counters indexed by the PC XORed with the global history of the
+// last history_bits conditional jumps
+class Gshare : public BranchPredictor {
+private:
+    unsigned bits;
+    unsigned history_bits;
+    std::vector<uint8_t> counters;
+    uint32_t history = 0;
+
+    size_t index(uint16_t pc) const { return ((pc >> 1) ^ history) & (counters.size() - 1); }
+
+public:
+    Gshare(unsigned index_bits, unsigned history_length)
+        : bits(index_bits), history_bits(history_length), counters(size_t(1) << index_bits, 1) {}
+
+    std::string name() const override {
+        return "gshare:" + std::to_string(bits) + ":" + std::to_string(history_bits);
+    }
+    Prediction predict(uint16_t pc) const override { return {counter_taken(counters[index(pc)]), false, 0}; }
+    void update(uint16_t pc, bool taken, uint16_t) override {
+        train(counters[index(pc)], taken);
+        history = ((history << 1) | (taken ? 1 : 0)) & ((1u << history_bits) - 1);
+    }
+    void reset() override {
+        std::fill(counters.begin(), counters.end(), 1);
+        history = 0;
+    }
+};
+
+// Direct-mapped branch target buffer. A jump is predicted taken only when
+// its PC hits an entry whose counter says taken, and then to the stored
+// target; entries are allocated on the first taken execution.
+class Btb : public BranchPredictor {
+private:
+    struct Entry {
+        uint16_t tag;
+        uint16_t target;
+        uint8_t counter;
+        bool valid;
+    };
+
+    std::vector<Entry> entries;
+
+    size_t index(uint16_t pc) const { return (pc >> 1) & (entries.size() - 1); }
+
+public:
+    explicit Btb(size_t count) : entries(count, Entry{0, 0, 0, false}) {}
+
+    std::string name() const override { return "btb:" + std::to_string(entries.size()); }
+    Prediction predict(uint16_t pc) const override {
+        const Entry& entry = entries[index(pc)];
+        if (!entry.valid || entry.tag != pc) return {false, false, 0};
+        return {counter_taken(entry.counter), true, entry.target};
+    }
+    void update(uint16_t pc, bool taken, uint16_t target) override {
+        Entry& entry = entries[index(pc)];
+        if (entry.valid && entry.tag == pc) {
+            train(entry.counter, taken);
+            if (taken) entry.target = target;
+        } else if (taken) {
+            entry = Entry{pc, target, 2, true};
+        }
+    }
+    void reset() override { std::fill(entries.begin(), entries.end(), Entry{0, 0, 0, false}); }
+    bool has_targets() const override { return true; }
+};
+
+// Several predictors fed the same conditional jumps in one pass
+// The control unit hands every retired instruction to step() while a set is
+// attached; each JZ/JNZ is predicted by every predictor before any of them
+// learns its outcome. Counts are kept per predictor and per jump PC. JMPs
+// go to the predictors that store targets and are counted apart. The first
+// predictor is the primary one that drives the pipeline model.
+class BranchPredictorSet {
+public:
+    static constexpr const char* DEFAULT_SPEC = "gshare:10:8,bimodal:10,btb:64,static";
+
+private:
+    std::vector<std::unique_ptr<BranchPredictor>> predictors;
+    std::vector<uint64_t> mispredicts;                  // Per predictor
+    std::vector<std::vector<uint64_t>> pc_mispredicts;  // Per predictor, by PC
+    std::vector<uint64_t> executions;                   // Conditional jumps by PC
+    std::vector<uint64_t> taken;
+    std::vector<uint64_t> jump_mispredicts;             // JMP target misses, per predictor
+    uint64_t instructions = 0;
+    uint64_t branches = 0;
+    uint64_t jumps = 0;                                 // JMPs
+
+    static unsigned parse_number(const std::string& item, const std::string& text, unsigned low, unsigned high) {
+        size_t used = 0;
+        unsigned long value = 0;
+        try {
+            value = std::stoul(text, &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used == 0 || used != text.size() || value < low || value > high) {
+            throw std::invalid_argument("Bad size in predictor spec (" + std::to_string(low) + "-" +
+                                        std::to_string(high) + "): " + item);
+        }
+        return static_cast<unsigned>(value);
+    }
+
+    static std::unique_ptr<BranchPredictor> make(const std::string& item) {
+        std::vector<std::string> fields;
+        std::stringstream parts(item);
+        std::string field;
+        while (std::getline(parts, field, ':')) fields.push_back(field);
+        const std::string kind = fields.empty() ? "" : fields[0];
+        if (kind == "static" && fields.size() == 1) return std::make_unique<StaticNotTaken>();
+        if (kind == "bimodal" && fields.size() <= 2) {
+            return std::make_unique<Bimodal>(fields.size() > 1 ? parse_number(item, fields[1], 1, 16) : 10);
+        }
+        if (kind == "gshare" && fields.size() <= 3) {
+            unsigned bits = fields.size() > 1 ? parse_number(item, fields[1], 1, 16) : 10;
+            unsigned history = fields.size() > 2 ? parse_number(item, fields[2], 1, bits) : std::min(8u, bits);
+            return std::make_unique<Gshare>(bits, history);
+        }
+        if (kind == "btb" && fields.size() <= 2) {
+            unsigned count = fields.size() > 1 ? parse_number(item, fields[1], 1, 1 << 15) : 64;
+            if (count & (count - 1)) throw std::invalid_argument("BTB entries must be a power of two: " + item);
+            return std::make_unique<Btb>(count);
+        }
+        throw std::invalid_argument("Unknown branch predictor: " + item);
+    }
+
+    static double percent(uint64_t part, uint64_t whole) {
+        return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+    }
+
+public:
+    // Comma-separated predictors, e.g. "static,bimodal:12,gshare:12:8,btb:64"
+    // (bimodal:<index bits>, gshare:<index bits>:<history bits>,
+    // btb:<entries>). Throws std::invalid_argument on a bad spec.
+    explicit BranchPredictorSet(const std::string& spec = DEFAULT_SPEC)
+        : executions(Memory::MEMORY_SIZE, 0), taken(Memory::MEMORY_SIZE, 0) {
+        std::stringstream items(spec);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (!item.empty()) predictors.push_back(make(item));
+        }
+        if (predictors.empty()) throw std::invalid_argument("No branch predictors in: " + spec);
+        mispredicts.assign(predictors.size(), 0);
+        jump_mispredicts.assign(predictors.size(), 0);
+        pc_mispredicts.assign(predictors.size(), std::vector<uint64_t>(Memory::MEMORY_SIZE, 0));
+    }
+
+    // One retired instruction; gprs hold its results. Returns whether the
+    // fetch stream went the wrong way past it: the primary predictor's
+    // verdict for JZ/JNZ, and for JMP too if it stores targets; jumped for
+    // everything else.
+    bool step(uint16_t pc, const Instruction& instr, const GPRs& gprs, bool jumped) {
+        instructions++;
+        const bool conditional = instr.opcode == Opcode::JZ || instr.opcode == Opcode::JNZ;
+        if (!conditional && instr.opcode != Opcode::JMP) return jumped;
+        // The same base rule as the control unit; a jump leaves its base
+        // register alone
+        uint16_t base = gprs[instr.rs1] == 0 ? static_cast<uint16_t>(pc + 2) : static_cast<uint16_t>(gprs[instr.rs1]);
+        uint16_t target = static_cast<uint16_t>(base + instr.imm);
+        if (!conditional) {
+            jumps++;
+            bool primary = true;
+            for (size_t i = 0; i < predictors.size(); i++) {
+                if (!predictors[i]->has_targets()) continue;
+                bool miss = BranchPredictor::mispredicted(predictors[i]->predict(pc), true, target);
+                predictors[i]->update(pc, true, target);
+                if (miss) jump_mispredicts[i]++;
+                if (i == 0) primary = miss;
+            }
+            return primary;
+        }
+        branches++;
+        executions[pc]++;
+        if (jumped) taken[pc]++;
+        bool primary = false;
+        for (size_t i = 0; i < predictors.size(); i++) {
+            bool miss = BranchPredictor::mispredicted(predictors[i]->predict(pc), jumped, target);
+            predictors[i]->update(pc, jumped, target);
+            if (miss) {
+                mispredicts[i]++;
+                pc_mispredicts[i][pc]++;
+            }
+            if (i == 0) primary = miss;
+        }
+        return primary;
+    }
+
+    // Zero the counts and forget everything the predictors learned
+    void clear() {
+        for (auto& predictor : predictors) predictor->reset();
+        std::fill(mispredicts.begin(), mispredicts.end(), 0);
+        for (auto& counts : pc_mispredicts) std::fill(counts.begin(), counts.end(), 0);
+        std::fill(executions.begin(), executions.end(), 0);
+        std::fill(taken.begin(), taken.end(), 0);
+        std::fill(jump_mispredicts.begin(), jump_mispredicts.end(), 0);
+        instructions = branches = jumps = 0;
+    }
+
+    size_t size() const { return predictors.size(); }
+    std::string name(size_t i) const { return predictors[i]->name(); }
+    uint64_t get_instructions() const { return instructions; }
+    uint64_t get_branches() const { return branches; }
+    uint64_t get_mispredicts(size_t i) const { return mispredicts[i]; }
+    uint64_t get_jumps() const { return jumps; }
+    uint64_t get_jump_mispredicts(size_t i) const { return jump_mispredicts[i]; }
+
+    // Mispredictions per thousand instructions
+    double mpki(size_t i) const {
+        return instructions ? 1000.0 * static_cast<double>(mispredicts[i]) / static_cast<double>(instructions) : 0.0;
+    }
+
+    // Accuracy and MPKI per predictor, then the top most executed jumps
+    // with each predictor's accuracy on them
+    void print_report(size_t top = 10) const {
+        std::cout << "\n=== Branch Prediction ===" << std::endl;
+        std::cout << "Instructions: " << instructions << ", conditional jumps: " << branches << std::endl;
+        std::cout << std::fixed << std::setprecision(2) << std::setfill(' ');
+        std::cout << "  " << std::left << std::setw(16) << "predictor" << std::right << std::setw(14)
+                  << "mispredicts" << std::setw(10) << "accuracy" << std::setw(9) << "MPKI" << std::endl;
+        for (size_t i = 0; i < predictors.size(); i++) {
+            std::cout << "  " << std::left << std::setw(16) << predictors[i]->name() << std::right << std::setw(14)
+                      << mispredicts[i] << std::setw(9) << percent(branches - mispredicts[i], branches) << "%"
+                      << std::setw(9) << mpki(i) << std::endl;
+        }
+        std::cout << "JMPs: " << jumps << ", target predicted by";
+        bool any = false;
+        for (size_t i = 0; i < predictors.size(); i++) {
+            if (!predictors[i]->has_targets()) continue;
+            std::cout << (any ? ", " : " ") << predictors[i]->name() << " "
+                      << percent(jumps - jump_mispredicts[i], jumps) << "%";
+            any = true;
+        }
+        std::cout << (any ? "" : " none (no BTB)") << std::endl;
+
+        std::vector<uint16_t> pcs;
+        for (size_t pc = 0; pc < Memory::MEMORY_SIZE; pc++) {
+            if (executions[pc]) pcs.push_back(static_cast<uint16_t>(pc));
+        }
+        std::stable_sort(pcs.begin(), pcs.end(),
+                         [this](uint16_t a, uint16_t b) { return executions[a] > executions[b]; });
+        std::cout << "JZ/JNZ (top " << std::min(top, pcs.size()) << " by executions, accuracy per predictor):"
+                  << std::endl;
+        std::cout << "  pc      " << std::setw(14) << "executions" << std::setw(8) << "taken";
+        for (const auto& predictor : predictors) std::cout << std::setw(14) << predictor->name();
+        std::cout << std::endl;
+        std::cout << std::setprecision(1);
+        for (size_t row = 0; row < pcs.size() && row < top; row++) {
+            uint16_t pc = pcs[row];
+            std::cout << "  0x" << std::hex << std::setw(4) << std::setfill('0') << pc << std::dec
+                      << std::setfill(' ') << "  " << std::setw(14) << executions[pc] << std::setw(7)
+                      << percent(taken[pc], executions[pc]) << "%";
+            for (size_t i = 0; i < predictors.size(); i++) {
+                std::cout << std::setw(13) << percent(executions[pc] - pc_mispredicts[i][pc], executions[pc]) << "%";
+            }
+            std::cout << std::endl;
+        }
+        std::cout << std::defaultfloat;
+    }
+};
+
+} // namespace cpu
@@ -0,0 +1,414 @@
+#pragma once
+
+#include "isa.hpp"
+#include "memory.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cpu {
+
+// Set-associative cache model (tags only, no data)
+// Every way is one 32-bit word: the tag in the low 16 bits, valid and dirty
+// bits, and an age in the top byte. A set's ways are contiguous, so a
+// lookup scans one short run of words. Ages within a set are always a
+// permutation of 0..ways-1; the oldest way is the victim under LRU (touched
+// on every hit) and FIFO (touched only on a fill).
+class Cache {
+public:
+    enum class Replacement : uint8_t { LRU, FIFO, RANDOM };
+
+    struct Config {
+        uint32_t size = 1024;            // Bytes
+        uint32_t line = 16;              // Bytes per line
+        uint32_t ways = 2;
+        Replacement replacement = Replacement::LRU;
+        bool write_back = true;          // Write-back with write-allocate, else write-through without
+        unsigned hit_latency = 1;        // Cycles
+        unsigned miss_latency = 10;
+    };
+
+    struct Stats {
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        uint64_t read_misses = 0;
+        uint64_t write_misses = 0;
+        uint64_t writebacks = 0;         // Dirty lines evicted
+        uint64_t accesses() const { return reads + writes; }
+        uint64_t misses() const { return read_misses + write_misses; }
+    };
+
+    static const char* replacement_name(Replacement policy) {
+        switch (policy) {
+            case Replacement::LRU: return "lru";
+            case Replacement::FIFO: return "fifo";
+            default: return "random";
+        }
+    }
+
+    // Throws std::invalid_argument unless size, line and ways give a power
+    // of two number of sets of 2-byte-or-larger lines
+    static void validate(const Config& config) {
+        auto power_of_two = [](uint32_t n) { return n != 0 && (n & (n - 1)) == 0; };
+        if (!power_of_two(config.size) || config.size > Memory::MEMORY_SIZE) {
+            throw std::invalid_argument("Cache size must be a power of two up to 65536: " +
+                                        std::to_string(config.size));
+        }
+        if (!power_of_two(config.line) || config.line < 2 || config.line > config.size) {
+            throw std::invalid_argument("Cache line must be a power of two from 2 to the cache size: " +
+                                        std::to_string(config.line));
+        }
+        if (config.ways == 0 || config.ways > MAX_WAYS || config.size % (config.line * config.ways) != 0 ||
+            !power_of_two(config.size / (config.line * config.ways))) {
+            throw std::invalid_argument("Cache ways must be 1-" + std::to_string(MAX_WAYS) +
+                                        " and divide the lines into a power of two number of sets: " +
+                                        std::to_string(config.ways));
+        }
+        if (config.hit_latency == 0 || config.miss_latency < config.hit_latency) {
+            throw std::invalid_argument("Cache latencies need 1 <= hit <= miss");
+        }
+    }
+
+    static constexpr uint32_t MAX_WAYS = 16;
+
+private:
+    static constexpr uint32_t TAG_MASK = 0xFFFF;
+    static constexpr uint32_t VALID = 1u << 16;
+    static constexpr uint32_t DIRTY = 1u << 17;
+    static constexpr unsigned AGE_SHIFT = 24;
+
+    Config config;
+    unsigned offset_bits = 0;
+    unsigned set_bits = 0;
+    std::vector<uint32_t> ways;
+    Stats stats;
+    uint32_t random_state = 1;
+
+    static unsigned log2(uint32_t n) {
+        unsigned bits = 0;
+        while ((1u << bits) < n) bits++;
+        return bits;
+    }
+
+    static uint32_t age(uint32_t way) { return way >> AGE_SHIFT; }
+
+    // Make way the youngest in its set
+    void touch(uint32_t* set, uint32_t way) {
+        uint32_t old = age(set[way]);
+        if (old == 0) return;
+        for (uint32_t w = 0; w < config.ways; w++) {
+            if (age(set[w]) < old) set[w] += 1u << AGE_SHIFT;
+        }
+        set[way] &= (1u << AGE_SHIFT) - 1;
+    }
+
+    uint32_t victim(const uint32_t* set) {
+        for (uint32_t w = 0; w < config.ways; w++) {
+            if (!(set[w] & VALID)) return w;
+        }
+        if (config.replacement == Replacement::RANDOM) {
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 17;
+            random_state ^= random_state << 5;
+            return random_state % config.ways;
+        }
+        uint32_t oldest = 0;
+        for (uint32_t w = 1; w < config.ways; w++) {
+            if (age(set[w]) > age(set[oldest])) oldest = w;
+        }
+        return oldest;
+    }
+
+    // One line lookup; returns its latency and sets miss when it misses
+    unsigned access_line(uint32_t line_address, bool write, bool& miss) {
+        uint32_t* set = &ways[(line_address & ((1u << set_bits) - 1)) * config.ways];
+        const uint32_t tag = line_address >> set_bits;
+        for (uint32_t w = 0; w < config.ways; w++) {
+            if ((set[w] & (VALID | TAG_MASK)) == (VALID | tag)) {
+                if (config.replacement == Replacement::LRU) touch(set, w);
+                if (write && config.write_back) set[w] |= DIRTY;
+                return config.hit_latency;
+            }
+        }
+        miss = true;
+        // Write-through stores go to the write buffer without a fill
+        if (write && !config.write_back) return config.hit_latency;
+        unsigned latency = config.miss_latency;
+        uint32_t w = victim(set);
+        if ((set[w] & (VALID | DIRTY)) == (VALID | DIRTY)) {
+            stats.writebacks++;
+            latency += config.miss_latency;
+        }
+        set[w] = (set[w] & ~((1u << AGE_SHIFT) - 1)) | VALID | tag | (write ? DIRTY : 0);
+        touch(set, w);
+        return latency;
+    }
+
+    // A word is one access even when it starts on a line's last byte and
+    // touches the next line too; that line only counts if it misses
+    unsigned access(uint16_t address, bool write) {
+        (write ? stats.writes : stats.reads)++;
+        bool miss = false;
+        uint32_t line_address = address >> offset_bits;
+        unsigned latency = access_line(line_address, write, miss);
+        if (((address + 1u) >> offset_bits) != line_address && address != 0xFFFF) {
+            latency = std::max(latency, access_line(line_address + 1, write, miss));
+        }
+        if (miss) (write ? stats.write_misses : stats.read_misses)++;
+        return latency;
+    }
+
+public:
+    Cache() { configure(Config()); }
+    explicit Cache(const Config& settings) { configure(settings); }
+
+    // Replaces the geometry and policies and empties the cache. Throws
+    // std::invalid_argument on a bad configuration.
+    void configure(const Config& settings) {
+        validate(settings);
+        config = settings;
+        offset_bits = log2(config.line);
+        set_bits = log2(config.size / (config.line * config.ways));
+        ways.assign(config.size / config.line, 0);
+        clear();
+    }
+
+    // Empty every set and zero the counts
+    void clear() {
+        for (size_t i = 0; i < ways.size(); i++) ways[i] = static_cast<uint32_t>(i % config.ways) << AGE_SHIFT;
+        stats = Stats();
+        random_state = 1;
+    }
+
+    // Drop the lines holding any of bytes [first, first + count); dirty ones
+    // count as writebacks
+    void invalidate(uint32_t first, uint32_t count) {
+        for (uint32_t i = 0; i < ways.size(); i++) {
+            if (!(ways[i] & VALID)) continue;
+            uint32_t line_address = ((ways[i] & TAG_MASK) << set_bits) | (i / config.ways);
+            uint32_t start = line_address << offset_bits;
+            if (start >= first + count || start + config.line <= first) continue;
+            if (ways[i] & DIRTY) stats.writebacks++;
+            ways[i] &= ~(VALID | DIRTY | TAG_MASK);
+        }
+    }
+
+    unsigned read(uint16_t address) { return access(address, false); }
+    unsigned write(uint16_t address) { return access(address, true); }
+
+    const Config& get_config() const { return config; }
+    const Stats& get_stats() const { return stats; }
+    uint32_t get_sets() const { return 1u << set_bits; }
+
+    // "1024 B, 16 B lines, 2-way, lru, write-back, hit 1, miss 10"
+    std::string describe() const {
+        return std::to_string(config.size) + " B, " + std::to_string(config.line) + " B lines, " +
+               std::to_string(config.ways) + "-way, " + replacement_name(config.replacement) + ", " +
+               (config.write_back ? "write-back" : "write-through") + ", hit " +
+               std::to_string(config.hit_latency) + ", miss " + std::to_string(config.miss_latency);
+    }
+};
+
+// L1 instruction and data caches on the control unit's memory path
+// The switch interpreter hands every retired instruction to step() while
+// the caches are attached: its fetch goes to the I-cache, and a LD or ST to
+// the D-cache. The I/O page is uncached; those accesses cost the miss
+// latency, are counted apart, and count as misses per PC. Accesses and
+// misses are also kept per PC (a data access is charged to the LD/ST that
+// made it) for CacheReport. Selecting an MMU bank drops the lines of the
+// window it changes.
+// Stall cycles are the latency above one cycle per access, so instructions
+// plus stalls is the run time of a core that blocks on every access; the
+// pipeline model takes the same latencies when both are on.
+class CacheSystem {
+public:
+    struct Timing {
+        unsigned fetch;
+        unsigned data;       // 0 for instructions without a data access
+    };
+
+private:
+    Cache icache;
+    Cache dcache;
+    std::vector<uint64_t> fetch_misses;     // By PC
+    std::vector<uint64_t> data_accesses;
+    std::vector<uint64_t> data_misses;
+    std::vector<uint64_t> executions;
+    uint64_t instructions = 0;
+    uint64_t uncached = 0;
+    uint64_t fetch_stalls = 0;
+    uint64_t data_stalls = 0;
+    // The bank page each page showed when Memory's bank switch count was
+    // last seen (nullptr = its own contents). The caches are indexed by
+    // address, so a window's lines go when it shows another bank.
+    std::array<const uint8_t*, Memory::PAGE_COUNT> windows{};
+    uint64_t bank_switches = 0;
+
+    void check_windows(const Memory& memory) {
+        if (memory.get_bank_switches() == bank_switches) return;
+        bank_switches = memory.get_bank_switches();
+        for (size_t page = 0; page < Memory::PAGE_COUNT; page++) {
+            const uint8_t* shown = memory.is_banked(page) ? memory.page_bytes(page) : nullptr;
+            if (shown == windows[page]) continue;
+            windows[page] = shown;
+            icache.invalidate(static_cast<uint32_t>(page * Memory::PAGE_SIZE), Memory::PAGE_SIZE);
+            dcache.invalidate(static_cast<uint32_t>(page * Memory::PAGE_SIZE), Memory::PAGE_SIZE);
+        }
+    }
+
+    // Settings are "key=value" with an optional "i." or "d." prefix;
+    // without one they apply to both caches
+    static void apply(Cache::Config& config, const std::string& key, const std::string& value,
+                      const std::string& item) {
+        auto number = [&]() {
+            size_t used = 0;
+            unsigned long n = 0;
+            try {
+                n = std::stoul(value, &used);
+            } catch (const std::exception&) {
+                used = 0;
+            }
+            if (used == 0 || used != value.size() || n > Memory::MEMORY_SIZE) {
+                throw std::invalid_argument("Bad number in cache spec: " + item);
+            }
+            return static_cast<uint32_t>(n);
+        };
+        if (key == "size") {
+            config.size = number();
+        } else if (key == "line") {
+            config.line = number();
+        } else if (key == "ways") {
+            config.ways = number();
+        } else if (key == "hit") {
+            config.hit_latency = number();
+        } else if (key == "miss") {
+            config.miss_latency = number();
+        } else if (key == "policy" && (value == "lru" || value == "fifo" || value == "random")) {
+            config.replacement = value == "lru"    ? Cache::Replacement::LRU
+                                 : value == "fifo" ? Cache::Replacement::FIFO
+                                                   : Cache::Replacement::RANDOM;
+        } else if (key == "write" && (value == "back" || value == "through")) {
+            config.write_back = value == "back";
+        } else {
+            throw std::invalid_argument("Unknown cache setting: " + item);
+        }
+    }
+
+public:
+    CacheSystem()
+        : fetch_misses(Memory::MEMORY_SIZE, 0), data_accesses(Memory::MEMORY_SIZE, 0),
+          data_misses(Memory::MEMORY_SIZE, 0), executions(Memory::MEMORY_SIZE, 0) {}
+
+    // Comma-separated settings on top of the defaults, e.g.
+    // "size=2048,line=32,d.ways=4,d.write=through,miss=20"; keys are size,
+    // line, ways, policy (lru, fifo, random), write (back, through), hit and
+    // miss. Empties both caches. Throws std::invalid_argument on a bad spec,
+    // leaving the caches unchanged.
+    void configure(const std::string& spec) {
+        Cache::Config i_config, d_config;
+        std::stringstream items(spec);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (item.empty()) continue;
+            size_t eq = item.find('=');
+            if (eq == std::string::npos) throw std::invalid_argument("Expected key=value in cache spec: " + item);
+            std::string key = item.substr(0, eq);
+            std::string value = item.substr(eq + 1);
+            for (char& c : key) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            if (key.rfind("i.", 0) == 0) {
+                apply(i_config, key.substr(2), value, item);
+            } else if (key.rfind("d.", 0) == 0) {
+                apply(d_config, key.substr(2), value, item);
+            } else {
+                apply(i_config, key, value, item);
+                apply(d_config, key, value, item);
+            }
+        }
+        Cache::validate(i_config);
+        Cache::validate(d_config);
+        icache.configure(i_config);
+        dcache.configure(d_config);
+        clear();
+    }
+
+    // One retired instruction at pc; address is its LD/ST effective address
+    Timing step(const Memory& memory, uint16_t pc, Opcode op, uint16_t address) {
+        check_windows(memory);
+        instructions++;
+        executions[pc]++;
+        uint64_t misses = icache.get_stats().misses();
+        Timing timing{icache.read(pc), 0};
+        if (icache.get_stats().misses() != misses) fetch_misses[pc]++;
+        fetch_stalls += timing.fetch - 1;
+        if (op != Opcode::LD && op != Opcode::ST) return timing;
+        data_accesses[pc]++;
+        if (address >= Memory::IO_BASE) {
+            uncached++;
+            data_misses[pc]++;
+            timing.data = dcache.get_config().miss_latency;
+        } else {
+            misses = dcache.get_stats().misses();
+            timing.data = op == Opcode::LD ? dcache.read(address) : dcache.write(address);
+            if (dcache.get_stats().misses() != misses) data_misses[pc]++;
+        }
+        data_stalls += timing.data - 1;
+        return timing;
+    }
+
+    // Empty both caches and zero every count
+    void clear() {
+        icache.clear();
+        dcache.clear();
+        std::fill(fetch_misses.begin(), fetch_misses.end(), 0);
+        std::fill(data_accesses.begin(), data_accesses.end(), 0);
+        std::fill(data_misses.begin(), data_misses.end(), 0);
+        std::fill(executions.begin(), executions.end(), 0);
+        instructions = uncached = fetch_stalls = data_stalls = 0;
+    }
+
+    const Cache& get_icache() const { return icache; }
+    const Cache& get_dcache() const { return dcache; }
+    uint64_t get_instructions() const { return instructions; }
+    uint64_t get_uncached() const { return uncached; }
+    uint64_t get_stall_cycles() const { return fetch_stalls + data_stalls; }
+    uint64_t get_executions(uint16_t pc) const { return executions[pc]; }
+    uint64_t get_fetch_misses(uint16_t pc) const { return fetch_misses[pc]; }
+    uint64_t get_data_accesses(uint16_t pc) const { return data_accesses[pc]; }
+    uint64_t get_data_misses(uint16_t pc) const { return data_misses[pc]; }
+
+    static double percent(uint64_t part, uint64_t whole) {
+        return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+    }
+
+    // Both caches' geometry, miss rates and the stall cycles they cost
+    void print_summary() const {
+        std::cout << "\n=== Caches ===" << std::endl;
+        std::cout << std::fixed << std::setprecision(2);
+        const Cache* caches[2] = {&icache, &dcache};
+        for (int c = 0; c < 2; c++) {
+            const Cache::Stats& stats = caches[c]->get_stats();
+            std::cout << (c == 0 ? "I-cache: " : "D-cache: ") << caches[c]->describe() << std::endl;
+            std::cout << "  reads " << stats.reads << " (" << stats.read_misses << " misses), writes " << stats.writes
+                      << " (" << stats.write_misses << " misses), miss rate "
+                      << percent(stats.misses(), stats.accesses()) << "%";
+            if (c == 1) std::cout << ", writebacks " << stats.writebacks << ", uncached I/O " << uncached;
+            std::cout << std::endl;
+        }
+        std::cout << "Stall cycles: fetch " << fetch_stalls << ", data " << data_stalls << std::endl;
+        if (instructions > 0) {
+            std::cout << "Blocking-core CPI: "
+                      << static_cast<double>(instructions + get_stall_cycles()) / static_cast<double>(instructions)
+                      << std::endl;
+        }
+        std::cout << std::defaultfloat;
+    }
+};
+
+} // namespace cpu
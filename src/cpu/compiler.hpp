@@ -0,0 +1,15 @@
+#pragma once
+
+// Inlining hints for the engines' hot paths
+// Everything is compiled as one translation unit, so GCC's unit-growth
+// limits decide what gets inlined; every new feature shifts that budget and
+// can silently turn a one-line helper inside a dispatch loop into a call.
+// Helpers the loops depend on are pinned with CPU_ALWAYS_INLINE, and rarely
+// taken slow paths are kept out of them with CPU_NOINLINE.
+#if defined(__GNUC__)
+#define CPU_ALWAYS_INLINE inline __attribute__((always_inline))
+#define CPU_NOINLINE __attribute__((noinline))
+#else
+#define CPU_ALWAYS_INLINE inline
+#define CPU_NOINLINE
+#endif
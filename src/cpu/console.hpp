@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define CPU_CONSOLE_WRITEV 1
+#else
+#define CPU_CONSOLE_WRITEV 0
+#endif
+
+namespace cpu {
+
+// Guest console output stream
+// Bytes collect in a ring buffer and reach the file descriptor in one
+// writev straight from the ring (two segments once it has wrapped), instead
+// of a stream flush per line. A flush happens when the pending bytes reach
+// the threshold, when the guest writes the flush register, when the machine
+// halts, when control returns to the host, or when the oldest pending byte
+// has waited longer than the flush interval (polled between instruction
+// slices). Not thread-safe: machines that run on worker threads capture
+// their output through Memory::OutputSink instead.
+class ConsoleBuffer {
+public:
+    struct Options {
+        size_t capacity = 1 << 16;         // Ring size, rounded up to a power of two
+        size_t flush_threshold = 1 << 15;  // Pending bytes that trigger a flush
+        uint64_t flush_interval_ms = 50;   // Longest a byte may wait (0 = no timer)
+        int fd = 1;
+    };
+
+    enum FlushReason { THRESHOLD, GUEST, HALT, HOST, TIMER, REASON_COUNT };
+
+    static const char* reason_name(FlushReason reason) {
+        switch (reason) {
+            case THRESHOLD: return "threshold";
+            case GUEST: return "guest";
+            case HALT: return "halt";
+            case HOST: return "host";
+            case TIMER: return "timer";
+            default: return "unknown";
+        }
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    Options options;
+    std::vector<uint8_t> ring;
+    size_t mask = 0;
+    uint64_t head = 0;      // Bytes accepted
+    uint64_t tail = 0;      // Bytes handed to the file descriptor
+    Clock::time_point oldest;  // When the first pending byte arrived
+    bool line_open = false;    // Last byte was not a newline
+    uint64_t flushes[REASON_COUNT] = {};
+    uint64_t write_calls = 0;
+
+    // Write [tail, head) from the ring; bytes the descriptor refuses are dropped
+    void drain() {
+        while (tail < head) {
+            size_t start = tail & mask;
+            size_t pending = static_cast<size_t>(head - tail);
+            size_t first = std::min(pending, ring.size() - start);
+            write_calls++;
+#if CPU_CONSOLE_WRITEV
+            struct iovec segments[2] = {{&ring[start], first}, {ring.data(), pending - first}};
+            ssize_t written = writev(options.fd, segments, pending > first ? 2 : 1);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) {
+                tail = head;
+                return;
+            }
+            tail += static_cast<uint64_t>(written);
+#else
+            std::FILE* out = options.fd == 2 ? stderr : stdout;
+            std::fwrite(&ring[start], 1, first, out);
+            std::fwrite(ring.data(), 1, pending - first, out);
+            std::fflush(out);
+            tail = head;
+#endif
+        }
+    }
+
+public:
+    ConsoleBuffer() {
+        configure(Options());
+    }
+
+    explicit ConsoleBuffer(const Options& opts) {
+        configure(opts);
+    }
+
+    ~ConsoleBuffer() {
+        flush(HOST);
+    }
+
+    ConsoleBuffer(const ConsoleBuffer&) = delete;
+    ConsoleBuffer& operator=(const ConsoleBuffer&) = delete;
+
+    // Pending bytes are written out before the ring is resized
+    void configure(const Options& opts) {
+        flush(HOST);
+        options = opts;
+        size_t capacity = 16;
+        while (capacity < options.capacity) capacity <<= 1;
+        options.capacity = capacity;
+        options.flush_threshold = std::max<size_t>(1, std::min(options.flush_threshold, capacity));
+        ring.assign(capacity, 0);
+        mask = capacity - 1;
+        head = tail = 0;
+    }
+
+    const Options& get_options() const { return options; }
+
+    void put(uint8_t byte) {
+        if (head == tail && options.flush_interval_ms) oldest = Clock::now();
+        ring[head & mask] = byte;
+        head++;
+        line_open = byte != '\n';
+        if (head - tail >= options.flush_threshold) flush(THRESHOLD);
+    }
+
+    void flush(FlushReason reason) {
+        if (head == tail) return;
+        // Host text printed before this point must come out first
+        std::cout.flush();
+        drain();
+        flushes[reason]++;
+    }
+
+    // Finish an unterminated line, then flush (the machine halted)
+    void end_output() {
+        if (line_open) put('\n');
+        flush(HALT);
+    }
+
+    // Timer flush: cheap when nothing is pending
+    void poll() {
+        if (head == tail || !options.flush_interval_ms) return;
+        if (Clock::now() - oldest >= std::chrono::milliseconds(options.flush_interval_ms)) flush(TIMER);
+    }
+
+    uint64_t get_bytes() const { return head; }
+    uint64_t get_write_calls() const { return write_calls; }
+    uint64_t get_flushes(FlushReason reason) const { return flushes[reason]; }
+
+    void print_stats() const {
+        std::cout << "Console: " << head << " bytes in " << write_calls << " writes, flushes:";
+        for (int r = 0; r < REASON_COUNT; r++) {
+            std::cout << " " << reason_name(static_cast<FlushReason>(r)) << " " << flushes[r];
+        }
+        std::cout << " (ring " << options.capacity << " bytes, threshold " << options.flush_threshold
+                  << ", interval " << options.flush_interval_ms << " ms)" << std::endl;
+    }
+
+    // Descriptor for a file to receive console output (truncated), or -1
+    static int open_file(const std::string& path) {
+#if CPU_CONSOLE_WRITEV
+        return ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#else
+        (void)path;
+        return -1;
+#endif
+    }
+
+    // The process-wide console on standard output
+    static ConsoleBuffer& standard() {
+        static ConsoleBuffer console;
+        return console;
+    }
+};
+
+} // namespace cpu
@@ -5,59 +5,344 @@
 #include "registers.hpp"
 #include "alu.hpp"
 #include "memory.hpp"
+#include "decode_cache.hpp"
+#include "threaded_engine.hpp"
+#include "block_engine.hpp"
+#include "jit_x86_64.hpp"
+#include "trace.hpp"
+#include "profiler.hpp"
+#include "heat_map.hpp"
+#include "pipeline.hpp"
+#include "branch_predictor.hpp"
+#include "cache.hpp"
 #include <iostream>
 #include <iomanip>
+#include <memory>
+#include <string>
 
 namespace cpu {
 
+// Execution policies
+// The interpreter is instantiated once per policy; anything a policy turns off
+// is removed at compile time, so the fast variant carries no trace checks,
+// bus-signal updates or mnemonic formatting.
+struct TracedExecution {
+    static constexpr bool trace = true;        // Honour the runtime trace switch
+    static constexpr bool drive_buses = true;  // Model bus signals
+    static constexpr bool lazy_flags = false;  // Record ALU ops, compute flags on read
+    static constexpr bool observe = false;     // Feed the recorder, profiler and timing models
+};
+
+struct FastExecution {
+    static constexpr bool trace = false;
+    static constexpr bool drive_buses = false;
+    static constexpr bool lazy_flags = false;
+    static constexpr bool observe = false;
+};
+
+struct LazyFlagsExecution {
+    static constexpr bool trace = false;
+    static constexpr bool drive_buses = false;
+    static constexpr bool lazy_flags = true;
+    static constexpr bool observe = false;
+};
+
+struct ObservedExecution {
+    static constexpr bool trace = false;
+    static constexpr bool drive_buses = false;
+    static constexpr bool lazy_flags = false;
+    static constexpr bool observe = true;
+};
+
+struct TracedObservedExecution {
+    static constexpr bool trace = true;
+    static constexpr bool drive_buses = true;
+    static constexpr bool lazy_flags = false;
+    static constexpr bool observe = true;
+};
+
+// Interpreter core used by run() when tracing is off
+enum class Engine {
+    SWITCH,     // Switch-dispatched interpreter over the predecode cache
+    THREADED,   // Direct-threaded interpreter with specialized handlers
+    BLOCK,      // Basic-block translation cache with block chaining
+    JIT         // Block engine with hot blocks compiled to x86-64
+};
+
+inline const char* engine_name(Engine engine) {
+    switch (engine) {
+        case Engine::SWITCH: return "switch";
+        case Engine::THREADED: return "threaded";
+        case Engine::BLOCK: return "block";
+        case Engine::JIT: return "jit";
+    }
+    return "unknown";
+}
+
+// Parse an engine name as accepted by --engine and the 'engine' command
+inline bool parse_engine(const std::string& name, Engine& engine) {
+    if (name == "switch") { engine = Engine::SWITCH; return true; }
+    if (name == "threaded") { engine = Engine::THREADED; return true; }
+    if (name == "block") { engine = Engine::BLOCK; return true; }
+    if (name == "jit") { engine = Engine::JIT; return true; }
+    return false;
+}
+
+// All engines, in the order benchmarks report them
+inline const Engine ALL_ENGINES[] = { Engine::SWITCH, Engine::THREADED, Engine::BLOCK, Engine::JIT };
+
 // Control Unit - orchestrates CPU operations
-class ControlUnit {
+class ControlUnit : public Memory::CodeWatcher {
 private:
     bool trace_enabled;
     bool halted;
     uint64_t cycle_count;
+    Engine engine;
+    DecodeCache decode_cache;
+    ThreadedEngine threaded_engine;
+    BlockEngine block_engine;
+    std::unique_ptr<X86Jit> jit;   // Created when the JIT engine is first selected
+    uint64_t jit_threshold = 16;
+    bool lazy_flags = false;
+    TraceWriter* recorder = nullptr;
+    Profiler* profiler = nullptr;
+    HeatMap* heat_map = nullptr;
+    PipelineModel* pipeline = nullptr;
+    BranchPredictorSet* predictors = nullptr;
+    CacheSystem* caches = nullptr;
+    
+    // Fetch and decode the instruction at pc after a predecode cache miss
+    const DecodedInstruction& fetch_miss(Memory& memory, uint16_t pc) {
+        if (DecodeCache::cacheable(pc)) {
+            memory.watch_code(pc, this);
+        }
+        return decode_cache.fill(pc, memory.read_word(pc));
+    }
+    
+    // Switch-interpreter loop over at most budget instructions
+    template <typename Policy, bool Breakpoint>
+    void run_switch(Memory& memory, GPRs& gprs, SPRs& sprs, BusSystem& buses,
+                    uint64_t budget, uint16_t breakpoint) {
+        for (uint64_t done = 0; done < budget; done++) {
+            if (Breakpoint && done > 0 && sprs.PC == breakpoint) return;
+            if (!execute<Policy>(memory, gprs, sprs, buses)) return;
+        }
+    }
+    
+    bool observed() const { return recorder || profiler || heat_map || pipeline || predictors || caches; }
+    
+    // One instruction has finished; gprs hold its results. The recorder is
+    // fed inline, since a trace is meant to run at close to full speed; the
+    // analysis models are called out of line.
+    CPU_ALWAYS_INLINE void observe(const Memory& memory, uint16_t pc, uint16_t word, const Instruction& instr,
+                                   const GPRs& gprs, bool jumped, uint16_t address) {
+        if (recorder) recorder->step(pc, word, instr, gprs, jumped, address);
+        if (profiler || heat_map || predictors || caches || pipeline) {
+            analyze(memory, pc, instr, gprs, jumped, address);
+        }
+    }
+    
+    CPU_NOINLINE void analyze(const Memory& memory, uint16_t pc, const Instruction& instr, const GPRs& gprs,
+                              bool jumped, uint16_t address) {
+        if (profiler) profiler->count(pc, instr.opcode, jumped);
+        if (heat_map) heat_map->count(pc, instr.opcode, address);
+        bool mispredicted = jumped;
+        if (predictors) mispredicted = predictors->step(pc, instr, gprs, jumped);
+        CacheSystem::Timing timing{1, 0};
+        if (caches) timing = caches->step(memory, pc, instr.opcode, address);
+        if (pipeline) pipeline->step(instr, jumped, mispredicted, timing.fetch, timing.data);
+    }
+    
+    template <typename Policy>
+    bool tracing() const {
+        if constexpr (Policy::trace) {
+            return trace_enabled;
+        } else {
+            return false;
+        }
+    }
     
 public:
     ControlUnit(bool trace = false) 
-        : trace_enabled(trace), halted(false), cycle_count(0) {}
+        : trace_enabled(trace), halted(false), cycle_count(0), engine(Engine::SWITCH) {}
     
     void enable_trace(bool enable) { trace_enabled = enable; }
+    bool is_trace_enabled() const { return trace_enabled; }
     bool is_halted() const { return halted; }
     uint64_t get_cycle_count() const { return cycle_count; }
+    const DecodeCache& get_decode_cache() const { return decode_cache; }
+    const ThreadedEngine& get_threaded_engine() const { return threaded_engine; }
+    const BlockEngine& get_block_engine() const { return block_engine; }
+    const X86Jit* get_jit() const { return jit.get(); }  // nullptr until the JIT engine is used
+    void set_block_observer(BlockEngine::Observer* observer) { block_engine.set_observer(observer); }
+    
+    // The JIT engine is the block engine with the native backend attached
+    void set_engine(Engine e) {
+        engine = e;
+        if (e == Engine::JIT && !jit) jit = std::make_unique<X86Jit>();
+        block_engine.set_compiler(e == Engine::JIT ? jit.get() : nullptr, jit_threshold);
+    }
+    
+    // Superinstruction fusion in the block translator (block and jit engines)
+    void set_fusion(bool enable) { block_engine.set_fusion(enable); }
+    bool get_fusion() const { return block_engine.get_fusion(); }
+    
+    // Defer flag computation in the switch interpreter until flags are read
+    void set_lazy_flags(bool enable) { lazy_flags = enable; }
+    bool get_lazy_flags() const { return lazy_flags; }
     
-    // Execute one instruction cycle (Fetch-Decode-Execute)
+    // Block executions before the JIT compiles a block
+    void set_jit_threshold(uint64_t threshold) {
+        jit_threshold = threshold < 1 ? 1 : threshold;
+        set_engine(engine);
+    }
+    uint64_t get_jit_threshold() const { return jit_threshold; }
+    Engine get_engine() const { return engine; }
+    
+    // Binary trace recorder, execution profiler, memory heat map, pipeline
+    // timing model, branch predictors and caches; while any is set every
+    // instruction runs in the switch interpreter, since only it sees each
+    // instruction's effects. The primary predictor decides the pipeline's
+    // flushes and the caches its fetch and memory latencies.
+    void set_recorder(TraceWriter* writer) { recorder = writer; }
+    bool is_recording() const { return recorder != nullptr; }
+    void set_profiler(Profiler* counters) { profiler = counters; }
+    bool is_profiling() const { return profiler != nullptr; }
+    void set_heat_map(HeatMap* counters) { heat_map = counters; }
+    bool is_mapping_heat() const { return heat_map != nullptr; }
+    void set_pipeline(PipelineModel* model) { pipeline = model; }
+    bool is_timing_pipeline() const { return pipeline != nullptr; }
+    void set_predictors(BranchPredictorSet* set) { predictors = set; }
+    bool is_predicting_branches() const { return predictors != nullptr; }
+    void set_caches(CacheSystem* system) { caches = system; }
+    bool is_caching() const { return caches != nullptr; }
+    
+    // Clear halt state and cycle counter (decoded code stays cached)
+    void reset() {
+        halted = false;
+        cycle_count = 0;
+    }
+    
+    // Put back cycle and halt state from a snapshot (decoded code stays cached)
+    void restore_state(uint64_t cycles, bool is_halted) {
+        halted = is_halted;
+        cycle_count = cycles;
+    }
+    
+    // Drop every cached decode and translation (memory was replaced wholesale)
+    void flush_code() {
+        decode_cache.clear();
+        threaded_engine.clear();
+        block_engine.clear();
+    }
+    
+    // A store hit a word holding a predecoded instruction
+    void on_code_write(uint16_t address) override {
+        decode_cache.invalidate(address);
+        threaded_engine.invalidate(address);
+        block_engine.invalidate(address);
+    }
+    
+    // Execute one instruction cycle (Fetch-Decode-Execute) with tracing and bus signals
     bool execute_cycle(Memory& memory, GPRs& gprs, SPRs& sprs, BusSystem& buses) {
+        if (observed()) return execute<TracedObservedExecution>(memory, gprs, sprs, buses);
+        return execute<TracedExecution>(memory, gprs, sprs, buses);
+    }
+    
+    // Run at most budget instructions with the selected zero-overhead engine
+    // (no trace, no bus signals). Stops early on HLT; returns the number of
+    // instructions executed.
+    uint64_t run_fast(Memory& memory, GPRs& gprs, SPRs& sprs, BusSystem& buses,
+                      uint64_t budget = UINT64_MAX) {
+        uint64_t start = cycle_count;
+        if (observed()) {
+            run_switch<ObservedExecution, false>(memory, gprs, sprs, buses, budget, 0);
+            return cycle_count - start;
+        }
+        if (engine == Engine::SWITCH) {
+            if (lazy_flags) {
+                run_switch<LazyFlagsExecution, false>(memory, gprs, sprs, buses, budget, 0);
+                // Nothing outside this loop knows about pending flags
+                sprs.flags.resolve();
+            } else {
+                run_switch<FastExecution, false>(memory, gprs, sprs, buses, budget, 0);
+            }
+            return cycle_count - start;
+        }
+        while (!halted && cycle_count - start < budget && !memory.is_slice_ended()) {
+            uint64_t remaining = budget - (cycle_count - start);
+            if (engine == Engine::THREADED) {
+                cycle_count += threaded_engine.run(memory, gprs, sprs, this, cycle_count, remaining, halted);
+            } else {
+                cycle_count += block_engine.run(memory, gprs, sprs, this, cycle_count, remaining, halted);
+            }
+            if (halted || cycle_count - start >= budget || memory.is_slice_ended()) break;
+            // PCs the engine cannot handle (and blocks that would overrun the
+            // budget) are single-stepped here
+            execute<FastExecution>(memory, gprs, sprs, buses);
+        }
+        return cycle_count - start;
+    }
+    
+    // Like run_fast, but stop before the instruction at breakpoint once at
+    // least one instruction has run. Uses the switch interpreter whatever the
+    // engine, since the others only stop between blocks.
+    uint64_t run_to_breakpoint(Memory& memory, GPRs& gprs, SPRs& sprs, BusSystem& buses,
+                               uint16_t breakpoint, uint64_t budget = UINT64_MAX) {
+        uint64_t start = cycle_count;
+        if (observed()) {
+            run_switch<ObservedExecution, true>(memory, gprs, sprs, buses, budget, breakpoint);
+        } else if (lazy_flags) {
+            run_switch<LazyFlagsExecution, true>(memory, gprs, sprs, buses, budget, breakpoint);
+            sprs.flags.resolve();
+        } else {
+            run_switch<FastExecution, true>(memory, gprs, sprs, buses, budget, breakpoint);
+        }
+        return cycle_count - start;
+    }
+    
+    // Execute one instruction cycle under the given execution policy.
+    // Returns false after HLT or a store that ended the run slice.
+    template <typename Policy>
+    bool execute(Memory& memory, GPRs& gprs, SPRs& sprs, BusSystem& buses) {
         if (halted) return false;
         
         cycle_count++;
         
-        if (trace_enabled) {
+        if (tracing<Policy>()) {
             std::cout << "\n=== Cycle " << cycle_count << " ===" << std::endl;
             std::cout << "PC: 0x" << std::hex << std::setw(4) << std::setfill('0') 
                       << sprs.PC << std::dec << std::endl;
         }
         
-        // FETCH: Get instruction from memory
-        buses.instruction_bus.address = sprs.PC;
-        buses.instruction_bus.read_enable = true;
-        uint16_t instruction_word = memory.read_word(sprs.PC);
-        buses.instruction_bus.data = instruction_word;
-        buses.instruction_bus.read_enable = false;
+        // FETCH: Get instruction from memory (or the predecode cache)
+        const DecodedInstruction* cached = decode_cache.find(sprs.PC);
+        const DecodedInstruction& decoded = cached ? *cached : fetch_miss(memory, sprs.PC);
+        uint16_t instruction_word = decoded.word;
+        if constexpr (Policy::drive_buses) {
+            buses.instruction_bus.address = sprs.PC;
+            buses.instruction_bus.read_enable = true;
+            buses.instruction_bus.data = instruction_word;
+            buses.instruction_bus.read_enable = false;
+        }
         
-        if (trace_enabled) {
+        if (tracing<Policy>()) {
             std::cout << "[FETCH] Instruction at PC: 0x" << std::hex << std::setw(4) 
                       << std::setfill('0') << instruction_word << std::dec << std::endl;
         }
         
-        // DECODE: Parse instruction
-        Instruction instr = Instruction::decode(instruction_word);
+        // DECODE: Parse instruction (already done when the fetch hit the cache)
+        const Instruction instr = decoded.instr;
         
-        if (trace_enabled) {
+        if (tracing<Policy>()) {
             std::cout << "[DECODE] " << instr.mnemonic() << std::endl;
         }
         
         // EXECUTE: Perform operation
         bool pc_updated = false;
+        bool slice_ended = false;  // A store asked the run loop to look at devices
+        const uint16_t pc = sprs.PC;
+        uint16_t access_address = 0;  // LD/ST effective address, for observers
         
         switch (instr.opcode) {
             case Opcode::NOP:
@@ -73,6 +358,37 @@ public:
                 int16_t val1 = gprs[instr.rs1];
                 int16_t val2 = instr.is_immediate ? instr.imm : gprs[instr.rs2];
                 
+                if constexpr (Policy::lazy_flags) {
+                    // Record the operation; flags are computed when read
+                    int16_t output;
+                    switch (instr.opcode) {
+                        case Opcode::ADD:
+                            output = static_cast<int16_t>(val1 + val2);
+                            sprs.flags.defer_add(val1, val2, output);
+                            break;
+                        case Opcode::SUB: {
+                            int16_t negated = static_cast<int16_t>(-val2);
+                            output = static_cast<int16_t>(val1 + negated);
+                            sprs.flags.defer_add(val1, negated, output);
+                            break;
+                        }
+                        case Opcode::AND:
+                            output = val1 & val2;
+                            sprs.flags.defer_logic(output);
+                            break;
+                        case Opcode::OR:
+                            output = val1 | val2;
+                            sprs.flags.defer_logic(output);
+                            break;
+                        default:
+                            output = val1 ^ val2;
+                            sprs.flags.defer_logic(output);
+                            break;
+                    }
+                    gprs[instr.rd] = output;
+                    break;
+                }
+                
                 ALUResult result;
                 switch (instr.opcode) {
                     case Opcode::ADD:
@@ -100,7 +416,7 @@ public:
                 sprs.flags.C = result.carry;
                 sprs.flags.V = result.overflow;
                 
-                if (trace_enabled) {
+                if (tracing<Policy>()) {
                     std::cout << "[EXECUTE] R" << static_cast<int>(instr.rd) 
                               << " = " << val1 << " op " << val2 << " = " 
                               << result.output << std::endl;
@@ -109,6 +425,8 @@ public:
             }
             
             case Opcode::NOT: {
+                // NOT and the shifts keep some flags, so settle any pending ones first
+                if constexpr (Policy::lazy_flags) sprs.flags.resolve();
                 gprs[instr.rd] = ~gprs[instr.rs1];
                 sprs.flags.Z = (gprs[instr.rd] == 0);
                 sprs.flags.N = (gprs[instr.rd] < 0);
@@ -117,6 +435,7 @@ public:
             
             case Opcode::SHL:
             case Opcode::SHR: {
+                if constexpr (Policy::lazy_flags) sprs.flags.resolve();
                 int16_t val = gprs[instr.rs1];
                 int16_t shift = instr.imm;
                 
@@ -132,7 +451,7 @@ public:
                 sprs.flags.N = result.negative;
                 sprs.flags.C = result.carry;
                 
-                if (trace_enabled) {
+                if (tracing<Policy>()) {
                     std::cout << "[EXECUTE] R" << static_cast<int>(instr.rd) 
                               << " = R" << static_cast<int>(instr.rs1) 
                               << " shift " << static_cast<int>(shift) << std::endl;
@@ -143,7 +462,7 @@ public:
             case Opcode::LDI: {
                 // Load immediate (sign-extended)
                 gprs[instr.rd] = static_cast<int16_t>(instr.imm);
-                if (trace_enabled) {
+                if (tracing<Policy>()) {
                     std::cout << "[EXECUTE] R" << static_cast<int>(instr.rd) 
                               << " = " << static_cast<int>(instr.imm) << std::endl;
                 }
@@ -153,15 +472,20 @@ public:
             case Opcode::LD: {
                 // Load from memory: RD = MEM[RS1 + IMM]
                 uint16_t addr = static_cast<uint16_t>(gprs[instr.rs1] + instr.imm);
-                buses.control_bus.mem_read = true;
-                buses.info_bus.data = addr;
-                buses.info_bus.valid = true;
+                if constexpr (Policy::drive_buses) {
+                    buses.control_bus.mem_read = true;
+                    buses.info_bus.data = addr;
+                    buses.info_bus.valid = true;
+                }
+                if constexpr (Policy::observe) access_address = addr;
                 uint16_t value = memory.read_word(addr);
-                buses.control_bus.mem_read = false;
-                buses.info_bus.valid = false;
+                if constexpr (Policy::drive_buses) {
+                    buses.control_bus.mem_read = false;
+                    buses.info_bus.valid = false;
+                }
                 gprs[instr.rd] = static_cast<int16_t>(value);
                 
-                if (trace_enabled) {
+                if (tracing<Policy>()) {
                     std::cout << "[EXECUTE] R" << static_cast<int>(instr.rd) 
                               << " = MEM[0x" << std::hex << addr << "] = " 
                               << std::dec << gprs[instr.rd] << std::endl;
@@ -172,14 +496,21 @@ public:
             case Opcode::ST: {
                 // Store to memory: MEM[RS1 + IMM] = RD
                 uint16_t addr = static_cast<uint16_t>(gprs[instr.rs1] + instr.imm);
-                buses.control_bus.mem_write = true;
-                buses.info_bus.data = static_cast<uint16_t>(gprs[instr.rd]);
-                buses.info_bus.valid = true;
-                memory.write_word(addr, buses.info_bus.data);
-                buses.control_bus.mem_write = false;
-                buses.info_bus.valid = false;
+                uint16_t value = static_cast<uint16_t>(gprs[instr.rd]);
+                if constexpr (Policy::drive_buses) {
+                    buses.control_bus.mem_write = true;
+                    buses.info_bus.data = value;
+                    buses.info_bus.valid = true;
+                }
+                if constexpr (Policy::observe) access_address = addr;
+                memory.write_word(addr, value, cycle_count - 1);
+                if constexpr (Policy::drive_buses) {
+                    buses.control_bus.mem_write = false;
+                    buses.info_bus.valid = false;
+                }
+                slice_ended = memory.is_slice_ended();
                 
-                if (trace_enabled) {
+                if (tracing<Policy>()) {
                     std::cout << "[EXECUTE] MEM[0x" << std::hex << addr << "] = R" 
                               << std::dec << static_cast<int>(instr.rd) 
                               << " = " << gprs[instr.rd] << std::endl;
@@ -198,7 +529,7 @@ public:
                 sprs.PC = new_pc;
                 pc_updated = true;
                 
-                if (trace_enabled) {
+                if (tracing<Policy>()) {
                     std::cout << "[EXECUTE] Jump to 0x" << std::hex << new_pc << std::dec << std::endl;
                 }
                 break;
@@ -206,16 +537,16 @@ public:
             
             case Opcode::JZ: {
                 // Jump if zero flag is set
-                if (sprs.flags.Z) {
+                if (Policy::lazy_flags ? sprs.flags.zero() : sprs.flags.Z) {
                     uint16_t base = (gprs[instr.rs1] == 0) ? (sprs.PC + 2) : gprs[instr.rs1];
                     uint16_t new_pc = static_cast<uint16_t>(base + static_cast<int16_t>(instr.imm));
                     sprs.PC = new_pc;
                     pc_updated = true;
-                    if (trace_enabled) {
+                    if (tracing<Policy>()) {
                         std::cout << "[EXECUTE] Jump (Z=1) to 0x" << std::hex << new_pc << std::dec << std::endl;
                     }
                 } else {
-                    if (trace_enabled) {
+                    if (tracing<Policy>()) {
                         std::cout << "[EXECUTE] Jump skipped (Z=0)" << std::endl;
                     }
                 }
@@ -224,16 +555,16 @@ public:
             
             case Opcode::JNZ: {
                 // Jump if zero flag is not set
-                if (!sprs.flags.Z) {
+                if (!(Policy::lazy_flags ? sprs.flags.zero() : sprs.flags.Z)) {
                     uint16_t base = (gprs[instr.rs1] == 0) ? (sprs.PC + 2) : gprs[instr.rs1];
                     uint16_t new_pc = static_cast<uint16_t>(base + static_cast<int16_t>(instr.imm));
                     sprs.PC = new_pc;
                     pc_updated = true;
-                    if (trace_enabled) {
+                    if (tracing<Policy>()) {
                         std::cout << "[EXECUTE] Jump (Z=0) to 0x" << std::hex << new_pc << std::dec << std::endl;
                     }
                 } else {
-                    if (trace_enabled) {
+                    if (tracing<Policy>()) {
                         std::cout << "[EXECUTE] Jump skipped (Z=1)" << std::endl;
                     }
                 }
@@ -242,9 +573,12 @@ public:
             
             case Opcode::HLT: {
                 halted = true;
-                if (trace_enabled) {
+                if (tracing<Policy>()) {
                     std::cout << "[EXECUTE] HALT" << std::endl;
                 }
+                if constexpr (Policy::observe) {
+                    observe(memory, pc, instruction_word, instr, gprs, false, 0);
+                }
                 return false;
             }
         }
@@ -254,12 +588,16 @@ public:
             sprs.PC += 2;  // Instructions are 2 bytes
         }
         
-        if (trace_enabled) {
+        if constexpr (Policy::observe) {
+            observe(memory, pc, instruction_word, instr, gprs, pc_updated, access_address);
+        }
+        
+        if (tracing<Policy>()) {
             std::cout << "[STORE] PC updated to 0x" << std::hex << std::setw(4) 
                       << std::setfill('0') << sprs.PC << std::dec << std::endl;
         }
         
-        return true;
+        return !slice_ended;
     }
 };
 
@@ -0,0 +1,99 @@
+#pragma once
+
+#include "isa.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+namespace cpu {
+
+// Predecoded instruction record, ready to dispatch without touching memory
+struct DecodedInstruction {
+    Instruction instr;
+    uint16_t word = 0;   // Raw instruction word (kept for trace output)
+    bool valid = false;
+};
+
+// Predecoded instruction cache keyed by PC
+// One slot per even address below the I/O page; odd or I/O PCs are decoded
+// on every fetch since they can never be cached safely.
+class DecodeCache {
+public:
+    static constexpr size_t SLOT_COUNT = 0xFF00 / 2;
+
+private:
+    std::vector<DecodedInstruction> slots;  // Allocated on first fill
+    std::vector<uint16_t> filled;           // Slots made valid since the last clear
+    DecodedInstruction scratch;             // Result for uncacheable PCs
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t invalidations = 0;
+
+public:
+    static bool cacheable(uint16_t pc) {
+        return (pc & 1) == 0 && pc < 0xFF00;
+    }
+
+    // Look up a PC; returns nullptr on miss
+    const DecodedInstruction* find(uint16_t pc) {
+        if (cacheable(pc) && !slots.empty()) {
+            const DecodedInstruction& slot = slots[pc >> 1];
+            if (slot.valid) {
+                hits++;
+                return &slot;
+            }
+        }
+        misses++;
+        return nullptr;
+    }
+
+    // Decode a freshly fetched word and remember it for the next fetch of pc
+    const DecodedInstruction& fill(uint16_t pc, uint16_t word) {
+        DecodedInstruction* slot = &scratch;
+        if (cacheable(pc)) {
+            if (slots.empty()) slots.resize(SLOT_COUNT);
+            slot = &slots[pc >> 1];
+            // Past the cap clear() wipes every slot, so stop recording
+            if (!slot->valid && filled.size() <= SLOT_COUNT / 8) {
+                filled.push_back(static_cast<uint16_t>(pc >> 1));
+            }
+        }
+        slot->instr = Instruction::decode(word);
+        slot->word = word;
+        slot->valid = cacheable(pc);
+        return *slot;
+    }
+
+    // Drop the slot covering a written byte (self-modifying code)
+    void invalidate(uint16_t address) {
+        if (slots.empty() || address >= 0xFF00) return;
+        DecodedInstruction& slot = slots[address >> 1];
+        if (slot.valid) {
+            slot.valid = false;
+            invalidations++;
+        }
+    }
+
+    // Invalidate every slot but keep the allocation; a small program only
+    // touches the slots it filled, so switching between guests is cheap
+    void clear() {
+        if (filled.size() > SLOT_COUNT / 8) {
+            std::fill(slots.begin(), slots.end(), DecodedInstruction{});
+        } else {
+            for (uint16_t index : filled) slots[index].valid = false;
+        }
+        filled.clear();
+    }
+
+    void reset_stats() {
+        hits = 0;
+        misses = 0;
+        invalidations = 0;
+    }
+
+    uint64_t get_hits() const { return hits; }
+    uint64_t get_misses() const { return misses; }
+    uint64_t get_invalidations() const { return invalidations; }
+};
+
+} // namespace cpu
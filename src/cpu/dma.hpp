@@ -0,0 +1,144 @@
+#pragma once
+
+#include "interrupts.hpp"
+#include "memory.hpp"
+#include <cstdint>
+#include <iostream>
+
+namespace cpu {
+
+// DMA block-copy controller
+// Four registers in the I/O page: SRC, DST and LEN (16-bit, LEN in bytes)
+// and CTRL. Writing CTRL with GO set copies LEN bytes from SRC to DST with
+// memmove semantics, or with FILL set stores the low byte of SRC into LEN
+// bytes at DST, page-sized chunks at a time on the host. The transfer is
+// modeled as SETUP_CYCLES plus one cycle per BYTES_PER_CYCLE bytes. A
+// synchronous transfer (TIMED clear) finishes within the store and reads
+// back DONE at once; a timed one reads BUSY until the modeled cycles have
+// passed since the store to CTRL, then DONE. RAM holds the result in both cases
+// from the start, but a guest should only rely on it once DONE is set.
+// Writing CTRL without GO clears DONE; a write while BUSY is ignored.
+// Every completion also raises the DMA line on the interrupt controller.
+// The registers and status live in the machine's backing RAM, including
+// DUE (the low 32 bits of a timed transfer's completion cycle), so a
+// restored snapshot or image finishes the transfer on time; the device
+// itself only keeps host-side counters.
+class DmaController : public Device {
+public:
+    static constexpr uint16_t SRC = 0xFF04;
+    static constexpr uint16_t DST = 0xFF06;
+    static constexpr uint16_t LEN = 0xFF08;
+    static constexpr uint16_t CTRL = 0xFF0A;
+    static constexpr uint16_t DUE = 0xFF0C;      // Read-only
+    static constexpr uint16_t LAST = 0xFF0F;
+
+    // CTRL bits written by the guest
+    static constexpr uint8_t GO = 0x01;
+    static constexpr uint8_t FILL = 0x02;
+    static constexpr uint8_t TIMED = 0x04;
+    // CTRL bits read back
+    static constexpr uint8_t BUSY = 0x01;
+    static constexpr uint8_t DONE = 0x02;
+
+    static constexpr uint64_t SETUP_CYCLES = 4;
+    static constexpr uint64_t BYTES_PER_CYCLE = 2;  // One word per cycle
+
+private:
+    uint64_t copies = 0;
+    uint64_t fills = 0;
+    uint64_t timed = 0;
+    uint64_t bytes = 0;
+    uint64_t cycles = 0;  // Modeled transfer cycles charged
+
+    static uint16_t register_word(const Memory& memory, uint16_t address) {
+        return static_cast<uint16_t>(memory.read_backing(address) | (memory.read_backing(address + 1) << 8));
+    }
+
+    void arm(Memory& memory, uint64_t due) {
+        for (uint16_t i = 0; i < 4; i++) {
+            memory.write_backing(static_cast<uint16_t>(DUE + i), static_cast<uint8_t>(due >> (8 * i)));
+        }
+        memory.schedule(this, due);
+    }
+
+    static uint32_t saved_due(const Memory& memory) {
+        uint32_t due = 0;
+        for (uint16_t i = 0; i < 4; i++) {
+            due |= static_cast<uint32_t>(memory.read_backing(static_cast<uint16_t>(DUE + i))) << (8 * i);
+        }
+        return due;
+    }
+
+public:
+    static uint64_t transfer_cycles(uint16_t length) {
+        return SETUP_CYCLES + (length + BYTES_PER_CYCLE - 1) / BYTES_PER_CYCLE;
+    }
+
+    uint8_t read(const Memory& memory, uint16_t address) override {
+        return memory.read_backing(address);
+    }
+
+    void write(Memory& memory, uint16_t address, uint8_t value) override {
+        if (address >= DUE) return;
+        if (address != CTRL) {
+            memory.write_backing(address, value);
+            return;
+        }
+        if (memory.read_backing(CTRL) & BUSY) return;
+        if (!(value & GO)) {
+            memory.write_backing(CTRL, 0);
+            return;
+        }
+        uint16_t source = register_word(memory, SRC);
+        uint16_t destination = register_word(memory, DST);
+        uint16_t length = register_word(memory, LEN);
+        if (value & FILL) {
+            memory.fill_block(destination, static_cast<uint8_t>(source), length);
+        } else {
+            memory.copy_block(destination, source, length);
+        }
+        uint64_t duration = transfer_cycles(length);
+        if (value & TIMED) {
+            memory.write_backing(CTRL, BUSY);
+            arm(memory, memory.device_clock() + duration);
+        } else {
+            memory.write_backing(CTRL, DONE);
+            InterruptController::raise(memory, InterruptController::DMA_LINE);
+        }
+        if (memory.is_replay()) return;
+        (value & FILL ? fills : copies)++;
+        if (value & TIMED) timed++;
+        bytes += length;
+        cycles += duration;
+    }
+
+    void tick(Memory& memory, uint64_t) override {
+        if (!(memory.read_backing(CTRL) & BUSY)) return;
+        memory.write_backing(CTRL, DONE);
+        InterruptController::raise(memory, InterruptController::DMA_LINE);
+    }
+
+    // A transfer in flight completes at its saved due cycle. One further
+    // away than the longest transfer cannot belong to this cycle count
+    // (e.g. after a reset), so that one is finished now (its data is
+    // already in RAM).
+    void restart(Memory& memory, uint64_t now) override {
+        if (!(memory.read_backing(CTRL) & BUSY)) return;
+        uint64_t remaining = static_cast<uint32_t>(saved_due(memory) - static_cast<uint32_t>(now));
+        if (remaining <= transfer_cycles(0xFFFF)) {
+            memory.schedule(this, now + remaining);
+        } else {
+            tick(memory, now);
+        }
+    }
+
+    uint64_t get_bytes() const { return bytes; }
+    uint64_t get_cycles() const { return cycles; }
+
+    void print_stats() const {
+        std::cout << "DMA: " << (copies + fills) << " transfers (" << copies << " copies, " << fills << " fills, "
+                  << timed << " timed), " << bytes << " bytes, " << cycles << " modeled cycles charged" << std::endl;
+    }
+};
+
+} // namespace cpu
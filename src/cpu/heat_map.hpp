@@ -0,0 +1,280 @@
+#pragma once
+
+#include "isa.hpp"
+#include "memory.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cpu {
+
+// Memory access heat map
+// Counts instruction fetches and LD/ST reads and writes per byte address
+// (a word access counts at its first byte), bumped by the switch
+// interpreter while a heat map is attached to the control unit. Reports sum
+// them into 16-byte lines and 256-byte pages; accesses that land on a
+// device mapping are listed per register. The working set is sampled every
+// window instructions as the number of distinct lines and pages touched in
+// that window, using a per-line stamp so the hot path stays O(1).
+class HeatMap {
+public:
+    static constexpr unsigned LINE_SHIFT = 4;     // 16-byte lines
+    static constexpr unsigned PAGE_SHIFT = 8;     // 256-byte pages
+    static constexpr size_t LINE_COUNT = Memory::MEMORY_SIZE >> LINE_SHIFT;
+    static constexpr size_t PAGE_COUNT = Memory::MEMORY_SIZE >> PAGE_SHIFT;
+    static constexpr uint64_t DEFAULT_WINDOW = 1 << 16;
+
+    struct Sample {
+        uint32_t lines;
+        uint32_t pages;
+    };
+
+    struct Counts {
+        uint64_t fetches = 0;
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+        uint64_t total() const { return fetches + reads + writes; }
+    };
+
+private:
+    std::vector<uint64_t> fetches;
+    std::vector<uint64_t> reads;
+    std::vector<uint64_t> writes;
+
+    // Working set of the current window: a line or page was touched in it
+    // when its stamp equals the window number (which starts at 1)
+    std::vector<uint32_t> line_stamps;
+    std::vector<uint32_t> page_stamps;
+    uint32_t window_id = 1;
+    uint32_t window_lines = 0;
+    uint32_t window_pages = 0;
+    uint64_t window = DEFAULT_WINDOW;
+    uint64_t window_left = DEFAULT_WINDOW;
+    std::vector<Sample> samples;
+    uint64_t instructions = 0;
+
+    void touch(uint16_t address) {
+        uint32_t line = address >> LINE_SHIFT;
+        if (line_stamps[line] != window_id) {
+            line_stamps[line] = window_id;
+            window_lines++;
+            uint32_t page = address >> PAGE_SHIFT;
+            if (page_stamps[page] != window_id) {
+                page_stamps[page] = window_id;
+                window_pages++;
+            }
+        }
+    }
+
+    void close_window() {
+        samples.push_back({window_lines, window_pages});
+        window_lines = window_pages = 0;
+        window_left = window;
+        if (++window_id == 0) {
+            // Stamps wrapped; forget them all
+            std::fill(line_stamps.begin(), line_stamps.end(), 0);
+            std::fill(page_stamps.begin(), page_stamps.end(), 0);
+            window_id = 1;
+        }
+    }
+
+    Counts sum(size_t first, size_t count) const {
+        Counts counts;
+        for (size_t a = first; a < first + count; a++) {
+            counts.fetches += fetches[a];
+            counts.reads += reads[a];
+            counts.writes += writes[a];
+        }
+        return counts;
+    }
+
+    // Blocks of 2^shift bytes with any access, hottest first
+    std::vector<std::pair<uint16_t, Counts>> blocks(unsigned shift) const {
+        std::vector<std::pair<uint16_t, Counts>> result;
+        size_t size = size_t(1) << shift;
+        for (size_t base = 0; base < Memory::MEMORY_SIZE; base += size) {
+            Counts counts = sum(base, size);
+            if (counts.total() > 0) result.push_back({static_cast<uint16_t>(base), counts});
+        }
+        std::stable_sort(result.begin(), result.end(),
+                         [](const auto& a, const auto& b) { return a.second.total() > b.second.total(); });
+        return result;
+    }
+
+    static void print_counts(const Counts& counts) {
+        std::cout << std::setw(14) << counts.fetches << std::setw(14) << counts.reads << std::setw(14)
+                  << counts.writes;
+    }
+
+public:
+    HeatMap()
+        : fetches(Memory::MEMORY_SIZE, 0), reads(Memory::MEMORY_SIZE, 0), writes(Memory::MEMORY_SIZE, 0),
+          line_stamps(LINE_COUNT, 0), page_stamps(PAGE_COUNT, 0) {}
+
+    // One instruction at pc; address is its LD/ST effective address
+    void count(uint16_t pc, Opcode op, uint16_t address) {
+        fetches[pc]++;
+        touch(pc);
+        if (op == Opcode::LD) {
+            reads[address]++;
+            touch(address);
+        } else if (op == Opcode::ST) {
+            writes[address]++;
+            touch(address);
+        }
+        instructions++;
+        if (--window_left == 0) close_window();
+    }
+
+    // Instructions per working-set sample; clears the counts
+    void set_window(uint64_t instructions_per_window) {
+        window = std::max<uint64_t>(instructions_per_window, 1);
+        clear();
+    }
+
+    uint64_t get_window() const { return window; }
+
+    void clear() {
+        std::fill(fetches.begin(), fetches.end(), 0);
+        std::fill(reads.begin(), reads.end(), 0);
+        std::fill(writes.begin(), writes.end(), 0);
+        std::fill(line_stamps.begin(), line_stamps.end(), 0);
+        std::fill(page_stamps.begin(), page_stamps.end(), 0);
+        window_id = 1;
+        window_lines = window_pages = 0;
+        window_left = window;
+        samples.clear();
+        instructions = 0;
+    }
+
+    Counts get_counts(uint16_t address) const {
+        return Counts{fetches[address], reads[address], writes[address]};
+    }
+
+    const std::vector<Sample>& get_samples() const { return samples; }
+
+    // Word accesses that include the byte at address (those at it and the
+    // byte before)
+    uint64_t touching(size_t address) const {
+        uint64_t count = fetches[address] + reads[address] + writes[address];
+        if (address > 0) count += fetches[address - 1] + reads[address - 1] + writes[address - 1];
+        return count;
+    }
+
+    // One character per byte of [start, start + length) for overlaying a RAM
+    // dump: ' ' never accessed, then '.' to '@' on a log scale up to the
+    // busiest byte in memory
+    std::vector<char> glyphs(uint16_t start, size_t length) const {
+        static const char RAMP[] = ".:-=+*#%@";
+        uint64_t peak = 1;
+        for (size_t a = 0; a < Memory::MEMORY_SIZE; a++) peak = std::max(peak, touching(a));
+        double scale = std::log2(static_cast<double>(peak) + 1);
+        std::vector<char> result(length, ' ');
+        for (size_t i = 0; i < length && start + i < Memory::MEMORY_SIZE; i++) {
+            uint64_t count = touching(start + i);
+            if (count == 0) continue;
+            double level = std::log2(static_cast<double>(count)) / scale;
+            result[i] = RAMP[std::min<size_t>(sizeof(RAMP) - 2, static_cast<size_t>(level * (sizeof(RAMP) - 1)))];
+        }
+        return result;
+    }
+
+    // Hottest lines and pages, device registers and the working set
+    void print_report(const Memory& memory, size_t top = 10) const {
+        std::cout << "\n=== Memory Heat Map ===" << std::endl;
+        std::cout << "Instructions: " << instructions << std::endl;
+        std::cout << std::setfill(' ');
+        const unsigned shifts[2] = {LINE_SHIFT, PAGE_SHIFT};
+        for (unsigned shift : shifts) {
+            auto rows = blocks(shift);
+            std::cout << (shift == LINE_SHIFT ? "16-byte lines" : "256-byte pages") << " (" << rows.size()
+                      << " touched, top " << std::min(top, rows.size()) << "):" << std::endl;
+            std::cout << "  range          " << std::setw(14) << "fetches" << std::setw(14) << "reads"
+                      << std::setw(14) << "writes" << std::endl;
+            for (size_t i = 0; i < rows.size() && i < top; i++) {
+                uint32_t last = rows[i].first + (1u << shift) - 1;
+                std::cout << "  0x" << std::hex << std::setw(4) << std::setfill('0') << rows[i].first << "-0x"
+                          << std::setw(4) << last << std::dec << std::setfill(' ') << "  ";
+                print_counts(rows[i].second);
+                std::cout << std::endl;
+            }
+        }
+
+        std::cout << "Device registers:" << std::endl;
+        bool any = false;
+        for (size_t a = 0; a < Memory::MEMORY_SIZE; a++) {
+            if (reads[a] + writes[a] == 0 || !memory.get_devices().find(static_cast<uint16_t>(a))) continue;
+            std::cout << "  0x" << std::hex << std::setw(4) << std::setfill('0') << a << std::dec
+                      << std::setfill(' ') << "  reads " << reads[a] << ", writes " << writes[a] << std::endl;
+            any = true;
+        }
+        if (!any) std::cout << "  (none)" << std::endl;
+
+        std::cout << "Working set per " << window << " instructions: ";
+        if (samples.empty()) {
+            std::cout << "no complete window; " << window_lines << " lines, " << window_pages
+                      << " pages so far" << std::endl;
+            return;
+        }
+        uint64_t line_sum = 0, page_sum = 0;
+        Sample low = samples[0], high = samples[0];
+        for (const Sample& s : samples) {
+            line_sum += s.lines;
+            page_sum += s.pages;
+            low.lines = std::min(low.lines, s.lines);
+            low.pages = std::min(low.pages, s.pages);
+            high.lines = std::max(high.lines, s.lines);
+            high.pages = std::max(high.pages, s.pages);
+        }
+        std::cout << samples.size() << " windows" << std::endl;
+        std::cout << std::fixed << std::setprecision(1);
+        std::cout << "  lines: min " << low.lines << ", mean " << static_cast<double>(line_sum) / samples.size()
+                  << ", max " << high.lines << " (" << (high.lines << LINE_SHIFT) << " bytes)" << std::endl;
+        std::cout << "  pages: min " << low.pages << ", mean " << static_cast<double>(page_sum) / samples.size()
+                  << ", max " << high.pages << std::endl;
+        std::cout << std::defaultfloat;
+    }
+
+    // Line, page and device register counts plus every working-set sample;
+    // throws std::runtime_error if the file cannot be written
+    void write_json(const std::string& filename, const Memory& memory) const {
+        std::ofstream out(filename);
+        if (!out) throw std::runtime_error("Cannot write heat map: " + filename);
+        out << "{\n  \"instructions\": " << instructions << ",\n  \"window\": " << window;
+        const unsigned shifts[2] = {LINE_SHIFT, PAGE_SHIFT};
+        for (unsigned shift : shifts) {
+            auto rows = blocks(shift);
+            std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+            out << ",\n  \"" << (shift == LINE_SHIFT ? "lines" : "pages") << "\": [";
+            for (size_t i = 0; i < rows.size(); i++) {
+                out << (i ? "," : "") << "\n    {\"address\": " << rows[i].first << ", \"fetches\": "
+                    << rows[i].second.fetches << ", \"reads\": " << rows[i].second.reads << ", \"writes\": "
+                    << rows[i].second.writes << "}";
+            }
+            out << (rows.empty() ? "" : "\n  ") << "]";
+        }
+        out << ",\n  \"registers\": [";
+        bool first = true;
+        for (size_t a = 0; a < Memory::MEMORY_SIZE; a++) {
+            if (reads[a] + writes[a] == 0 || !memory.get_devices().find(static_cast<uint16_t>(a))) continue;
+            out << (first ? "" : ",") << "\n    {\"address\": " << a << ", \"reads\": " << reads[a]
+                << ", \"writes\": " << writes[a] << "}";
+            first = false;
+        }
+        out << (first ? "" : "\n  ") << "],\n  \"working_set\": [";
+        for (size_t i = 0; i < samples.size(); i++) {
+            out << (i ? "," : "") << "\n    {\"lines\": " << samples[i].lines << ", \"pages\": " << samples[i].pages
+                << "}";
+        }
+        out << (samples.empty() ? "" : "\n  ") << "]\n}\n";
+        if (!out) throw std::runtime_error("Cannot write heat map: " + filename);
+    }
+};
+
+} // namespace cpu
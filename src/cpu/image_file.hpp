@@ -0,0 +1,278 @@
+#pragma once
+
+#include "memory.hpp"
+#include "registers.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define CPU_IMAGE_MMAP 1
+#else
+#define CPU_IMAGE_MMAP 0
+#endif
+
+namespace cpu {
+
+// Versioned binary machine image: registers plus some or all RAM pages
+//
+//   header      Header (fixed size, host byte order, little-endian in practice)
+//   index       one byte per stored page: its page number, ascending
+//   padding     up to a 256-byte boundary
+//   data        the stored pages, 256 bytes each, in index order
+//
+// Pages are written one at a time straight from the page table. Loading maps
+// the file: an image holding all 256 pages becomes the Memory's shared
+// image in place (copy-on-write, so nothing is read until it is touched);
+// a partial image copies just its pages out of the mapping.
+class ImageFile {
+public:
+    static constexpr char MAGIC[8] = {'C', 'P', 'U', 'I', 'M', 'A', 'G', 'E'};
+    static constexpr uint32_t VERSION = 1;
+
+    enum Flags : uint32_t {
+        HAS_REGISTERS = 1,  // Registers, cycle count and halt state are valid
+        CHANGED_ONLY = 2,   // Pages are those that differed from the image hashed in base_hash
+    };
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t header_size;
+        uint32_t flags;
+        uint32_t page_count;
+        uint32_t index_offset;
+        uint32_t data_offset;
+        uint32_t range_start;   // RAM bytes covered: [range_start, range_start + range_length)
+        uint32_t range_length;
+        uint64_t base_hash;
+        uint64_t cycle_count;
+        int16_t gprs[8];
+        uint16_t pc;
+        uint16_t sp;
+        uint16_t program_start;
+        uint8_t flags_byte;
+        uint8_t halted;
+    };
+    static_assert(sizeof(Header) == 80, "image header layout changed");
+
+    // Register state stored alongside RAM
+    struct Machine {
+        GPRs gprs;
+        SPRs sprs;
+        uint64_t cycle_count = 0;
+        bool halted = false;
+        uint16_t program_start = 0;
+    };
+
+    struct Summary {
+        size_t pages = 0;        // Pages written or loaded
+        size_t file_bytes = 0;
+        bool mapped = false;     // Loaded as the shared image without copying
+        bool has_registers = false;
+        bool changed_only = false;
+    };
+
+private:
+    // A read-only mapping of a whole image file, unmapped with its last user
+    class Mapping {
+    public:
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+        std::vector<uint8_t> fallback;  // Hosts without mmap read the file instead
+
+        ~Mapping() {
+#if CPU_IMAGE_MMAP
+            if (data && fallback.empty()) ::munmap(const_cast<uint8_t*>(data), size);
+#endif
+        }
+    };
+
+    static std::shared_ptr<Mapping> map_file(const std::string& path) {
+        auto mapping = std::make_shared<Mapping>();
+#if CPU_IMAGE_MMAP
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open image: " + path);
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(Header))) {
+            ::close(fd);
+            throw std::runtime_error("Not a machine image: " + path);
+        }
+        mapping->size = static_cast<size_t>(info.st_size);
+        void* base = ::mmap(nullptr, mapping->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED) throw std::runtime_error("Cannot map image: " + path);
+        mapping->data = static_cast<const uint8_t*>(base);
+#else
+        std::ifstream file(path, std::ios::binary);
+        if (!file) throw std::runtime_error("Cannot open image: " + path);
+        mapping->fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        if (mapping->fallback.size() < sizeof(Header)) throw std::runtime_error("Not a machine image: " + path);
+        mapping->data = mapping->fallback.data();
+        mapping->size = mapping->fallback.size();
+#endif
+        return mapping;
+    }
+
+    static uint32_t round_up(uint32_t value, uint32_t unit) {
+        return (value + unit - 1) / unit * unit;
+    }
+
+public:
+    // FNV-1a over a full 64KB image, to tie changed-page images to their base
+    static uint64_t hash_image(const uint8_t* bytes) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < Memory::MEMORY_SIZE; i++) {
+            hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    // Write the pages overlapping [start, start + length) and, if given, the
+    // machine's registers. With a base (a full 64KB image), only pages that
+    // differ from it are kept, so a chain of small dumps can follow one full
+    // one. Throws std::runtime_error if the file cannot be written.
+    static Summary save(const std::string& path, const Memory& memory, const Machine* machine,
+                        uint32_t start = 0, uint32_t length = Memory::MEMORY_SIZE,
+                        const uint8_t* base = nullptr) {
+        bool changed_only = base != nullptr;
+        start = std::min<uint32_t>(start, Memory::MEMORY_SIZE);
+        length = std::min<uint32_t>(length, Memory::MEMORY_SIZE - start);
+
+        std::vector<uint8_t> index;
+        if (length > 0) {
+            for (size_t page = start / Memory::PAGE_SIZE; page <= (start + length - 1) / Memory::PAGE_SIZE; page++) {
+                if (changed_only &&
+                    std::memcmp(memory.page_bytes(page), base + page * Memory::PAGE_SIZE, Memory::PAGE_SIZE) == 0) {
+                    continue;
+                }
+                index.push_back(static_cast<uint8_t>(page));
+            }
+        }
+
+        Header header = {};
+        std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+        header.version = VERSION;
+        header.header_size = sizeof(Header);
+        header.flags = (machine ? uint32_t(HAS_REGISTERS) : 0u) | (changed_only ? uint32_t(CHANGED_ONLY) : 0u);
+        header.page_count = static_cast<uint32_t>(index.size());
+        header.index_offset = sizeof(Header);
+        header.data_offset = round_up(header.index_offset + header.page_count, Memory::PAGE_SIZE);
+        header.range_start = start;
+        header.range_length = length;
+        if (changed_only) header.base_hash = hash_image(base);
+        if (machine) {
+            for (int r = 0; r < 8; r++) header.gprs[r] = machine->gprs[r];
+            header.pc = machine->sprs.PC;
+            header.sp = machine->sprs.SP;
+            header.flags_byte = machine->sprs.flags.to_byte();
+            header.cycle_count = machine->cycle_count;
+            header.halted = machine->halted ? 1 : 0;
+            header.program_start = machine->program_start;
+        }
+
+        // Written beside the target and renamed over it, so a Memory still
+        // mapping the old file keeps its pages
+        std::string temporary = path + ".tmp";
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file) throw std::runtime_error("Cannot create image: " + temporary);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(index.data()), static_cast<std::streamsize>(index.size()));
+        std::vector<char> padding(header.data_offset - header.index_offset - header.page_count, 0);
+        file.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+        for (uint8_t page : index) {
+            file.write(reinterpret_cast<const char*>(memory.page_bytes(page)), Memory::PAGE_SIZE);
+        }
+        file.close();
+        if (!file || std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Error writing image: " + path);
+        }
+
+        Summary summary;
+        summary.pages = index.size();
+        summary.file_bytes = header.data_offset + index.size() * Memory::PAGE_SIZE;
+        summary.has_registers = machine != nullptr;
+        summary.changed_only = changed_only;
+        return summary;
+    }
+
+    // Load an image into memory and, if it has them, fill machine with its
+    // registers. A complete image replaces RAM with the mapped file (the
+    // caller drops decoded code); any other copies its pages in. A
+    // changed-page image only goes onto RAM mapping the base it was taken
+    // against, and first puts every page back to that base.
+    // Throws std::runtime_error for unreadable or malformed files.
+    static Summary load(const std::string& path, Memory& memory, Machine& machine) {
+        std::shared_ptr<Mapping> mapping = map_file(path);
+        Header header;
+        std::memcpy(&header, mapping->data, sizeof(header));
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0) {
+            throw std::runtime_error("Not a machine image: " + path);
+        }
+        if (header.version != VERSION || header.header_size != sizeof(Header)) {
+            throw std::runtime_error("Unsupported image version " + std::to_string(header.version) + ": " + path);
+        }
+        uint64_t data_end = static_cast<uint64_t>(header.data_offset) +
+                            static_cast<uint64_t>(header.page_count) * Memory::PAGE_SIZE;
+        if (header.page_count > Memory::PAGE_COUNT || header.index_offset < sizeof(Header) ||
+            header.index_offset + header.page_count > header.data_offset ||
+            header.data_offset % Memory::PAGE_SIZE != 0 || data_end > mapping->size ||
+            header.range_start + static_cast<uint64_t>(header.range_length) > Memory::MEMORY_SIZE) {
+            throw std::runtime_error("Corrupt image: " + path);
+        }
+        const uint8_t* index = mapping->data + header.index_offset;
+        const uint8_t* data = mapping->data + header.data_offset;
+        for (uint32_t i = 1; i < header.page_count; i++) {
+            if (index[i] <= index[i - 1]) throw std::runtime_error("Corrupt image: " + path);
+        }
+        if ((header.flags & CHANGED_ONLY) && header.base_hash != hash_image(memory.shared_image().get())) {
+            throw std::runtime_error("Image holds changed pages of a different base image: " + path);
+        }
+
+        Summary summary;
+        summary.pages = header.page_count;
+        summary.file_bytes = mapping->size;
+        summary.has_registers = (header.flags & HAS_REGISTERS) != 0;
+        summary.changed_only = (header.flags & CHANGED_ONLY) != 0;
+        if (header.page_count == Memory::PAGE_COUNT && header.range_length == Memory::MEMORY_SIZE) {
+            // Every page, in order: the data section is a complete 64KB image
+            memory.map_image(Memory::SharedImage(mapping, data));
+            summary.mapped = true;
+        } else {
+            // Pages the image leaves out are the base's, not whatever RAM holds now
+            if (summary.changed_only) memory.map_image(memory.shared_image());
+            uint32_t range_end = header.range_start + header.range_length;
+            for (uint32_t i = 0; i < header.page_count; i++) {
+                uint32_t base = index[i] * static_cast<uint32_t>(Memory::PAGE_SIZE);
+                uint32_t first = std::max(base, header.range_start);
+                uint32_t last = std::min<uint32_t>(base + Memory::PAGE_SIZE, range_end);
+                if (first >= last) continue;
+                memory.write_bytes(static_cast<uint16_t>(first), data + i * Memory::PAGE_SIZE + (first - base),
+                                   last - first);
+            }
+        }
+
+        if (summary.has_registers) {
+            for (int r = 0; r < 8; r++) machine.gprs[r] = header.gprs[r];
+            machine.sprs.PC = header.pc;
+            machine.sprs.SP = header.sp;
+            machine.sprs.flags.from_byte(header.flags_byte);
+            machine.cycle_count = header.cycle_count;
+            machine.halted = header.halted != 0;
+            machine.program_start = header.program_start;
+        }
+        return summary;
+    }
+};
+
+} // namespace cpu
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "spsc_ring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define CPU_CONSOLE_INPUT 1
+#else
+#define CPU_CONSOLE_INPUT 0
+#endif
+
+namespace cpu {
+
+// Guest console input stream
+// A host thread reads the source (stdin, a file or a pipe) straight into
+// the free spans of an SPSC ring with readv, waiting in poll() so it can be
+// stopped. The emulation thread only ever pops from the ring: when no byte
+// has arrived yet STDIN reads 0 and STATUS says so, so the guest never
+// blocks the emulator.
+class ConsoleInput {
+public:
+    // STATUS bits contributed by the input side
+    static constexpr uint8_t STATUS_DATA = 0x02;    // A byte is waiting
+    static constexpr uint8_t STATUS_CLOSED = 0x04;  // End of input and nothing left
+
+private:
+    SpscRing ring;
+    int fd = -1;
+    bool owns_fd = false;
+    std::thread reader;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> closed{false};
+    std::atomic<uint64_t> host_bytes{0};   // Read from the source
+    std::atomic<uint64_t> host_reads{0};   // readv calls that returned data
+    std::atomic<uint64_t> full_waits{0};   // Times the reader found the ring full
+    uint64_t consumed = 0;                 // Bytes handed to the guest
+    uint64_t polls = 0;                    // Guest reads of STDIN or STATUS
+
+    void read_loop() {
+#if CPU_CONSOLE_INPUT
+        while (!stopping.load(std::memory_order_relaxed)) {
+            uint8_t* spans[2];
+            size_t lengths[2];
+            int count = ring.free_spans(spans, lengths);
+            if (count == 0) {
+                full_waits.fetch_add(1, std::memory_order_relaxed);
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            struct pollfd ready = {fd, POLLIN, 0};
+            int polled = ::poll(&ready, 1, 20);
+            if (polled == 0 || (polled < 0 && errno == EINTR)) continue;
+            struct iovec segments[2] = {{spans[0], lengths[0]}, {spans[1], lengths[1]}};
+            ssize_t got = polled < 0 ? -1 : ::readv(fd, segments, count);
+            if (got < 0 && (errno == EINTR || errno == EAGAIN)) continue;
+            if (got <= 0) break;
+            ring.commit(static_cast<size_t>(got));
+            host_bytes.fetch_add(static_cast<uint64_t>(got), std::memory_order_relaxed);
+            host_reads.fetch_add(1, std::memory_order_relaxed);
+        }
+#endif
+        closed.store(true, std::memory_order_release);
+    }
+
+    void start() {
+        stopping.store(false);
+        closed.store(false);
+        reader = std::thread(&ConsoleInput::read_loop, this);
+    }
+
+    void stop() {
+        stopping.store(true);
+        if (reader.joinable()) reader.join();
+    }
+
+public:
+    // Takes over fd; close_fd says whether the destructor closes it
+    ConsoleInput(int source, bool close_fd, size_t capacity = 1 << 16)
+        : ring(capacity), fd(source), owns_fd(close_fd) {
+        start();
+    }
+
+    ~ConsoleInput() {
+        stop();
+#if CPU_CONSOLE_INPUT
+        if (owns_fd) ::close(fd);
+#endif
+    }
+
+    ConsoleInput(const ConsoleInput&) = delete;
+    ConsoleInput& operator=(const ConsoleInput&) = delete;
+
+    // "-" is standard input; anything else is opened for reading. Returns
+    // nullptr if the source cannot be opened.
+    static std::unique_ptr<ConsoleInput> open(const std::string& path, size_t capacity = 1 << 16) {
+#if CPU_CONSOLE_INPUT
+        if (path == "-") return std::make_unique<ConsoleInput>(0, false, capacity);
+        int source = ::open(path.c_str(), O_RDONLY);
+        if (source < 0) return nullptr;
+        return std::make_unique<ConsoleInput>(source, true, capacity);
+#else
+        (void)path;
+        (void)capacity;
+        return nullptr;
+#endif
+    }
+
+    // Emulation thread: next byte, or 0 when none has arrived
+    uint8_t read() {
+        uint8_t byte = 0;
+        polls++;
+        if (ring.pop(byte)) consumed++;
+        return byte;
+    }
+
+    // Emulation thread: STATUS_DATA / STATUS_CLOSED
+    uint8_t status() {
+        polls++;
+        if (!ring.empty()) return STATUS_DATA;
+        // The reader publishes its last bytes before closing
+        if (closed.load(std::memory_order_acquire)) return ring.empty() ? STATUS_CLOSED : STATUS_DATA;
+        return 0;
+    }
+
+    // Start the source over (regular files only), e.g. before each bench run
+    bool rewind() {
+#if CPU_CONSOLE_INPUT
+        stop();
+        bool seekable = ::lseek(fd, 0, SEEK_SET) == 0;
+        if (seekable) {
+            ring.reset();
+            consumed = 0;
+            polls = 0;
+            host_bytes.store(0);
+            host_reads.store(0);
+            full_waits.store(0);
+        }
+        start();
+        return seekable;
+#else
+        return false;
+#endif
+    }
+
+    uint64_t get_consumed() const { return consumed; }
+    uint64_t get_polls() const { return polls; }
+
+    void print_stats() const {
+        std::cout << "Input: " << consumed << " bytes consumed, " << host_bytes.load() << " read in "
+                  << host_reads.load() << " reads, " << full_waits.load() << " full-ring waits (ring "
+                  << ring.capacity() << " bytes)" << (closed.load() ? ", source closed" : "") << std::endl;
+    }
+};
+
+} // namespace cpu
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "memory.hpp"
+#include "registers.hpp"
+#include <cstdint>
+#include <iostream>
+
+namespace cpu {
+
+// Interrupt controller
+// Sixteen request lines latch into PENDING; MASK selects which of them can
+// interrupt and CTRL bit 0 (IE) enables interrupts as a whole. Devices raise
+// lines from their event handlers or stores. Between run slices (exactly at
+// device events, since slices end there, and right after a raise or a MASK
+// or CTRL store that makes an interrupt ready, since those end the slice)
+// CPUEmulator checks for an enabled pending line; if IE is set it saves PC,
+// flags and R0-R7 in the controller, clears IE and jumps to VECTOR. RTI
+// puts them back from the save area (which the handler may edit first) and
+// sets IE again. WFI idles until a masked-in line is pending, whether or
+// not IE is set. Lines stay pending until the handler writes 1s to their
+// PENDING bits. All registers are 16-bit and live in the machine's backing
+// RAM.
+class InterruptController : public Device {
+public:
+    static constexpr uint16_t PENDING = 0xFF30;  // Write 1s to clear
+    static constexpr uint16_t MASK = 0xFF32;
+    static constexpr uint16_t VECTOR = 0xFF34;
+    static constexpr uint16_t CTRL = 0xFF36;
+    static constexpr uint16_t EPC = 0xFF38;      // PC to return to
+    static constexpr uint16_t EFLAGS = 0xFF3A;   // Flags byte (Z=1, N=2, C=4, V=8)
+    static constexpr uint16_t SAVED = 0xFF40;    // R0-R7, two bytes each
+    static constexpr uint16_t LAST = 0xFF4F;
+
+    static constexpr uint8_t IE = 0x01;
+
+    // Request lines of the built-in devices
+    static constexpr unsigned TIMER_LINE = 0;
+    static constexpr unsigned DMA_LINE = 1;
+
+private:
+    uint64_t interrupts = 0;
+    uint64_t returns = 0;
+    uint64_t waits = 0;
+    uint64_t idle_cycles = 0;
+
+    static uint16_t get(const Memory& memory, uint16_t address) {
+        return static_cast<uint16_t>(memory.read_backing(address) | (memory.read_backing(address + 1) << 8));
+    }
+
+    static void set(Memory& memory, uint16_t address, uint16_t value) {
+        memory.write_backing(address, static_cast<uint8_t>(value));
+        memory.write_backing(address + 1, static_cast<uint8_t>(value >> 8));
+    }
+
+public:
+    static void raise(Memory& memory, unsigned line) {
+        set(memory, PENDING, static_cast<uint16_t>(get(memory, PENDING) | (1u << line)));
+        if (ready(memory)) memory.end_slice();
+    }
+
+    // A masked-in line is pending (wakes WFI)
+    static bool pending(const Memory& memory) {
+        return (get(memory, PENDING) & get(memory, MASK)) != 0;
+    }
+
+    // A pending line would be taken now
+    static bool ready(const Memory& memory) {
+        return (memory.read_backing(CTRL) & IE) && pending(memory);
+    }
+
+    void enter(Memory& memory, GPRs& gprs, SPRs& sprs) {
+        set(memory, EPC, sprs.PC);
+        set(memory, EFLAGS, sprs.flags.to_byte());
+        for (int r = 0; r < 8; r++) set(memory, static_cast<uint16_t>(SAVED + 2 * r), gprs[r]);
+        memory.write_backing(CTRL, memory.read_backing(CTRL) & ~IE);
+        sprs.PC = get(memory, VECTOR);
+        interrupts++;
+    }
+
+    void leave(Memory& memory, GPRs& gprs, SPRs& sprs) {
+        for (int r = 0; r < 8; r++) gprs[r] = static_cast<int16_t>(get(memory, static_cast<uint16_t>(SAVED + 2 * r)));
+        sprs.flags.from_byte(static_cast<uint8_t>(get(memory, EFLAGS)));
+        sprs.PC = get(memory, EPC);
+        memory.write_backing(CTRL, memory.read_backing(CTRL) | IE);
+        returns++;
+    }
+
+    // A WFI ended; skipped is how many cycles were fast-forwarded
+    void record_wait(uint64_t skipped) {
+        waits++;
+        idle_cycles += skipped;
+    }
+
+    uint64_t get_interrupts() const { return interrupts; }
+    uint64_t get_idle_cycles() const { return idle_cycles; }
+
+    uint8_t read(const Memory& memory, uint16_t address) override {
+        return memory.read_backing(address);
+    }
+
+    void write(Memory& memory, uint16_t address, uint8_t value) override {
+        if (address == PENDING || address == PENDING + 1) {
+            memory.write_backing(address, memory.read_backing(address) & ~value);
+        } else {
+            memory.write_backing(address, value);
+            if (ready(memory)) memory.end_slice();
+        }
+    }
+
+    void print_stats(const Memory& memory) const {
+        std::cout << "Interrupts: " << interrupts << " taken, " << returns << " returns, " << waits
+                  << " waits, " << idle_cycles << " idle cycles skipped; IE=" << (memory.read_backing(CTRL) & IE)
+                  << " pending=0x" << std::hex << get(memory, PENDING) << " mask=0x" << get(memory, MASK)
+                  << std::dec << std::endl;
+    }
+};
+
+} // namespace cpu
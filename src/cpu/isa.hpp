@@ -30,9 +30,26 @@ enum class Opcode : uint8_t {
     JMP = 0xC,   // Jump: PC = RS1 + IMM
     JZ  = 0xD,   // Jump if zero: if (Z flag) PC = RS1 + IMM
     JNZ = 0xE,   // Jump if not zero: if (!Z flag) PC = RS1 + IMM
-    HLT = 0xF    // Halt
+    HLT = 0xF    // Halt (RD selects WFI or RTI, see SystemOp)
 };
 
+// Operations encoded as HLT with RD != 0. Every engine stops on opcode 0xF
+// with PC on the instruction; CPUEmulator then carries out WFI and RTI and
+// resumes, so only a plain HLT (or a WFI nothing can wake) ends a run.
+enum class SystemOp : uint8_t {
+    HALT = 0,    // HLT
+    WFI = 1,     // Wait for interrupt: idle until an enabled interrupt is pending
+    RTI = 2      // Return from interrupt: restore PC, flags and GPRs saved on entry
+};
+
+inline const char* opcode_name(Opcode op) {
+    static const char* const names[16] = {
+        "NOP", "ADD", "SUB", "AND", "OR", "XOR", "NOT", "SHL",
+        "SHR", "LD", "ST", "LDI", "JMP", "JZ", "JNZ", "HLT"
+    };
+    return names[static_cast<uint8_t>(op) & 0x0F];
+}
+
 // Addressing modes
 enum class AddressingMode {
     REGISTER,    // Register-register operation
@@ -104,17 +121,10 @@ struct Instruction {
     
     // Get instruction mnemonic
     std::string mnemonic() const {
-        static const std::map<Opcode, std::string> opcode_names = {
-            {Opcode::NOP, "NOP"}, {Opcode::ADD, "ADD"}, {Opcode::SUB, "SUB"},
-            {Opcode::AND, "AND"}, {Opcode::OR, "OR"}, {Opcode::XOR, "XOR"},
-            {Opcode::NOT, "NOT"}, {Opcode::SHL, "SHL"}, {Opcode::SHR, "SHR"},
-            {Opcode::LD, "LD"}, {Opcode::ST, "ST"}, {Opcode::LDI, "LDI"},
-            {Opcode::JMP, "JMP"}, {Opcode::JZ, "JZ"}, {Opcode::JNZ, "JNZ"},
-            {Opcode::HLT, "HLT"}
-        };
-        
-        std::string name = opcode_names.at(opcode);
+        std::string name = opcode_name(opcode);
         
+        if (opcode == Opcode::HLT && rd == static_cast<uint8_t>(SystemOp::WFI)) return "WFI";
+        if (opcode == Opcode::HLT && rd == static_cast<uint8_t>(SystemOp::RTI)) return "RTI";
         if (opcode == Opcode::NOP || opcode == Opcode::HLT) {
             return name;
         } else if (opcode == Opcode::NOT) {
@@ -0,0 +1,153 @@
+#pragma once
+
+#include "block_engine.hpp"
+#include "control_unit.hpp"
+#include "memory.hpp"
+#include "registers.hpp"
+#include "bus.hpp"
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+namespace cpu {
+
+// Side-by-side checker for the block engine and its JIT tier
+// Keeps a shadow machine that runs the plain switch interpreter. After every
+// block the real engine executes, the shadow is stepped by the same number
+// of instructions and registers, flags, PC and (for blocks that store) RAM
+// are compared. On a mismatch the shadow is resynced so later blocks are
+// still checked.
+class JitValidator : public BlockEngine::Observer {
+public:
+    static constexpr uint64_t MAX_REPORTS = 10;
+
+private:
+    const Memory* real_memory = nullptr;
+    Memory memory;
+    GPRs gprs;
+    SPRs sprs;
+    BusSystem buses;
+    ControlUnit reference;
+
+    uint64_t input_seen = 0;  // Real machine's input polls at the last sync
+    uint64_t banks_seen = 0;  // Real machine's bank switches at the last sync
+    uint64_t events_seen = 0; // Real machine's device events at the last sync
+    uint64_t blocks_checked = 0;
+    uint64_t mismatches = 0;
+    uint64_t resyncs = 0;
+
+    static bool has_store(const BlockEngine::Block& block) {
+        for (const auto& op : block.ops) {
+            if (op.kind == BlockEngine::UOP_ST) return true;
+        }
+        return false;
+    }
+
+    // The block engine only writes sprs.PC when it stops, so callers fix up PC
+    void copy_state(const GPRs& real_gprs, const SPRs& real_sprs) {
+        memory = *real_memory;
+        memory.clear_code_watch();
+        memory.set_console_echo(false);
+        memory.set_input(nullptr);
+        memory.detach_banks();
+        memory.set_replay(true);
+        input_seen = real_memory->input_polls();
+        banks_seen = real_memory->get_bank_switches();
+        events_seen = real_memory->get_events_fired();
+        gprs = real_gprs;
+        sprs = real_sprs;
+        reference.flush_code();
+        reference.reset();
+    }
+
+    static void report_word(const char* name, int16_t actual, int16_t expected) {
+        std::cout << "  " << name << ": 0x" << std::hex << std::setw(4) << std::setfill('0')
+                  << static_cast<uint16_t>(actual) << " (reference 0x" << std::setw(4)
+                  << static_cast<uint16_t>(expected) << ")" << std::dec << std::endl;
+    }
+
+    static void report_flag(char name, bool actual, bool expected) {
+        std::cout << "  Flag " << name << ": " << actual << " (reference " << expected << ")" << std::endl;
+    }
+
+public:
+    // Start checking from the current state of the real machine
+    void sync(const Memory& real, const GPRs& real_gprs, const SPRs& real_sprs) {
+        real_memory = &real;
+        copy_state(real_gprs, real_sprs);
+    }
+
+    void after_block(const BlockEngine::Block& block, uint32_t instructions, uint16_t next_pc,
+                     const GPRs& real_gprs, const SPRs& real_sprs) override {
+        if (!real_memory) return;
+        if (sprs.PC != block.start) {
+            // Instructions ran outside the block engine (single-stepped I/O
+            // or odd PCs); pick up the real state and carry on from here
+            resyncs++;
+            copy_state(real_gprs, real_sprs);
+            sprs.PC = next_pc;
+            return;
+        }
+        if (real_memory->input_polls() != input_seen || real_memory->get_bank_switches() != banks_seen ||
+            real_memory->get_events_fired() != events_seen) {
+            // The block read STDIN or STATUS, or switched a bank, or a device
+            // event fired since the last sync; the shadow cannot replay what
+            // the input thread had delivered by then, must not write the
+            // shared bank store, and never ticks its own devices
+            resyncs++;
+            copy_state(real_gprs, real_sprs);
+            sprs.PC = next_pc;
+            return;
+        }
+
+        for (uint32_t i = 0; i < instructions; i++) {
+            reference.execute<FastExecution>(memory, gprs, sprs, buses);
+        }
+        blocks_checked++;
+
+        bool regs_ok = std::memcmp(gprs.r, real_gprs.r, sizeof(gprs.r)) == 0;
+        bool flags_ok = sprs.flags.Z == real_sprs.flags.Z && sprs.flags.N == real_sprs.flags.N &&
+                        sprs.flags.C == real_sprs.flags.C && sprs.flags.V == real_sprs.flags.V;
+        bool pc_ok = sprs.PC == next_pc;
+        size_t differs = has_store(block) ? memory.first_difference(*real_memory, Memory::IO_BASE)
+                                          : Memory::IO_BASE;
+        bool ram_ok = differs == Memory::IO_BASE;
+        if (regs_ok && flags_ok && pc_ok && ram_ok) return;
+
+        mismatches++;
+        if (mismatches <= MAX_REPORTS) {
+            std::cout << "JIT validation mismatch in block 0x" << std::hex << std::setw(4)
+                      << std::setfill('0') << block.start << std::dec << " after "
+                      << instructions << " instructions ("
+                      << (block.native ? "native" : "interpreted") << ")" << std::endl;
+            for (int r = 0; r < 8; r++) {
+                if (gprs[r] != real_gprs[r]) {
+                    char name[3] = {'R', static_cast<char>('0' + r), '\0'};
+                    report_word(name, real_gprs[r], gprs[r]);
+                }
+            }
+            if (sprs.flags.Z != real_sprs.flags.Z) report_flag('Z', real_sprs.flags.Z, sprs.flags.Z);
+            if (sprs.flags.N != real_sprs.flags.N) report_flag('N', real_sprs.flags.N, sprs.flags.N);
+            if (sprs.flags.C != real_sprs.flags.C) report_flag('C', real_sprs.flags.C, sprs.flags.C);
+            if (sprs.flags.V != real_sprs.flags.V) report_flag('V', real_sprs.flags.V, sprs.flags.V);
+            if (!pc_ok) report_word("PC", static_cast<int16_t>(next_pc), static_cast<int16_t>(sprs.PC));
+            if (!ram_ok) {
+                std::cout << "  RAM differs from 0x" << std::hex << std::setw(4)
+                          << std::setfill('0') << differs << std::dec << std::endl;
+            }
+        }
+        copy_state(real_gprs, real_sprs);
+        sprs.PC = next_pc;
+    }
+
+    void print_summary() const {
+        std::cout << "JIT validation: " << blocks_checked << " blocks checked, "
+                  << mismatches << " mismatches, " << resyncs << " resyncs" << std::endl;
+    }
+
+    uint64_t get_blocks_checked() const { return blocks_checked; }
+    uint64_t get_mismatches() const { return mismatches; }
+};
+
+} // namespace cpu
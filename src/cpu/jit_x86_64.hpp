@@ -0,0 +1,657 @@
+#pragma once
+
+#include "block_engine.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define CPU_JIT_AVAILABLE 1
+#include <sys/mman.h>
+#else
+#define CPU_JIT_AVAILABLE 0
+#endif
+
+namespace cpu {
+
+#if CPU_JIT_AVAILABLE
+
+// x86-64 JIT backend for the block engine
+// Hot blocks are compiled into native code in an mmap'd buffer. Guest
+// registers live in host registers for the duration of a block, flags are
+// stored only when a later instruction of the block cannot overwrite them,
+// and loads/stores go straight to RAM; only the I/O page and stores into
+// words holding translated code call back into Memory.
+class X86Jit : public BlockEngine::Compiler {
+public:
+    static constexpr size_t CODE_SIZE = 4 * 1024 * 1024;
+
+private:
+    // Host register numbers
+    enum Reg : int {
+        RAX = 0, RCX = 1, RDX = 2, RBX = 3, RSP = 4, RBP = 5, RSI = 6, RDI = 7,
+        R8 = 8, R9 = 9, R10 = 10, R11 = 11, R12 = 12, R13 = 13, R14 = 14, R15 = 15
+    };
+
+    // Condition codes for Jcc/SETcc
+    enum Cond : uint8_t { CC_B = 0x2, CC_AE = 0x3, CC_E = 0x4, CC_NE = 0x5, CC_S = 0x8 };
+
+    // R0-R7 are pinned to callee-saved registers plus r8/r9 (saved around helper calls)
+    static constexpr int GUEST[8] = { RBX, RBP, R12, R13, R14, R15, R8, R9 };
+    static constexpr int FLAGS = R10;  // &sprs.flags
+    static constexpr int MEM = R11;    // Memory page table base
+
+    // Which flags an op writes / which are still needed later in the block
+    enum FlagBits : uint8_t { F_Z = 1, F_N = 2, F_C = 4, F_V = 8, F_ALL = 15 };
+
+    using Frame = BlockEngine::NativeFrame;
+
+    uint8_t* code = nullptr;
+    size_t used = 0;
+    std::vector<uint8_t> buf;
+    uint64_t flushes = 0;
+    uint64_t bytes_emitted = 0;
+    bool full = false;
+
+    // --- Encoding helpers -------------------------------------------------
+
+    void byte(uint8_t b) { buf.push_back(b); }
+
+    void imm32(uint32_t v) {
+        for (int i = 0; i < 4; i++) byte(static_cast<uint8_t>(v >> (8 * i)));
+    }
+
+    void rex(bool w, int reg, int index, int base, bool force = false) {
+        uint8_t r = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((index & 8) ? 2 : 0) | ((base & 8) ? 1 : 0);
+        if (r != 0x40 || force) byte(r);
+    }
+
+    void modrm(int mod, int reg, int rm) {
+        byte(static_cast<uint8_t>((mod << 6) | ((reg & 7) << 3) | (rm & 7)));
+    }
+
+    // [base + disp8] operand (rsp/r12 bases need a SIB byte)
+    void mem_disp8(int reg, int base, int8_t disp) {
+        modrm(1, reg, base);
+        if ((base & 7) == RSP) byte(0x24);
+        byte(static_cast<uint8_t>(disp));
+    }
+
+    // [base + index] operand
+    void mem_index(int reg, int base, int index) {
+        modrm(0, reg, 4);
+        byte(static_cast<uint8_t>(((index & 7) << 3) | (base & 7)));
+    }
+
+    // op r/m32, r32  (mov 0x89, add 0x01, sub 0x29, and 0x21, or 0x09, xor 0x31, cmp 0x39, test 0x85)
+    void op_rr(uint8_t opcode, int dst, int src) {
+        rex(false, src, 0, dst);
+        byte(opcode);
+        modrm(3, src, dst);
+    }
+
+    void mov_rr(int dst, int src) { op_rr(0x89, dst, src); }
+
+    void movsx_rr16(int dst, int src) {
+        rex(false, dst, 0, src);
+        byte(0x0F); byte(0xBF);
+        modrm(3, dst, src);
+    }
+
+    void movzx_rr16(int dst, int src) {
+        rex(false, dst, 0, src);
+        byte(0x0F); byte(0xB7);
+        modrm(3, dst, src);
+    }
+
+    void movsx_r_m16(int dst, int base, int8_t disp) {
+        rex(false, dst, 0, base);
+        byte(0x0F); byte(0xBF);
+        mem_disp8(dst, base, disp);
+    }
+
+    void movsx_r_m16_index(int dst, int base, int index) {
+        rex(false, dst, index, base);
+        byte(0x0F); byte(0xBF);
+        mem_index(dst, base, index);
+    }
+
+    void mov_m16_r(int base, int8_t disp, int src) {
+        byte(0x66);
+        rex(false, src, 0, base);
+        byte(0x89);
+        mem_disp8(src, base, disp);
+    }
+
+    void mov_m16_r_index(int base, int index, int src) {
+        byte(0x66);
+        rex(false, src, index, base);
+        byte(0x89);
+        mem_index(src, base, index);
+    }
+
+    void mov_r64_m(int dst, int base, int8_t disp) {
+        rex(true, dst, 0, base);
+        byte(0x8B);
+        mem_disp8(dst, base, disp);
+    }
+
+    void mov_r64_m_index8(int dst, int base, int index) {
+        rex(true, dst, index, base);
+        byte(0x8B);
+        modrm(0, dst, 4);
+        byte(static_cast<uint8_t>(0xC0 | ((index & 7) << 3) | (base & 7)));  // scale 8
+    }
+
+    void mov_m64_r(int base, int8_t disp, int src) {
+        rex(true, src, 0, base);
+        byte(0x89);
+        mem_disp8(src, base, disp);
+    }
+
+    void mov_ri(int dst, int32_t value) {
+        rex(false, 0, 0, dst);
+        byte(static_cast<uint8_t>(0xB8 + (dst & 7)));
+        imm32(static_cast<uint32_t>(value));
+    }
+
+    void mov_ri64(int dst, uint64_t value) {
+        rex(true, 0, 0, dst);
+        byte(static_cast<uint8_t>(0xB8 + (dst & 7)));
+        for (int i = 0; i < 8; i++) byte(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    // group-1 op r/m32, imm32 (/0 add, /7 cmp)
+    void op_ri(int ext, int dst, int32_t value) {
+        rex(false, 0, 0, dst);
+        byte(0x81);
+        modrm(3, ext, dst);
+        imm32(static_cast<uint32_t>(value));
+    }
+
+    void and_r64_i8(int dst, int8_t value) {
+        rex(true, 0, 0, dst);
+        byte(0x83);
+        modrm(3, 4, dst);
+        byte(static_cast<uint8_t>(value));
+    }
+
+    void test_ri(int dst, uint32_t value) {
+        rex(false, 0, 0, dst);
+        byte(0xF7);
+        modrm(3, 0, dst);
+        imm32(value);
+    }
+
+    void not_r(int dst) {
+        rex(false, 0, 0, dst);
+        byte(0xF7);
+        modrm(3, 2, dst);
+    }
+
+    void neg_r16(int dst) {
+        byte(0x66);
+        rex(false, 0, 0, dst);
+        byte(0xF7);
+        modrm(3, 3, dst);
+    }
+
+    // shift r/m32, imm8 (/4 shl, /5 shr, /7 sar)
+    void shift_ri(int ext, int dst, uint8_t count) {
+        rex(false, 0, 0, dst);
+        byte(0xC1);
+        modrm(3, ext, dst);
+        byte(count);
+    }
+
+    void bt_rr64(int dst, int bit) {
+        rex(true, bit, 0, dst);
+        byte(0x0F); byte(0xA3);
+        modrm(3, bit, dst);
+    }
+
+    void setcc_m(Cond cc, int base, int8_t disp) {
+        rex(false, 0, 0, base);
+        byte(0x0F); byte(static_cast<uint8_t>(0x90 + cc));
+        mem_disp8(0, base, disp);
+    }
+
+    void setcc_r8(Cond cc, int dst) {  // al/cl/dl/bl only
+        byte(0x0F); byte(static_cast<uint8_t>(0x90 + cc));
+        modrm(3, 0, dst);
+    }
+
+    void and_r8(int dst, int src) {  // al/cl/dl/bl only
+        byte(0x20);
+        modrm(3, src, dst);
+    }
+
+    void mov_m8_r8(int base, int8_t disp, int src) {  // al/cl/dl/bl only
+        rex(false, src, 0, base);
+        byte(0x88);
+        mem_disp8(src, base, disp);
+    }
+
+    void mov_m8_i(int base, int8_t disp, uint8_t value) {
+        rex(false, 0, 0, base);
+        byte(0xC6);
+        mem_disp8(0, base, disp);
+        byte(value);
+    }
+
+    void mov_m8_i_index(int base, int index, uint8_t value) {
+        rex(false, 0, index, base);
+        byte(0xC6);
+        mem_index(0, base, index);
+        byte(value);
+    }
+
+    void push(int r) {
+        if (r & 8) byte(0x41);
+        byte(static_cast<uint8_t>(0x50 + (r & 7)));
+    }
+
+    void pop(int r) {
+        if (r & 8) byte(0x41);
+        byte(static_cast<uint8_t>(0x58 + (r & 7)));
+    }
+
+    void call_abs(uintptr_t target) {
+        mov_ri64(RAX, target);
+        byte(0xFF); byte(0xD0);  // call rax
+    }
+
+    // Emit a rel32 jump and return the patch position
+    size_t jcc(Cond cc) {
+        byte(0x0F); byte(static_cast<uint8_t>(0x80 + cc));
+        imm32(0);
+        return buf.size() - 4;
+    }
+
+    size_t jmp() {
+        byte(0xE9);
+        imm32(0);
+        return buf.size() - 4;
+    }
+
+    void patch(size_t at, size_t target) {
+        int32_t rel = static_cast<int32_t>(target) - static_cast<int32_t>(at + 4);
+        std::memcpy(&buf[at], &rel, 4);
+    }
+
+    // --- Helpers called from native code ----------------------------------
+
+    static uint32_t helper_read(Frame* frame, uint32_t address) {
+        return frame->memory->read_word(static_cast<uint16_t>(address));
+    }
+
+    // Returns nonzero if the store invalidated the running block or ended
+    // the run slice. index is the store's instruction within the block.
+    static uint32_t helper_write(Frame* frame, uint32_t address, uint32_t value, uint32_t index) {
+        frame->memory->write_word(static_cast<uint16_t>(address), static_cast<uint16_t>(value),
+                                  frame->cycle + index);
+        return frame->block->valid && !frame->memory->is_slice_ended() ? 0 : 1;
+    }
+
+    // Caller-saved registers that hold guest or frame state
+    void save_volatile() { push(R8); push(R9); push(R10); push(R11); }
+    void restore_volatile() { pop(R11); pop(R10); pop(R9); pop(R8); }
+
+    // --- Code generation --------------------------------------------------
+
+    static int8_t flag_offset(uint8_t flag) {
+        switch (flag) {
+            case F_Z: return static_cast<int8_t>(offsetof(SPRs::Flags, Z));
+            case F_N: return static_cast<int8_t>(offsetof(SPRs::Flags, N));
+            case F_C: return static_cast<int8_t>(offsetof(SPRs::Flags, C));
+            default:  return static_cast<int8_t>(offsetof(SPRs::Flags, V));
+        }
+    }
+
+    static uint8_t flags_written(uint8_t kind) {
+        switch (kind) {
+            case BlockEngine::UOP_ADD: case BlockEngine::UOP_SUB:
+            case BlockEngine::UOP_AND: case BlockEngine::UOP_OR: case BlockEngine::UOP_XOR:
+            case BlockEngine::UOP_LDI_ADD: case BlockEngine::UOP_LDI_SUB:
+            case BlockEngine::UOP_LDI_AND: case BlockEngine::UOP_LDI_OR: case BlockEngine::UOP_LDI_XOR:
+            case BlockEngine::UOP_LDI2_ALU:
+                return F_ALL;
+            case BlockEngine::UOP_NOT:
+                return F_Z | F_N;
+            case BlockEngine::UOP_SHL: case BlockEngine::UOP_SHR: case BlockEngine::UOP_SHIFT_ZERO:
+                return F_Z | F_N | F_C;
+            default:
+                return 0;
+        }
+    }
+
+    // Z and N from the sign-extended result in reg
+    void emit_zn(int reg, uint8_t live) {
+        if (!(live & (F_Z | F_N))) return;
+        op_rr(0x85, reg, reg);
+        if (live & F_Z) setcc_m(CC_E, FLAGS, flag_offset(F_Z));
+        if (live & F_N) setcc_m(CC_S, FLAGS, flag_offset(F_N));
+    }
+
+    // ADD/SUB: eax = a + b exactly (32-bit), ecx = 16-bit result
+    // C is set when the sum leaves int16 range; V equals C except when the
+    // wrapped result is zero (ALU::add only flags overflow for nonzero results)
+    void emit_add_sub(const BlockEngine::MicroOp& op, bool subtract, uint8_t live) {
+        mov_rr(RAX, GUEST[op.rs1]);
+        if (subtract) {
+            mov_rr(RDX, GUEST[op.rs2]);
+            neg_r16(RDX);
+            movsx_rr16(RDX, RDX);
+            op_rr(0x01, RAX, RDX);
+        } else {
+            op_rr(0x01, RAX, GUEST[op.rs2]);
+        }
+        movsx_rr16(RCX, RAX);
+        if (live & (F_C | F_V)) {
+            op_rr(0x39, RAX, RCX);
+            setcc_r8(CC_NE, RDX);
+            if (live & F_C) mov_m8_r8(FLAGS, flag_offset(F_C), RDX);
+        }
+        op_rr(0x85, RCX, RCX);
+        if (live & F_Z) setcc_m(CC_E, FLAGS, flag_offset(F_Z));
+        if (live & F_N) setcc_m(CC_S, FLAGS, flag_offset(F_N));
+        if (live & F_V) {
+            setcc_r8(CC_NE, RAX);
+            and_r8(RAX, RDX);
+            mov_m8_r8(FLAGS, flag_offset(F_V), RAX);
+        }
+        mov_rr(GUEST[op.rd], RCX);
+    }
+
+    void emit_logic(const BlockEngine::MicroOp& op, uint8_t opcode, uint8_t live) {
+        mov_rr(RAX, GUEST[op.rs1]);
+        op_rr(opcode, RAX, GUEST[op.rs2]);
+        emit_zn(RAX, live);
+        if (live & F_C) mov_m8_i(FLAGS, flag_offset(F_C), 0);
+        if (live & F_V) mov_m8_i(FLAGS, flag_offset(F_V), 0);
+        mov_rr(GUEST[op.rd], RAX);
+    }
+
+    // Shift by a constant in 0-15, matching ALU::shift_left/shift_right
+    void emit_shift(const BlockEngine::MicroOp& op, bool left, uint8_t live) {
+        int shift = op.imm;
+        mov_rr(RAX, GUEST[op.rs1]);
+        if (live & F_C) {
+            // Carry tests the bit that is shifted out last; for SHR #0 the
+            // interpreter's (1 << -1) evaluates to bit 31 on x86 hosts
+            uint32_t mask = left ? (1u << (15 - shift))
+                                 : (shift == 0 ? 0x80000000u : (1u << (shift - 1)));
+            test_ri(RAX, mask);
+            setcc_m(CC_NE, FLAGS, flag_offset(F_C));
+        }
+        if (shift != 0) {
+            shift_ri(left ? 4 : 7, RAX, static_cast<uint8_t>(shift));
+            if (left) movsx_rr16(RAX, RAX);
+        }
+        emit_zn(RAX, live);
+        mov_rr(GUEST[op.rd], RAX);
+    }
+
+    // eax = (uint16)(rs1 + imm)
+    void emit_address(const BlockEngine::MicroOp& op) {
+        mov_rr(RAX, GUEST[op.rs1]);
+        if (op.imm != 0) op_ri(0, RAX, op.imm);
+        movzx_rr16(RAX, RAX);
+    }
+
+    // rdi = page table entry for eax (tags still set), edx = page number
+    void emit_page_lookup() {
+        mov_rr(RDX, RAX);
+        shift_ri(5, RDX, 8);
+        mov_r64_m_index8(RDI, MEM, RDX);
+    }
+
+    void emit_load(const BlockEngine::MicroOp& op) {
+        emit_address(op);
+        // A word at offset 0xFF spans two pages
+        mov_rr(RCX, RAX);
+        op_ri(4, RCX, 0xFF);
+        op_ri(7, RCX, 0xFF);
+        size_t split = jcc(CC_E);
+        emit_page_lookup();
+        test_ri(RDI, static_cast<uint32_t>(Memory::DEVICE_PAGE));
+        size_t device = jcc(CC_NE);
+        and_r64_i8(RDI, static_cast<int8_t>(~Memory::PAGE_TAGS));
+        movsx_r_m16_index(GUEST[op.rd], RDI, RCX);
+        size_t to_done = jmp();
+
+        patch(split, buf.size());
+        patch(device, buf.size());
+        save_volatile();
+        mov_r64_m(RDI, RSP, 32);
+        mov_rr(RSI, RAX);
+        call_abs(reinterpret_cast<uintptr_t>(&helper_read));
+        restore_volatile();
+        movsx_rr16(GUEST[op.rd], RAX);
+
+        patch(to_done, buf.size());
+    }
+
+    // Returns the patch position of the early-exit jump taken when the store
+    // invalidated this block or ended the run slice
+    size_t emit_store(const BlockEngine::MicroOp& op) {
+        emit_address(op);
+        test_ri(RAX, 1);
+        size_t odd = jcc(CC_NE);
+        // Code bitmap: bit (addr >> 1) of qword (addr >> 7)
+        mov_r64_m(RDI, RSP, 0);
+        mov_r64_m(RDI, RDI, static_cast<int8_t>(offsetof(Frame, code_bitmap)));
+        mov_rr(RCX, RAX);
+        shift_ri(5, RCX, 7);
+        mov_r64_m_index8(RDI, RDI, RCX);
+        mov_rr(RCX, RAX);
+        shift_ri(5, RCX, 1);
+        bt_rr64(RDI, RCX);
+        size_t watched = jcc(CC_B);
+        // Device pages, and shared pages that Memory must copy first, take the
+        // slow path (even addresses stay in one page)
+        emit_page_lookup();
+        test_ri(RDI, static_cast<uint32_t>(Memory::PAGE_TAGS));
+        size_t tagged = jcc(CC_NE);
+        mov_rr(RCX, RAX);
+        op_ri(4, RCX, 0xFF);
+        mov_m16_r_index(RDI, RCX, GUEST[op.rd]);
+        // Mark the page dirty for snapshot restore
+        mov_r64_m(RDI, RSP, 0);
+        mov_r64_m(RDI, RDI, static_cast<int8_t>(offsetof(Frame, dirty_pages)));
+        mov_m8_i_index(RDI, RDX, 1);
+        size_t to_done = jmp();
+
+        size_t slow = buf.size();
+        patch(odd, slow);
+        patch(watched, slow);
+        patch(tagged, slow);
+        movzx_rr16(RDX, GUEST[op.rd]);
+        mov_ri(RCX, op.boundary - 1);
+        save_volatile();
+        mov_r64_m(RDI, RSP, 32);
+        mov_rr(RSI, RAX);
+        call_abs(reinterpret_cast<uintptr_t>(&helper_write));
+        restore_volatile();
+        op_rr(0x85, RAX, RAX);
+        size_t exit = jcc(CC_NE);
+
+        patch(to_done, buf.size());
+        return exit;
+    }
+
+    // Any op except ST; l is the set of its flags still needed later
+    void emit_op(const BlockEngine::MicroOp& op, uint8_t l) {
+        switch (op.kind) {
+            case BlockEngine::UOP_NOP: break;
+            case BlockEngine::UOP_ADD: emit_add_sub(op, false, l); break;
+            case BlockEngine::UOP_SUB: emit_add_sub(op, true, l); break;
+            case BlockEngine::UOP_AND: emit_logic(op, 0x21, l); break;
+            case BlockEngine::UOP_OR:  emit_logic(op, 0x09, l); break;
+            case BlockEngine::UOP_XOR: emit_logic(op, 0x31, l); break;
+            case BlockEngine::UOP_NOT:
+                mov_rr(RAX, GUEST[op.rs1]);
+                not_r(RAX);
+                emit_zn(RAX, l);
+                mov_rr(GUEST[op.rd], RAX);
+                break;
+            case BlockEngine::UOP_SHL: emit_shift(op, true, l); break;
+            case BlockEngine::UOP_SHR: emit_shift(op, false, l); break;
+            case BlockEngine::UOP_SHIFT_ZERO:
+                mov_ri(GUEST[op.rd], 0);
+                if (l & F_Z) mov_m8_i(FLAGS, flag_offset(F_Z), 1);
+                if (l & F_N) mov_m8_i(FLAGS, flag_offset(F_N), 0);
+                if (l & F_C) mov_m8_i(FLAGS, flag_offset(F_C), 0);
+                break;
+            case BlockEngine::UOP_LD: emit_load(op); break;
+            case BlockEngine::UOP_LDI: mov_ri(GUEST[op.rd], op.imm); break;
+            case BlockEngine::UOP_LDI_ADD: case BlockEngine::UOP_LDI_SUB:
+            case BlockEngine::UOP_LDI_AND: case BlockEngine::UOP_LDI_OR: case BlockEngine::UOP_LDI_XOR: {
+                mov_ri(GUEST[op.rk], op.imm2);
+                BlockEngine::MicroOp alu = op;
+                alu.kind = static_cast<uint8_t>(BlockEngine::UOP_ADD + (op.kind - BlockEngine::UOP_LDI_ADD));
+                emit_op(alu, l);
+                break;
+            }
+            case BlockEngine::UOP_LDI2_ALU:
+                // Result and flags were folded at translation time
+                mov_ri(GUEST[op.rk], op.imm2);
+                mov_ri(GUEST[op.rs1], op.imm);
+                mov_ri(GUEST[op.rd], op.value);
+                if (l & F_Z) mov_m8_i(FLAGS, flag_offset(F_Z), (op.flag_bits & 0x01) ? 1 : 0);
+                if (l & F_N) mov_m8_i(FLAGS, flag_offset(F_N), (op.flag_bits & 0x02) ? 1 : 0);
+                if (l & F_C) mov_m8_i(FLAGS, flag_offset(F_C), (op.flag_bits & 0x04) ? 1 : 0);
+                if (l & F_V) mov_m8_i(FLAGS, flag_offset(F_V), (op.flag_bits & 0x08) ? 1 : 0);
+                break;
+        }
+    }
+
+    void emit_prologue() {
+        push(RBX); push(RBP); push(R12); push(R13); push(R14); push(R15);
+        // sub rsp, 8 keeps calls 16-byte aligned; [rsp] holds the frame
+        byte(0x48); byte(0x83); byte(0xEC); byte(0x08);
+        mov_m64_r(RSP, 0, RDI);
+        mov_r64_m(RAX, RDI, static_cast<int8_t>(offsetof(Frame, gprs)));
+        for (int i = 0; i < 8; i++) {
+            movsx_r_m16(GUEST[i], RAX, static_cast<int8_t>(offsetof(GPRs, r) + i * 2));
+        }
+        mov_r64_m(FLAGS, RDI, static_cast<int8_t>(offsetof(Frame, flags)));
+        mov_r64_m(MEM, RDI, static_cast<int8_t>(offsetof(Frame, pages)));
+    }
+
+    // Expects the return value in eax
+    void emit_epilogue() {
+        mov_r64_m(RCX, RSP, 0);
+        mov_r64_m(RCX, RCX, static_cast<int8_t>(offsetof(Frame, gprs)));
+        for (int i = 0; i < 8; i++) {
+            mov_m16_r(RCX, static_cast<int8_t>(offsetof(GPRs, r) + i * 2), GUEST[i]);
+        }
+        byte(0x48); byte(0x83); byte(0xC4); byte(0x08);  // add rsp, 8
+        pop(R15); pop(R14); pop(R13); pop(R12); pop(RBP); pop(RBX);
+        byte(0xC3);
+    }
+
+    bool map_code() {
+        if (code) return true;
+        void* p = mmap(nullptr, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (p == MAP_FAILED) return false;
+        code = static_cast<uint8_t*>(p);
+        return true;
+    }
+
+public:
+    X86Jit() = default;
+    X86Jit(const X86Jit&) = delete;
+    X86Jit& operator=(const X86Jit&) = delete;
+
+    ~X86Jit() override {
+        if (code) munmap(code, CODE_SIZE);
+    }
+
+    static bool available() { return true; }
+
+    uint64_t get_flushes() const { return flushes; }
+    uint64_t get_bytes_emitted() const { return bytes_emitted; }
+    size_t get_bytes_used() const { return used; }
+
+    void flush() override {
+        used = 0;
+        full = false;
+        flushes++;
+    }
+
+    bool exhausted() const override { return full; }
+
+    // Compile a block body; returns nullptr (and reports exhausted) when the
+    // code buffer is full
+    BlockEngine::NativeBody compile(const BlockEngine::Block& block) override {
+        static_assert(sizeof(bool) == 1, "flag stores assume one-byte bools");
+        if (!map_code()) return nullptr;
+
+        const auto& ops = block.ops;
+
+        // Backward liveness: flags are needed at block exit and before every
+        // store (a store may leave the block early)
+        std::vector<uint8_t> live(ops.size());
+        uint8_t needed = F_ALL;
+        for (size_t i = ops.size(); i-- > 0;) {
+            live[i] = needed;
+            needed &= static_cast<uint8_t>(~flags_written(ops[i].kind));
+            if (ops[i].kind == BlockEngine::UOP_ST) needed = F_ALL;
+        }
+
+        buf.clear();
+        emit_prologue();
+        std::vector<std::pair<size_t, uint32_t>> early_exits;
+        for (size_t i = 0; i < ops.size(); i++) {
+            const BlockEngine::MicroOp& op = ops[i];
+            uint8_t l = live[i] & flags_written(op.kind);
+            if (op.kind == BlockEngine::UOP_ST) {
+                early_exits.push_back({emit_store(op), op.boundary});
+            } else {
+                emit_op(op, l);
+            }
+        }
+        mov_ri(RAX, static_cast<int32_t>(block.length()));
+        std::vector<size_t> to_epilogue;
+        to_epilogue.push_back(jmp());
+        for (const auto& exit : early_exits) {
+            patch(exit.first, buf.size());
+            mov_ri(RAX, static_cast<int32_t>(exit.second));
+            to_epilogue.push_back(jmp());
+        }
+        for (size_t at : to_epilogue) patch(at, buf.size());
+        emit_epilogue();
+
+        if (used + buf.size() > CODE_SIZE) {
+            full = true;
+            return nullptr;
+        }
+        uint8_t* target = code + used;
+        mprotect(code, CODE_SIZE, PROT_READ | PROT_WRITE);
+        std::memcpy(target, buf.data(), buf.size());
+        mprotect(code, CODE_SIZE, PROT_READ | PROT_EXEC);
+        used += (buf.size() + 15) & ~static_cast<size_t>(15);
+        bytes_emitted += buf.size();
+        return reinterpret_cast<BlockEngine::NativeBody>(target);
+    }
+};
+
+#else
+
+// Stand-in on hosts without the x86-64 Linux backend: nothing gets compiled,
+// so the JIT engine runs entirely on the block interpreter
+class X86Jit : public BlockEngine::Compiler {
+public:
+    static bool available() { return false; }
+    uint64_t get_flushes() const { return 0; }
+    uint64_t get_bytes_emitted() const { return 0; }
+    size_t get_bytes_used() const { return 0; }
+    void flush() override {}
+    BlockEngine::NativeBody compile(const BlockEngine::Block&) override { return nullptr; }
+};
+
+#endif
+
+} // namespace cpu
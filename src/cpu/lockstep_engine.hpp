@@ -0,0 +1,639 @@
+#pragma once
+
+#include "isa.hpp"
+#include "registers.hpp"
+#include "memory.hpp"
+#include "bus.hpp"
+#include "control_unit.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Lane kernels use AVX2 when the compiler targets it (-mavx2), SSE2 on any
+// other x86-64 build, and plain loops elsewhere.
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace cpu {
+
+// 16-bit lane vectors for the lockstep engine
+// Masks are all-ones (true) or all-zeros (false) per lane.
+namespace lanes {
+
+#if defined(__AVX2__)
+
+using Vec = __m256i;
+constexpr size_t WIDTH = 16;
+constexpr const char* KERNEL = "AVX2";
+
+inline Vec load(const int16_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+inline void store(int16_t* p, Vec v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+inline Vec splat(int16_t x) { return _mm256_set1_epi16(x); }
+inline Vec add(Vec a, Vec b) { return _mm256_add_epi16(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm256_sub_epi16(a, b); }
+inline Vec add_sat(Vec a, Vec b) { return _mm256_adds_epi16(a, b); }
+inline Vec add_sat_unsigned(Vec a, Vec b) { return _mm256_adds_epu16(a, b); }
+inline Vec bit_and(Vec a, Vec b) { return _mm256_and_si256(a, b); }
+inline Vec bit_or(Vec a, Vec b) { return _mm256_or_si256(a, b); }
+inline Vec bit_xor(Vec a, Vec b) { return _mm256_xor_si256(a, b); }
+inline Vec and_not(Vec a, Vec b) { return _mm256_andnot_si256(a, b); }  // ~a & b
+inline Vec equal(Vec a, Vec b) { return _mm256_cmpeq_epi16(a, b); }
+inline Vec greater(Vec a, Vec b) { return _mm256_cmpgt_epi16(a, b); }
+inline Vec min(Vec a, Vec b) { return _mm256_min_epi16(a, b); }
+inline Vec max(Vec a, Vec b) { return _mm256_max_epi16(a, b); }
+inline Vec shift_left(Vec a, int n) { return _mm256_sll_epi16(a, _mm_cvtsi32_si128(n)); }
+inline Vec shift_right(Vec a, int n) { return _mm256_sra_epi16(a, _mm_cvtsi32_si128(n)); }
+inline bool any(Vec m) { return _mm256_movemask_epi8(m) != 0; }
+
+#elif defined(__SSE2__)
+
+using Vec = __m128i;
+constexpr size_t WIDTH = 8;
+constexpr const char* KERNEL = "SSE2";
+
+inline Vec load(const int16_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+inline void store(int16_t* p, Vec v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+inline Vec splat(int16_t x) { return _mm_set1_epi16(x); }
+inline Vec add(Vec a, Vec b) { return _mm_add_epi16(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm_sub_epi16(a, b); }
+inline Vec add_sat(Vec a, Vec b) { return _mm_adds_epi16(a, b); }
+inline Vec add_sat_unsigned(Vec a, Vec b) { return _mm_adds_epu16(a, b); }
+inline Vec bit_and(Vec a, Vec b) { return _mm_and_si128(a, b); }
+inline Vec bit_or(Vec a, Vec b) { return _mm_or_si128(a, b); }
+inline Vec bit_xor(Vec a, Vec b) { return _mm_xor_si128(a, b); }
+inline Vec and_not(Vec a, Vec b) { return _mm_andnot_si128(a, b); }  // ~a & b
+inline Vec equal(Vec a, Vec b) { return _mm_cmpeq_epi16(a, b); }
+inline Vec greater(Vec a, Vec b) { return _mm_cmpgt_epi16(a, b); }
+inline Vec min(Vec a, Vec b) { return _mm_min_epi16(a, b); }
+inline Vec max(Vec a, Vec b) { return _mm_max_epi16(a, b); }
+inline Vec shift_left(Vec a, int n) { return _mm_sll_epi16(a, _mm_cvtsi32_si128(n)); }
+inline Vec shift_right(Vec a, int n) { return _mm_sra_epi16(a, _mm_cvtsi32_si128(n)); }
+inline bool any(Vec m) { return _mm_movemask_epi8(m) != 0; }
+
+#else
+
+struct Vec {
+    int16_t v[8];
+};
+constexpr size_t WIDTH = 8;
+constexpr const char* KERNEL = "scalar";
+
+template <typename F>
+inline Vec map(Vec a, Vec b, F f) {
+    Vec r;
+    for (size_t i = 0; i < WIDTH; i++) r.v[i] = static_cast<int16_t>(f(a.v[i], b.v[i]));
+    return r;
+}
+
+inline Vec load(const int16_t* p) { Vec r; std::copy(p, p + WIDTH, r.v); return r; }
+inline void store(int16_t* p, Vec v) { std::copy(v.v, v.v + WIDTH, p); }
+inline Vec splat(int16_t x) { Vec r; std::fill(r.v, r.v + WIDTH, x); return r; }
+inline Vec add(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return x + y; }); }
+inline Vec sub(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return x - y; }); }
+inline Vec add_sat(Vec a, Vec b) {
+    return map(a, b, [](int16_t x, int16_t y) { return std::min(32767, std::max(-32768, x + y)); });
+}
+inline Vec add_sat_unsigned(Vec a, Vec b) {
+    return map(a, b, [](int16_t x, int16_t y) {
+        return std::min(65535, static_cast<uint16_t>(x) + static_cast<uint16_t>(y));
+    });
+}
+inline Vec bit_and(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return x & y; }); }
+inline Vec bit_or(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return x | y; }); }
+inline Vec bit_xor(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return x ^ y; }); }
+inline Vec and_not(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return ~x & y; }); }
+inline Vec equal(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return x == y ? -1 : 0; }); }
+inline Vec greater(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return x > y ? -1 : 0; }); }
+inline Vec min(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return std::min(x, y); }); }
+inline Vec max(Vec a, Vec b) { return map(a, b, [](int16_t x, int16_t y) { return std::max(x, y); }); }
+inline Vec shift_left(Vec a, int n) { return map(a, a, [n](int16_t x, int16_t) { return x << n; }); }
+inline Vec shift_right(Vec a, int n) { return map(a, a, [n](int16_t x, int16_t) { return x >> n; }); }
+inline bool any(Vec m) {
+    for (size_t i = 0; i < WIDTH; i++) if (m.v[i]) return true;
+    return false;
+}
+
+#endif
+
+// mask ? a : b
+inline Vec blend(Vec mask, Vec a, Vec b) { return bit_or(bit_and(mask, a), and_not(mask, b)); }
+
+} // namespace lanes
+
+// Lockstep structure-of-arrays engine
+// Runs one program image in many independent contexts (lanes), e.g. for a
+// parameter sweep. Registers, flags and PCs are stored one array per
+// register with one 16-bit slot per lane, and each instruction is executed
+// for every lane at once with the lane kernels above. Lanes whose PC differs
+// from the issuing PC are masked off; the issuing PC is the lowest live PC,
+// so lanes that split at a branch meet again at the join point. A lane that
+// waits too long (it has diverged for good) is peeled off and finished on the
+// scalar engine. Each lane has its own Memory; loads and stores go through it
+// one lane at a time.
+class LockstepEngine {
+public:
+    static constexpr uint64_t DEFAULT_PEEL_AFTER = 4096;  // Issued instructions a lane may wait
+
+    enum class LaneState : uint8_t { RUNNING, HALTED, BUDGET };
+
+    // Final state of one lane
+    struct LaneResult {
+        GPRs gprs;
+        SPRs sprs;
+        LaneState state;
+        uint64_t instructions;
+        bool peeled;                       // Finished on the scalar engine
+        const std::vector<std::string>* output;
+    };
+
+private:
+    using Vec = lanes::Vec;
+    static constexpr size_t WIDTH = lanes::WIDTH;
+    // Lane counters are 16 bits wide and folded into 64-bit totals before they wrap
+    static constexpr uint64_t FOLD_INTERVAL = 32767;
+    static constexpr uint64_t PEEL_CHECK_INTERVAL = 1024;
+
+    // Collects one lane's console lines
+    class LaneSink : public Memory::OutputSink {
+    public:
+        std::vector<std::string> lines;
+        void write_line(const std::string& line) override { lines.push_back(line); }
+    };
+
+    size_t lane_count;
+    size_t padded;  // lane_count rounded up to WIDTH
+
+    // Structure of arrays: element [r * padded + lane], flags and masks are 0 / -1
+    std::vector<int16_t> regs;
+    std::vector<int16_t> flag_z, flag_n, flag_c, flag_v;
+    std::vector<int16_t> pcs;      // Valid while diverged (see shared_pc)
+    std::vector<int16_t> live;     // Lane still runs in lockstep
+    std::vector<int16_t> waiting;  // Issued instructions since the lane last ran (saturating)
+    std::vector<int16_t> counts;   // Instructions since the last fold
+
+    std::vector<uint64_t> totals;
+    std::vector<LaneState> states;
+    std::vector<uint8_t> peeled;
+    std::vector<Memory> memories;
+    std::vector<LaneSink> sinks;
+
+    // Words stored to by any lane (or set per lane before the run); fetches
+    // from these compare every lane's copy instead of reading the shared image
+    std::vector<uint64_t> written;
+    Memory image;
+
+    bool converged = true;   // Every live lane is at shared_pc
+    uint16_t shared_pc = 0;
+    size_t live_count = 0;
+
+    uint64_t max_cycles = UINT64_MAX;
+    uint64_t peel_after = DEFAULT_PEEL_AFTER;
+    uint64_t steps = 0;                 // Instructions issued
+    uint64_t next_fold = 0;
+    uint64_t scalar_instructions = 0;   // Executed by peeled lanes
+    uint64_t peel_count = 0;
+    uint64_t reconvergences = 0;
+    double seconds = 0;
+
+    // Finishes peeled lanes
+    ControlUnit scalar;
+    BusSystem buses;
+
+    int16_t& reg(int r, size_t lane) { return regs[r * padded + lane]; }
+    int16_t* reg_row(int r, size_t offset) { return &regs[r * padded + offset]; }
+
+    void mark_written(uint16_t address) {
+        written[address >> 7] |= uint64_t(1) << ((address >> 1) & 63);
+    }
+
+    bool is_written(uint16_t address) const {
+        return (written[address >> 7] >> ((address >> 1) & 63)) & 1;
+    }
+
+    uint16_t lane_pc(size_t lane) const {
+        return converged ? shared_pc : static_cast<uint16_t>(pcs[lane]);
+    }
+
+    // Add the 16-bit lane counters to the totals and retire lanes whose
+    // budget is used up; schedules the next fold before any counter can wrap
+    // or any lane can pass its budget
+    void fold_counts() {
+        uint64_t horizon = FOLD_INTERVAL;
+        for (size_t lane = 0; lane < lane_count; lane++) {
+            totals[lane] += static_cast<uint16_t>(counts[lane]);
+            counts[lane] = 0;
+            if (!live[lane]) continue;
+            if (totals[lane] >= max_cycles) {
+                retire(lane, LaneState::BUDGET);
+            } else {
+                horizon = std::min(horizon, max_cycles - totals[lane]);
+            }
+        }
+        next_fold = steps + horizon;
+    }
+
+    void retire(size_t lane, LaneState state) {
+        if (converged) pcs[lane] = static_cast<int16_t>(shared_pc);
+        live[lane] = 0;
+        states[lane] = state;
+        live_count--;
+    }
+
+    // Hand a lane to the scalar engine and run it to HLT or its budget
+    void peel(size_t lane) {
+        totals[lane] += static_cast<uint16_t>(counts[lane]);
+        counts[lane] = 0;
+        GPRs gprs;
+        SPRs sprs;
+        for (int r = 0; r < 8; r++) gprs[r] = reg(r, lane);
+        sprs.PC = lane_pc(lane);
+        sprs.flags.Z = flag_z[lane] != 0;
+        sprs.flags.N = flag_n[lane] != 0;
+        sprs.flags.C = flag_c[lane] != 0;
+        sprs.flags.V = flag_v[lane] != 0;
+        retire(lane, LaneState::BUDGET);
+        peeled[lane] = 1;
+        peel_count++;
+
+        uint64_t remaining = max_cycles - totals[lane];
+        scalar.flush_code();
+        scalar.reset();
+        scalar.run_fast(memories[lane], gprs, sprs, buses, remaining);
+        memories[lane].clear_code_watch();
+        totals[lane] += scalar.get_cycle_count();
+        scalar_instructions += scalar.get_cycle_count();
+        if (scalar.is_halted()) states[lane] = LaneState::HALTED;
+
+        for (int r = 0; r < 8; r++) reg(r, lane) = gprs[r];
+        pcs[lane] = static_cast<int16_t>(sprs.PC);
+        flag_z[lane] = sprs.flags.Z ? -1 : 0;
+        flag_n[lane] = sprs.flags.N ? -1 : 0;
+        flag_c[lane] = sprs.flags.C ? -1 : 0;
+        flag_v[lane] = sprs.flags.V ? -1 : 0;
+    }
+
+    // Lowest live PC; also notices when every live lane is back at one PC
+    uint16_t lowest_pc() {
+        const Vec bias = lanes::splat(INT16_MIN);  // Unsigned order via signed min/max
+        Vec lo = lanes::splat(INT16_MAX);
+        Vec hi = lanes::splat(INT16_MIN);
+        for (size_t o = 0; o < padded; o += WIDTH) {
+            Vec m = lanes::load(&live[o]);
+            Vec pc = lanes::bit_xor(lanes::load(&pcs[o]), bias);
+            lo = lanes::min(lo, lanes::blend(m, pc, lanes::splat(INT16_MAX)));
+            hi = lanes::max(hi, lanes::blend(m, pc, lanes::splat(INT16_MIN)));
+        }
+        int16_t lo_lanes[WIDTH], hi_lanes[WIDTH];
+        lanes::store(lo_lanes, lo);
+        lanes::store(hi_lanes, hi);
+        int16_t low = *std::min_element(lo_lanes, lo_lanes + WIDTH);
+        int16_t high = *std::max_element(hi_lanes, hi_lanes + WIDTH);
+        uint16_t pc = static_cast<uint16_t>(low ^ INT16_MIN);
+        if (low == high) {
+            converged = true;
+            shared_pc = pc;
+            std::fill(waiting.begin(), waiting.end(), 0);
+        }
+        return pc;
+    }
+
+    // Decode the instruction at pc. Words no lane has stored to come from the
+    // shared image; otherwise lanes whose copy differs from the first lane's
+    // are peeled so the rest can issue it together.
+    Instruction fetch(uint16_t pc) {
+        if (!is_written(pc) && !is_written(static_cast<uint16_t>(pc + 1))) {
+            return Instruction::decode(image.read_word(pc));
+        }
+        bool have_word = false;
+        uint16_t word = 0;
+        for (size_t lane = 0; lane < lane_count; lane++) {
+            if (!live[lane] || lane_pc(lane) != pc) continue;
+            uint16_t lane_word = memories[lane].read_word(pc);
+            if (!have_word) {
+                word = lane_word;
+                have_word = true;
+            } else if (lane_word != word) {
+                peel(lane);
+            }
+        }
+        return Instruction::decode(word);
+    }
+
+    void retire_halted(size_t offset, Vec mask) {
+        int16_t m[WIDTH];
+        lanes::store(m, mask);
+        for (size_t i = 0; i < WIDTH; i++) {
+            if (m[i]) retire(offset + i, LaneState::HALTED);
+        }
+    }
+
+    // Loads and stores touch per-lane memory, one lane at a time
+    void memory_op(const Instruction& instr, size_t offset, Vec mask) {
+        int16_t m[WIDTH];
+        lanes::store(m, mask);
+        for (size_t i = 0; i < WIDTH; i++) {
+            if (!m[i]) continue;
+            size_t lane = offset + i;
+            uint16_t addr = static_cast<uint16_t>(reg(instr.rs1, lane) + instr.imm);
+            if (instr.opcode == Opcode::LD) {
+                reg(instr.rd, lane) = static_cast<int16_t>(memories[lane].read_word(addr));
+            } else {
+                mark_written(addr);
+                mark_written(static_cast<uint16_t>(addr + 1));
+                memories[lane].write_word(addr, static_cast<uint16_t>(reg(instr.rd, lane)));
+            }
+        }
+    }
+
+    void set_flags(size_t o, Vec mask, Vec out) {
+        const Vec zero = lanes::splat(0);
+        lanes::store(&flag_z[o], lanes::blend(mask, lanes::equal(out, zero), lanes::load(&flag_z[o])));
+        lanes::store(&flag_n[o], lanes::blend(mask, lanes::greater(zero, out), lanes::load(&flag_n[o])));
+    }
+
+    void set_carry_overflow(size_t o, Vec mask, Vec carry, Vec overflow) {
+        lanes::store(&flag_c[o], lanes::blend(mask, carry, lanes::load(&flag_c[o])));
+        lanes::store(&flag_v[o], lanes::blend(mask, overflow, lanes::load(&flag_v[o])));
+    }
+
+    // Execute instr for the lanes of one group selected by mask, with the same
+    // results as ALU and ControlUnit::execute
+    void execute_group(const Instruction& instr, size_t o, Vec mask, uint16_t pc) {
+        using namespace lanes;
+        const Vec zero = splat(0);
+        const Vec ones = splat(-1);
+        Vec out = zero;
+        switch (instr.opcode) {
+            case Opcode::NOP:
+                return;
+
+            case Opcode::ADD:
+            case Opcode::SUB: {
+                Vec a = load(reg_row(instr.rs1, o));
+                Vec b = load(reg_row(instr.rs2, o));
+                if (instr.opcode == Opcode::SUB) b = lanes::sub(zero, b);
+                out = add(a, b);
+                // Carry: the true sum left the int16 range, i.e. saturation differs
+                Vec carry = and_not(equal(add_sat(a, b), out), ones);
+                Vec overflow = bit_or(
+                    bit_and(bit_and(greater(a, zero), greater(b, zero)), greater(zero, out)),
+                    bit_and(bit_and(greater(zero, a), greater(zero, b)), greater(out, zero)));
+                set_carry_overflow(o, mask, carry, overflow);
+                set_flags(o, mask, out);
+                break;
+            }
+
+            case Opcode::AND:
+            case Opcode::OR:
+            case Opcode::XOR: {
+                Vec a = load(reg_row(instr.rs1, o));
+                Vec b = load(reg_row(instr.rs2, o));
+                out = instr.opcode == Opcode::AND ? bit_and(a, b)
+                    : instr.opcode == Opcode::OR ? bit_or(a, b) : bit_xor(a, b);
+                set_carry_overflow(o, mask, zero, zero);
+                set_flags(o, mask, out);
+                break;
+            }
+
+            case Opcode::NOT:
+                out = bit_xor(load(reg_row(instr.rs1, o)), ones);
+                set_flags(o, mask, out);
+                break;
+
+            case Opcode::SHL:
+            case Opcode::SHR: {
+                Vec a = load(reg_row(instr.rs1, o));
+                int shift = instr.imm;
+                Vec carry;
+                if (shift < 0 || shift > 15) {
+                    out = zero;
+                    carry = zero;
+                } else if (instr.opcode == Opcode::SHL) {
+                    Vec bit = splat(static_cast<int16_t>(1 << (15 - shift)));
+                    carry = and_not(equal(bit_and(a, bit), zero), ones);
+                    out = shift_left(a, shift);
+                } else if (shift == 0) {
+                    // ALU::shift_right tests bit -1, which x86 wraps to the sign bit
+                    carry = greater(zero, a);
+                    out = a;
+                } else {
+                    Vec bit = splat(static_cast<int16_t>(1 << (shift - 1)));
+                    carry = and_not(equal(bit_and(a, bit), zero), ones);
+                    out = shift_right(a, shift);
+                }
+                store(&flag_c[o], blend(mask, carry, load(&flag_c[o])));
+                set_flags(o, mask, out);
+                break;
+            }
+
+            case Opcode::LDI:
+                out = splat(instr.imm);
+                break;
+
+            case Opcode::LD:
+            case Opcode::ST:
+                memory_op(instr, o, mask);
+                return;
+
+            case Opcode::JMP:
+            case Opcode::JZ:
+            case Opcode::JNZ: {
+                Vec next = splat(static_cast<int16_t>(pc + 2));
+                Vec base = load(reg_row(instr.rs1, o));
+                base = blend(equal(base, zero), next, base);
+                Vec target = add(base, splat(instr.imm));
+                Vec taken = instr.opcode == Opcode::JMP ? ones
+                          : instr.opcode == Opcode::JZ ? load(&flag_z[o])
+                          : and_not(load(&flag_z[o]), ones);
+                store(&pcs[o], blend(mask, blend(taken, target, next), load(&pcs[o])));
+                return;
+            }
+
+            case Opcode::HLT:
+                store(&pcs[o], blend(mask, splat(static_cast<int16_t>(pc)), load(&pcs[o])));
+                retire_halted(o, mask);
+                return;
+        }
+        int16_t* row = reg_row(instr.rd, o);
+        store(row, blend(mask, out, load(row)));
+    }
+
+    // Issue the instruction at pc to every live lane sitting there
+    void step(uint16_t pc) {
+        const Instruction instr = fetch(pc);
+        const bool control = instr.opcode >= Opcode::JMP;  // JMP, JZ, JNZ, HLT
+        const Vec at = lanes::splat(static_cast<int16_t>(pc));
+        const Vec next = lanes::splat(static_cast<int16_t>(pc + 2));
+        const Vec one = lanes::splat(1);
+        for (size_t o = 0; o < padded; o += WIDTH) {
+            Vec mask = lanes::load(&live[o]);
+            if (!converged) {
+                mask = lanes::bit_and(mask, lanes::equal(lanes::load(&pcs[o]), at));
+                Vec wait = lanes::load(&waiting[o]);
+                lanes::store(&waiting[o], lanes::and_not(mask, lanes::add_sat_unsigned(wait, one)));
+            }
+            if (!lanes::any(mask)) continue;
+            lanes::store(&counts[o], lanes::sub(lanes::load(&counts[o]), mask));
+            execute_group(instr, o, mask, pc);
+            if (!control && !converged) {
+                lanes::store(&pcs[o], lanes::blend(mask, next, lanes::load(&pcs[o])));
+            }
+        }
+        if (!converged) return;
+        if (!control) {
+            shared_pc = static_cast<uint16_t>(pc + 2);
+        } else if (live_count > 0) {
+            // A branch may have split the lanes
+            converged = false;
+            lowest_pc();
+        }
+    }
+
+    void peel_starved() {
+        for (size_t lane = 0; lane < lane_count; lane++) {
+            if (live[lane] && static_cast<uint16_t>(waiting[lane]) >= peel_after) peel(lane);
+        }
+    }
+
+public:
+    explicit LockstepEngine(size_t count)
+        : lane_count(count), padded((count + WIDTH - 1) / WIDTH * WIDTH),
+          regs(8 * padded, 0), flag_z(padded, 0), flag_n(padded, 0), flag_c(padded, 0),
+          flag_v(padded, 0), pcs(padded, 0), live(padded, 0), waiting(padded, 0), counts(padded, 0),
+          totals(count, 0), states(count, LaneState::RUNNING), peeled(count, 0),
+          memories(count), sinks(count), written(Memory::MEMORY_SIZE / 128, 0) {
+        for (size_t lane = 0; lane < count; lane++) {
+            live[lane] = -1;
+            memories[lane].set_output_sink(&sinks[lane]);
+        }
+        live_count = count;
+    }
+
+    // Load the same program into every lane; lanes share one copy-on-write image
+    void load_program(const std::vector<uint16_t>& program, uint16_t start_address = 0x0000) {
+        Memory staged(memories[0]);
+        staged.load_program(start_address, program);
+        Memory::SharedImage image = staged.share();
+        for (auto& memory : memories) memory.map_image(image);
+        shared_pc = start_address;
+    }
+
+    // Per-lane inputs, applied after load_program
+    void set_register(size_t lane, int r, int16_t value) {
+        reg(r, lane) = value;
+    }
+
+    void write_word(size_t lane, uint16_t address, uint16_t value) {
+        mark_written(address);
+        mark_written(static_cast<uint16_t>(address + 1));
+        memories[lane].write_word(address, value);
+    }
+
+    // Engine used for peeled lanes
+    void set_scalar_engine(Engine engine) { scalar.set_engine(engine); }
+
+    // Issued instructions a diverged lane may wait before it is peeled off
+    void set_peel_after(uint64_t instructions) {
+        peel_after = std::min<uint64_t>(std::max<uint64_t>(instructions, 1), UINT16_MAX);
+    }
+
+    // Run every lane to HLT or max_cycles instructions
+    void run(uint64_t budget = UINT64_MAX) {
+        max_cycles = budget;
+        if (lane_count > 0) image = memories[0];
+        image.set_console_echo(false);
+        auto start = std::chrono::steady_clock::now();
+        while (live_count > 0) {
+            if (steps >= next_fold) {
+                fold_counts();
+                if (live_count == 0) break;
+            }
+            uint16_t pc = shared_pc;
+            if (!converged) {
+                pc = lowest_pc();
+                reconvergences += converged;
+            }
+            step(pc);
+            steps++;
+            if (!converged && steps % PEEL_CHECK_INTERVAL == 0) peel_starved();
+        }
+        fold_counts();
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t get_lane_count() const { return lane_count; }
+    uint64_t get_steps() const { return steps; }
+    uint64_t get_peel_count() const { return peel_count; }
+    uint64_t get_scalar_instructions() const { return scalar_instructions; }
+    double get_seconds() const { return seconds; }
+
+    uint64_t get_lane_instructions() const {
+        uint64_t total = 0;
+        for (uint64_t t : totals) total += t;
+        return total;
+    }
+
+    LaneResult result(size_t lane) const {
+        LaneResult r;
+        for (int i = 0; i < 8; i++) r.gprs[i] = regs[i * padded + lane];
+        r.sprs.PC = static_cast<uint16_t>(pcs[lane]);
+        r.sprs.flags.Z = flag_z[lane] != 0;
+        r.sprs.flags.N = flag_n[lane] != 0;
+        r.sprs.flags.C = flag_c[lane] != 0;
+        r.sprs.flags.V = flag_v[lane] != 0;
+        r.state = states[lane];
+        r.instructions = totals[lane];
+        r.peeled = peeled[lane] != 0;
+        r.output = &sinks[lane].lines;
+        return r;
+    }
+
+    const Memory& lane_memory(size_t lane) const { return memories[lane]; }
+
+    // Print every lane's outcome and output, then lane throughput
+    void print_report() const {
+        std::cout << "\n=== Lockstep Results ===" << std::endl;
+        for (size_t lane = 0; lane < lane_count; lane++) {
+            LaneResult r = result(lane);
+            std::cout << "[" << lane << "] " << (r.state == LaneState::HALTED ? "halted" : "budget")
+                      << " after " << r.instructions << " instructions, PC 0x" << std::hex
+                      << std::setw(4) << std::setfill('0') << r.sprs.PC << ", regs";
+            for (int i = 0; i < 8; i++) {
+                std::cout << " " << std::setw(4) << static_cast<uint16_t>(r.gprs[i]);
+            }
+            std::cout << std::dec << std::setfill(' ') << (r.peeled ? " (peeled)" : "") << std::endl;
+            for (const auto& line : *r.output) {
+                std::cout << "    " << line << std::endl;
+            }
+        }
+
+        uint64_t total = get_lane_instructions();
+        uint64_t lockstep = total - scalar_instructions;
+        std::cout << "=== Lockstep Summary ===" << std::endl;
+        std::cout << "Lanes: " << lane_count << " (" << lanes::KERNEL << ", " << WIDTH
+                  << " lanes per vector), " << peel_count << " peeled, "
+                  << reconvergences << " reconvergences" << std::endl;
+        std::cout << "Issued: " << steps << " instructions, " << lockstep << " lane-instructions in lockstep";
+        if (steps > 0 && lane_count > 0) {
+            std::cout << " (" << std::fixed << std::setprecision(1)
+                      << (100.0 * lockstep / (static_cast<double>(steps) * lane_count))
+                      << "% lane utilization)" << std::defaultfloat;
+        }
+        std::cout << ", " << scalar_instructions << " on the scalar engine" << std::endl;
+        std::cout << "Lane-instructions: " << total << "  time: " << std::fixed << std::setprecision(3)
+                  << seconds << " s";
+        if (seconds > 0) {
+            std::cout << "  lane-MIPS: " << std::setprecision(1) << (total / seconds / 1e6);
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+};
+
+} // namespace cpu
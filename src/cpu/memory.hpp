@@ -5,10 +5,51 @@
 #include <iomanip>
 #include <vector>
 #include <string>
+#include <array>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <bitset>
+#include "compiler.hpp"
+#include "console.hpp"
+#include "input.hpp"
 
 namespace cpu {
 
+class Memory;
+
+// Memory-mapped I/O device
+// Handlers get the Memory the access came through. Registers that belong to
+// one machine rather than to the device can live in that Memory's backing
+// RAM (read_backing / write_backing), so snapshots and copies carry them.
+// Devices that act later schedule an event on the Memory and are ticked
+// when the run loop reaches it (see Memory::schedule).
+class Device {
+public:
+    virtual ~Device() = default;
+    virtual uint8_t read(const Memory& memory, uint16_t address) = 0;
+    virtual void write(Memory& memory, uint16_t address, uint8_t value) = 0;
+    // A scheduled event is due; cycle is the one it was scheduled for
+    virtual void tick(Memory& memory, uint64_t cycle) {
+        (void)memory;
+        (void)cycle;
+    }
+    // Pending events were dropped because RAM or the cycle count was
+    // replaced (restore, image load, reset); re-arm from the registers
+    virtual void restart(Memory& memory, uint64_t now) {
+        (void)memory;
+        (void)now;
+    }
+};
+
 // Memory class with memory-mapped I/O
+// RAM is a table of 256-byte pages. A page either maps a read-only image
+// shared with other Memory objects or is private to this one; the first
+// write to a shared page copies it, so instances loaded from the same
+// program only pay for the pages they actually write. Pages with a device
+// mapped anywhere in them are tagged in the table and dispatched to the
+// device; every other page takes the direct RAM path.
 class Memory {
 public:
     static constexpr size_t MEMORY_SIZE = 65536;  // 64KB
@@ -18,65 +59,499 @@ public:
     static constexpr uint16_t IO_STDOUT = 0xFF00;   // Character output
     static constexpr uint16_t IO_STDIN = 0xFF01;    // Character input
     static constexpr uint16_t IO_STATUS = 0xFF02;   // Status register
+    static constexpr uint16_t IO_FLUSH = 0xFF03;    // Console flush (write any value)
+    
+    // Copy-on-write and dirty tracking granularity
+    static constexpr size_t PAGE_SIZE = 256;
+    static constexpr size_t PAGE_COUNT = MEMORY_SIZE / PAGE_SIZE;
+    
+    // Page table entry tags: the page points into the shared image, or has a device mapped
+    static constexpr uintptr_t SHARED_PAGE = 1;
+    static constexpr uintptr_t DEVICE_PAGE = 2;
+    static constexpr uintptr_t PAGE_TAGS = SHARED_PAGE | DEVICE_PAGE;
+    
+    // Full 64KB contents that any number of Memory objects can map read-only.
+    // The owner may be a heap buffer or a file mapping (see ImageFile).
+    using SharedImage = std::shared_ptr<const uint8_t>;
+    
+    // Saved RAM contents (see save_image / restore_image)
+    struct Image {
+        std::vector<uint8_t> bytes;
+        std::string output_buffer;
+        uint64_t id = 0;
+    };
+    
+    // Notified when a write lands on a word that holds predecoded code
+    class CodeWatcher {
+    public:
+        virtual ~CodeWatcher() = default;
+        virtual void on_code_write(uint16_t address) = 0;
+    };
+    
+    // Receives completed console lines instead of std::cout (e.g. per-job capture)
+    class OutputSink {
+    public:
+        virtual ~OutputSink() = default;
+        virtual void write_line(const std::string& line) = 0;
+    };
+    
+    // Address ranges routed to devices; shared by copies, replaced on change
+    struct DeviceMap {
+        struct Mapping {
+            uint16_t base;
+            uint16_t last;   // Inclusive, so a range can end at 0xFFFF
+            Device* device;
+        };
+        std::vector<Mapping> mappings;
+        std::bitset<PAGE_COUNT> pages;  // Pages any mapping touches
+        
+        // Later mappings take precedence
+        Device* find(uint16_t address) const {
+            for (auto it = mappings.rbegin(); it != mappings.rend(); ++it) {
+                if (address >= it->base && address <= it->last) return it->device;
+            }
+            return nullptr;
+        }
+    };
+    using DeviceMapPtr = std::shared_ptr<const DeviceMap>;
     
 private:
-    std::vector<uint8_t> mem;
+    SharedImage image;                              // Backs every page not yet written
+    std::array<uintptr_t, PAGE_COUNT> pages;        // Page base | PAGE_TAGS
+    DeviceMapPtr devices;                           // Console registers unless changed
+    size_t private_count = 0;                       // Pages copied out of the image
     std::string output_buffer;  // For capturing stdout
+    std::vector<uint64_t> code_words;  // One bit per 16-bit word, allocated on first watch
+    CodeWatcher* code_watcher = nullptr;
+    bool console_echo = true;   // Send output to the console at all
+    OutputSink* output_sink = nullptr;  // Collects lines instead of the console when set
+    ConsoleBuffer* console = nullptr;   // Console stream (nullptr = standard output)
+    ConsoleInput* input = nullptr;      // STDIN source (nullptr = no input)
+    std::array<uint8_t, PAGE_COUNT> dirty_pages{};  // Written since the baseline image
+    uint64_t baseline = 0;                          // Image id dirty_pages is relative to
+    // Entries displaced by bank windows (0 = page shows its own contents),
+    // allocated on the first map_window
+    std::unique_ptr<std::array<uintptr_t, PAGE_COUNT>> banked;
+    bool banking = true;        // map_window takes effect (see detach_banks)
+    uint64_t bank_switches = 0;
+    // Device time: the cycle of the store being dispatched, or of the slice start
+    uint64_t clock = 0;
+    using Event = std::pair<uint64_t, Device*>;  // (due cycle, device)
+    struct EventLater {
+        bool operator()(const Event& a, const Event& b) const { return a.first > b.first; }
+    };
+    std::vector<Event> events;  // Min-heap on the due cycle
+    uint64_t events_fired = 0;
+    bool replay = false;        // Re-executing work another machine already did
+    bool slice_ended = false;   // A store asked the run loop to look at devices (not copied)
+    
+    static uint64_t next_image_id() {
+        static std::atomic<uint64_t> counter{0};
+        return ++counter;
+    }
+    
+    // Zeroed RAM with the status register ready, shared by every fresh Memory
+    static const SharedImage& power_on_image() {
+        static const SharedImage blank = [] {
+            auto bytes = std::make_shared<std::vector<uint8_t>>(MEMORY_SIZE, 0);
+            (*bytes)[IO_STATUS] = 0x01;  // Ready
+            return SharedImage(bytes, bytes->data());
+        }();
+        return blank;
+    }
+    
+    // STDOUT, STDIN, STATUS and FLUSH at their fixed addresses (defined below the class)
+    static const DeviceMapPtr& console_devices();
+    
+    const uint8_t* image_page(size_t page) const {
+        return image.get() + page * PAGE_SIZE;
+    }
+    
+    const uint8_t* page_data(size_t page) const {
+        return reinterpret_cast<const uint8_t*>(pages[page] & ~PAGE_TAGS);
+    }
+    
+    uintptr_t device_tag(size_t page) const {
+        return devices->pages[page] ? DEVICE_PAGE : 0;
+    }
+    
+    // Give a shared page its own copy (the first store to it)
+    CPU_NOINLINE void copy_page(size_t page) {
+        uint8_t* copy = new uint8_t[PAGE_SIZE];
+        std::memcpy(copy, page_data(page), PAGE_SIZE);
+        pages[page] = reinterpret_cast<uintptr_t>(copy) | device_tag(page);
+        private_count++;
+    }
+    
+    CPU_ALWAYS_INLINE uint8_t* writable_page(size_t page) {
+        if (pages[page] & SHARED_PAGE) copy_page(page);
+        return reinterpret_cast<uint8_t*>(pages[page] & ~PAGE_TAGS);
+    }
+    
+    // Drop a private copy and point the page back at the image
+    void share_page(size_t page) {
+        if (!(pages[page] & SHARED_PAGE)) {
+            delete[] reinterpret_cast<uint8_t*>(pages[page] & ~PAGE_TAGS);
+            private_count--;
+        }
+        pages[page] = reinterpret_cast<uintptr_t>(image_page(page)) | SHARED_PAGE | device_tag(page);
+    }
+    
+    // Point every page at the image without freeing anything
+    void map_pages() {
+        for (size_t page = 0; page < PAGE_COUNT; page++) {
+            pages[page] = reinterpret_cast<uintptr_t>(image_page(page)) | SHARED_PAGE | device_tag(page);
+        }
+        private_count = 0;
+    }
+    
+    // Put the displaced entries back under every bank window
+    void unbank_pages() {
+        if (!banked) return;
+        for (size_t page = 0; page < PAGE_COUNT; page++) {
+            if ((*banked)[page]) pages[page] = ((*banked)[page] & ~DEVICE_PAGE) | device_tag(page);
+        }
+        banked.reset();
+    }
+    
+    // A page's contents are being swapped out wholesale: report its watched code
+    void drop_page_code(size_t page) {
+        if (!code_watcher || code_words.empty() || !(code_words[page * 2] | code_words[page * 2 + 1])) return;
+        for (size_t a = page * PAGE_SIZE; a < (page + 1) * PAGE_SIZE; a += 2) {
+            uint16_t address = static_cast<uint16_t>(a);
+            if (!is_code(address)) continue;
+            unwatch_code(address);
+            code_watcher->on_code_write(address);
+        }
+    }
+    
+    void release_pages() {
+        unbank_pages();
+        for (size_t page = 0; page < PAGE_COUNT; page++) {
+            share_page(page);
+        }
+    }
+    
+    void set_devices(DeviceMapPtr map) {
+        devices = std::move(map);
+        for (size_t page = 0; page < PAGE_COUNT; page++) {
+            pages[page] = (pages[page] & ~DEVICE_PAGE) | device_tag(page);
+        }
+    }
+    
+    CPU_ALWAYS_INLINE bool is_code(uint16_t address) const {
+        return !code_words.empty() && ((code_words[address >> 7] >> ((address >> 1) & 63)) & 1);
+    }
+    
+    // Lines are assembled here only for a sink or a silenced console
+    bool line_mode() const {
+        return output_sink || !console_echo;
+    }
+    
+    void emit_line(const std::string& line) {
+        if (console_echo && output_sink) output_sink->write_line(line);
+    }
     
 public:
-    Memory() : mem(MEMORY_SIZE, 0) {
-        // Initialize I/O status register
-        mem[IO_STATUS] = 0x01;  // Ready
+    Memory() : image(power_on_image()), devices(console_devices()) {
+        map_pages();
+    }
+    
+    // Map shared read-only; pages are copied on first write
+    explicit Memory(SharedImage shared) : image(std::move(shared)), devices(console_devices()) {
+        map_pages();
+    }
+    
+    // Copies share the image and duplicate only the private pages; bank
+    // windows keep showing the same bank buffers until the copy is remapped
+    Memory(const Memory& other)
+        : image(other.image), pages(other.pages), devices(other.devices), private_count(other.private_count),
+          output_buffer(other.output_buffer), code_words(other.code_words),
+          code_watcher(other.code_watcher), console_echo(other.console_echo),
+          output_sink(other.output_sink), console(other.console), input(other.input), dirty_pages(other.dirty_pages), baseline(other.baseline),
+          banking(other.banking), bank_switches(other.bank_switches), clock(other.clock), events(other.events),
+          events_fired(other.events_fired), replay(other.replay) {
+        if (other.banked) banked = std::make_unique<std::array<uintptr_t, PAGE_COUNT>>(*other.banked);
+        for (size_t page = 0; page < PAGE_COUNT; page++) {
+            uintptr_t& entry = is_banked(page) ? (*banked)[page] : pages[page];
+            if (entry & SHARED_PAGE) continue;
+            uint8_t* copy = new uint8_t[PAGE_SIZE];
+            std::memcpy(copy, reinterpret_cast<const uint8_t*>(entry & ~PAGE_TAGS), PAGE_SIZE);
+            entry = reinterpret_cast<uintptr_t>(copy) | (entry & DEVICE_PAGE);
+        }
+    }
+    
+    Memory(Memory&& other) noexcept
+        : image(other.image), pages(other.pages), devices(other.devices), private_count(other.private_count),
+          output_buffer(std::move(other.output_buffer)), code_words(std::move(other.code_words)),
+          code_watcher(other.code_watcher), console_echo(other.console_echo),
+          output_sink(other.output_sink), console(other.console), input(other.input), dirty_pages(other.dirty_pages), baseline(other.baseline),
+          banked(std::move(other.banked)), banking(other.banking), bank_switches(other.bank_switches),
+          clock(other.clock), events(std::move(other.events)), events_fired(other.events_fired), replay(other.replay) {
+        // Our pages now own the private copies; leave other mapping the image
+        other.map_pages();
+    }
+    
+    Memory& operator=(Memory other) noexcept {
+        std::swap(image, other.image);
+        std::swap(pages, other.pages);
+        std::swap(devices, other.devices);
+        std::swap(private_count, other.private_count);
+        std::swap(output_buffer, other.output_buffer);
+        std::swap(code_words, other.code_words);
+        std::swap(code_watcher, other.code_watcher);
+        std::swap(console_echo, other.console_echo);
+        std::swap(output_sink, other.output_sink);
+        std::swap(console, other.console);
+        std::swap(input, other.input);
+        std::swap(dirty_pages, other.dirty_pages);
+        std::swap(baseline, other.baseline);
+        std::swap(banked, other.banked);
+        std::swap(banking, other.banking);
+        std::swap(bank_switches, other.bank_switches);
+        std::swap(clock, other.clock);
+        std::swap(events, other.events);
+        std::swap(events_fired, other.events_fired);
+        std::swap(replay, other.replay);
+        return *this;
+    }
+    
+    ~Memory() {
+        release_pages();
     }
     
     // Read byte from memory
     uint8_t read_byte(uint16_t address) const {
-        if (static_cast<size_t>(address) >= MEMORY_SIZE) return 0;
-        
-        // Memory-mapped I/O read
-        if (address == IO_STDIN) {
-            // For now, return 0 (no input)
-            return 0;
+        uintptr_t entry = pages[address >> 8];
+        if (entry & DEVICE_PAGE) {
+            if (Device* device = devices->find(address)) return device->read(*this, address);
         }
-        
-        return mem[address];
+        return reinterpret_cast<const uint8_t*>(entry & ~PAGE_TAGS)[address & 0xFF];
     }
     
     // Write byte to memory
     void write_byte(uint16_t address, uint8_t value) {
-        if (static_cast<size_t>(address) >= MEMORY_SIZE) return;
+        // Self-modifying code: let the decoder drop stale entries
+        if (is_code(address)) {
+            unwatch_code(address);
+            code_watcher->on_code_write(address);
+        }
         
-        // Memory-mapped I/O write
-        if (address == IO_STDOUT) {
-            // Output character
-            char c = static_cast<char>(value);
-            if (c == '\n') {
-                std::cout << output_buffer << std::endl;
-                output_buffer.clear();
-            } else if (c >= 32 && c < 127) {
-                output_buffer += c;
+        if (pages[address >> 8] & DEVICE_PAGE) {
+            if (Device* device = devices->find(address)) {
+                device->write(*this, address, value);
+                return;
             }
-            return;
         }
-        
-        mem[address] = value;
+        write_backing(address, value);
     }
     
     // Read 16-bit word (little-endian)
-    uint16_t read_word(uint16_t address) const {
-        if (static_cast<size_t>(address) >= MEMORY_SIZE - 1) return 0;
+    // A word inside one RAM page is a single load; device pages and words
+    // straddling two pages go byte by byte.
+    CPU_ALWAYS_INLINE uint16_t read_word(uint16_t address) const {
+        if (address == 0xFFFF) return 0;
+        uintptr_t entry = pages[address >> 8];
+        if ((address & 0xFF) != 0xFF && !(entry & DEVICE_PAGE)) {
+            const uint8_t* bytes = reinterpret_cast<const uint8_t*>(entry & ~PAGE_TAGS) + (address & 0xFF);
+            return static_cast<uint16_t>(bytes[0] | (bytes[1] << 8));
+        }
         uint16_t low = read_byte(address);
         uint16_t high = read_byte(address + 1);
         return low | (high << 8);
     }
     
     // Write 16-bit word (little-endian)
-    void write_word(uint16_t address, uint16_t value) {
-        if (static_cast<size_t>(address) >= MEMORY_SIZE - 1) return;
+    CPU_ALWAYS_INLINE void write_word(uint16_t address, uint16_t value) {
+        write_word(address, value, clock);
+    }
+    
+    // Store by the instruction that runs at cycle now (the number of
+    // instructions before it). A device it reaches sees now as the device
+    // clock, so a countdown started mid-slice starts at the store.
+    CPU_ALWAYS_INLINE void write_word(uint16_t address, uint16_t value, uint64_t now) {
+        if (address == 0xFFFF) return;
+        size_t page = address >> 8;
+        if ((address & 0xFF) != 0xFF && !(pages[page] & DEVICE_PAGE) &&
+            !is_code(address) && !is_code(address + 1)) {
+            uint8_t* bytes = writable_page(page) + (address & 0xFF);
+            bytes[0] = static_cast<uint8_t>(value);
+            bytes[1] = static_cast<uint8_t>(value >> 8);
+            dirty_pages[page] = 1;
+            return;
+        }
+        clock = now;
         write_byte(address, value & 0xFF);
         write_byte(address + 1, (value >> 8) & 0xFF);
     }
     
+    // RAM under a device page, for device registers kept per machine
+    uint8_t read_backing(uint16_t address) const {
+        return page_data(address >> 8)[address & 0xFF];
+    }
+    
+    void write_backing(uint16_t address, uint8_t value) {
+        writable_page(address >> 8)[address & 0xFF] = value;
+        dirty_pages[address >> 8] = 1;
+    }
+    
+    // Route [base, last] to device. Only the pages it touches leave the RAM
+    // fast path. Copies made afterwards share the mapping (and the device).
+    void attach_device(uint16_t base, uint16_t last, Device* device) {
+        auto map = std::make_shared<DeviceMap>(*devices);
+        map->mappings.push_back({base, last, device});
+        for (size_t page = base >> 8; page <= static_cast<size_t>(last >> 8); page++) {
+            map->pages[page] = true;
+        }
+        set_devices(std::move(map));
+    }
+    
+    // Remove every mapping to device; its addresses become plain RAM again
+    void detach_device(Device* device) {
+        auto map = std::make_shared<DeviceMap>();
+        for (const auto& mapping : devices->mappings) {
+            if (mapping.device == device) continue;
+            map->mappings.push_back(mapping);
+            for (size_t page = mapping.base >> 8; page <= static_cast<size_t>(mapping.last >> 8); page++) {
+                map->pages[page] = true;
+            }
+        }
+        set_devices(std::move(map));
+        cancel_events(device);
+    }
+    
+    const DeviceMap& get_devices() const {
+        return *devices;
+    }
+    
+    // Device time is the cycle of the store being dispatched, or else the
+    // cycle count at the start of the current run slice; run loops end a
+    // slice at the earliest scheduled event and tick the devices that are
+    // due. Devices without events never see the clock.
+    uint64_t device_clock() const {
+        return clock;
+    }
+    
+    // Events sit in a min-heap on the due cycle, so finding the next one is
+    // O(1) and no device is looked at until its event is due. An event
+    // scheduled by a store ends the slice so the next one is sized to it.
+    void schedule(Device* device, uint64_t cycle) {
+        events.emplace_back(cycle, device);
+        std::push_heap(events.begin(), events.end(), EventLater());
+        slice_ended = true;
+    }
+    
+    void cancel_events(Device* device) {
+        auto end = std::remove_if(events.begin(), events.end(),
+                                  [device](const Event& e) { return e.second == device; });
+        if (end == events.end()) return;
+        events.erase(end, events.end());
+        std::make_heap(events.begin(), events.end(), EventLater());
+    }
+    
+    // Drop every pending event and let each mapped device re-arm from its
+    // registers at now (RAM or the cycle count was replaced)
+    void restart_devices(uint64_t now) {
+        events.clear();
+        clock = now;
+        std::vector<Device*> seen;
+        for (const auto& mapping : devices->mappings) {
+            if (std::find(seen.begin(), seen.end(), mapping.device) != seen.end()) continue;
+            seen.push_back(mapping.device);
+            mapping.device->restart(*this, now);
+        }
+    }
+    
+    uint64_t next_device_event() const {
+        return events.empty() ? UINT64_MAX : events.front().first;
+    }
+    
+    // Some device has an event scheduled, so run loops keep slices short
+    bool has_pending_events() const {
+        return !events.empty();
+    }
+    
+    // A device register changed in a way the run loop must act on before
+    // the next instruction (an interrupt may now be taken, or an event was
+    // scheduled that the current slice does not stop for). Engines check
+    // this after every store and stop there; tick_devices clears it, since
+    // run loops check for interrupts right after ticking.
+    void end_slice() {
+        slice_ended = true;
+    }
+    
+    bool is_slice_ended() const {
+        return slice_ended;
+    }
+    
+    // Advance device time to now and tick every device whose event is due
+    void tick_devices(uint64_t now) {
+        clock = now;
+        while (!events.empty() && events.front().first <= now) {
+            std::pop_heap(events.begin(), events.end(), EventLater());
+            Event event = events.back();
+            events.pop_back();
+            events_fired++;
+            event.second->tick(*this, event.first);  // May schedule again
+        }
+        slice_ended = false;  // The caller looks at the interrupt lines next
+    }
+    
+    // Events fired so far; the JIT validator resyncs when this moves
+    uint64_t get_events_fired() const {
+        return events_fired;
+    }
+    
+    // A replaying copy (the JIT validator's shadow) gets the same device
+    // effects on its own RAM, but devices leave host-side counters alone
+    void set_replay(bool enable) {
+        replay = enable;
+    }
+    
+    bool is_replay() const {
+        return replay;
+    }
+    
+    // Console output: printable characters and newlines go to the console
+    // stream, or are assembled into lines for a sink
+    void console_write(uint8_t value) {
+        char c = static_cast<char>(value);
+        if (c != '\n' && (c < 32 || c >= 127)) return;
+        if (!line_mode()) {
+            console_stream().put(value);
+        } else if (c == '\n') {
+            emit_line(output_buffer);
+            output_buffer.clear();
+        } else {
+            output_buffer += c;
+        }
+    }
+    
+    // Guest flush register
+    void console_flush() {
+        if (!line_mode()) console_stream().flush(ConsoleBuffer::GUEST);
+    }
+    
+    ConsoleBuffer& console_stream() const {
+        return console ? *console : ConsoleBuffer::standard();
+    }
+    
+    // STDIN: next input byte, or 0 when none is waiting
+    uint8_t console_read() const {
+        return input ? input->read() : 0;
+    }
+    
+    // STATUS input bits; without a source they stay clear, so STATUS reads
+    // 0x01 as it did before console input existed
+    uint8_t input_status() const {
+        return input ? input->status() : 0;
+    }
+    
+    // Guest reads of STDIN or STATUS so far (their results depend on timing)
+    uint64_t input_polls() const {
+        return input ? input->get_polls() : 0;
+    }
+    
     // Load program into memory starting at address
     void load_program(uint16_t start_address, const std::vector<uint16_t>& program) {
         for (size_t i = 0; i < program.size(); i++) {
@@ -84,6 +559,315 @@ public:
         }
     }
     
+    // Mark the word holding address as code, reporting future writes to watcher
+    void watch_code(uint16_t address, CodeWatcher* watcher) {
+        if (code_words.empty()) code_words.assign(MEMORY_SIZE / 128, 0);
+        code_words[address >> 7] |= uint64_t(1) << ((address >> 1) & 63);
+        code_watcher = watcher;
+    }
+    
+    // Stop reporting writes to the word holding address
+    void unwatch_code(uint16_t address) {
+        if (code_words.empty()) return;
+        code_words[address >> 7] &= ~(uint64_t(1) << ((address >> 1) & 63));
+    }
+    
+    // Forget all watched code words (e.g. after copying another Memory)
+    void clear_code_watch() {
+        std::vector<uint64_t>().swap(code_words);
+        code_watcher = nullptr;
+    }
+    
+    // Silence the console, for shadow copies that must not print
+    void set_console_echo(bool echo) {
+        console_echo = echo;
+    }
+    
+    // Send console lines to sink instead of the console (nullptr restores the console)
+    void set_output_sink(OutputSink* sink) {
+        output_sink = sink;
+    }
+    
+    // Console stream for this machine's output (nullptr = standard output)
+    void set_console(ConsoleBuffer* stream) {
+        console = stream;
+    }
+    
+    // Source for STDIN reads (nullptr = none); copies share it
+    void set_input(ConsoleInput* source) {
+        input = source;
+    }
+    
+    ConsoleInput* get_input() const {
+        return input;
+    }
+    
+    // Zero RAM and restore power-on I/O state; the caller drops decoded code
+    void clear() {
+        map_image(power_on_image());
+    }
+    
+    // Replace RAM with a shared image, copy-on-write; the caller drops decoded code
+    void map_image(SharedImage shared) {
+        release_pages();
+        image = std::move(shared);
+        map_pages();
+        output_buffer.clear();
+        if (!code_words.empty()) std::fill(code_words.begin(), code_words.end(), 0);
+        dirty_pages.fill(0);
+        baseline = 0;
+    }
+    
+    // Freeze the current contents into an image other instances can map
+    SharedImage share() const {
+        auto bytes = std::make_shared<std::vector<uint8_t>>(MEMORY_SIZE);
+        for (size_t page = 0; page < PAGE_COUNT; page++) {
+            std::memcpy(bytes->data() + page * PAGE_SIZE, page_data(page), PAGE_SIZE);
+        }
+        return SharedImage(bytes, bytes->data());
+    }
+    
+    // Copy RAM into an image that later restores can diff against
+    Image save_image() {
+        Image saved{std::vector<uint8_t>(MEMORY_SIZE), output_buffer, next_image_id()};
+        for (size_t page = 0; page < PAGE_COUNT; page++) {
+            std::memcpy(&saved.bytes[page * PAGE_SIZE], page_data(page), PAGE_SIZE);
+        }
+        baseline = saved.id;
+        dirty_pages.fill(0);
+        return saved;
+    }
+    
+    // Put RAM back to saved. If saved is the last image saved or restored
+    // here, only pages written since are examined; otherwise all of them.
+    // Pages that end up equal to the shared image go back to mapping it.
+    // Watched code words that change are reported like any other store.
+    // Returns the number of pages copied.
+    size_t restore_image(const Image& saved) {
+        bool full = saved.id != baseline;
+        size_t copied = 0;
+        for (size_t page = 0; page < PAGE_COUNT; page++) {
+            if (!full && !dirty_pages[page]) continue;
+            size_t base = page * PAGE_SIZE;
+            const uint8_t* target = &saved.bytes[base];
+            const uint8_t* current = page_data(page);
+            if (std::memcmp(current, target, PAGE_SIZE) == 0) continue;
+            // A page spans two 64-bit words of the code bitmap
+            if (code_watcher && !code_words.empty() && (code_words[page * 2] | code_words[page * 2 + 1])) {
+                for (size_t a = base; a < base + PAGE_SIZE; a += 2) {
+                    uint16_t address = static_cast<uint16_t>(a);
+                    if (is_code(address) && std::memcmp(&current[a - base], &target[a - base], 2) != 0) {
+                        unwatch_code(address);
+                        code_watcher->on_code_write(address);
+                    }
+                }
+            }
+            if (!is_banked(page) && std::memcmp(image_page(page), target, PAGE_SIZE) == 0) {
+                share_page(page);
+            } else {
+                std::memcpy(writable_page(page), target, PAGE_SIZE);
+            }
+            copied++;
+        }
+        dirty_pages.fill(0);
+        baseline = saved.id;
+        output_buffer = saved.output_buffer;
+        return copied;
+    }
+    
+    // Pages written since the last save or restore
+    size_t dirty_page_count() const {
+        return static_cast<size_t>(std::count(dirty_pages.begin(), dirty_pages.end(), 1));
+    }
+    
+    // Pages this Memory owns rather than maps from the shared image
+    size_t private_pages() const {
+        return private_count;
+    }
+    
+    // Heap and object bytes owned by this Memory; the shared image is not counted
+    size_t resident_bytes() const {
+        return sizeof(Memory) + private_count * PAGE_SIZE + (banked ? sizeof(*banked) : 0) +
+               code_words.capacity() * sizeof(uint64_t) + output_buffer.capacity();
+    }
+    
+    const SharedImage& shared_image() const {
+        return image;
+    }
+    
+    // Current contents of one page (RAM only, devices are not consulted)
+    const uint8_t* page_bytes(size_t page) const {
+        return page_data(page);
+    }
+    
+    // Show count pages of external RAM (one bank of an MMU's store) from
+    // first_page on, or the pages' own contents again when bytes is nullptr.
+    // Only page-table entries change, so RAM accesses cost the same either
+    // way. The store must outlive the mapping and be 4-byte aligned; copies
+    // share it. Watched code in the window is reported as overwritten.
+    void map_window(size_t first_page, size_t count, uint8_t* bytes) {
+        if (!banking) return;
+        if (bytes && !banked) banked = std::make_unique<std::array<uintptr_t, PAGE_COUNT>>();
+        bool changed = false;
+        for (size_t page = first_page; page < first_page + count && page < PAGE_COUNT; page++) {
+            if (bytes) {
+                uintptr_t target = reinterpret_cast<uintptr_t>(bytes + (page - first_page) * PAGE_SIZE);
+                if ((pages[page] & ~PAGE_TAGS) == target) continue;
+                if (!(*banked)[page]) (*banked)[page] = pages[page];
+                pages[page] = target | device_tag(page);
+            } else {
+                if (!is_banked(page)) continue;
+                pages[page] = ((*banked)[page] & ~DEVICE_PAGE) | device_tag(page);
+                (*banked)[page] = 0;
+            }
+            drop_page_code(page);
+            dirty_pages[page] = 1;
+            changed = true;
+        }
+        if (changed) bank_switches++;
+    }
+    
+    // Give each bank window a private copy of what it shows and ignore later
+    // map_window calls, so this copy can run without writing the bank store
+    // (the JIT validator's shadow machine)
+    void detach_banks() {
+        banking = false;
+        if (!banked) return;
+        for (size_t page = 0; page < PAGE_COUNT; page++) {
+            uintptr_t displaced = (*banked)[page];
+            if (!displaced) continue;
+            uint8_t* copy = new uint8_t[PAGE_SIZE];
+            std::memcpy(copy, page_data(page), PAGE_SIZE);
+            if (displaced & SHARED_PAGE) {
+                private_count++;
+            } else {
+                delete[] reinterpret_cast<uint8_t*>(displaced & ~PAGE_TAGS);
+            }
+            pages[page] = reinterpret_cast<uintptr_t>(copy) | device_tag(page);
+        }
+        banked.reset();
+    }
+    
+    // True while a bank window covers page
+    bool is_banked(size_t page) const {
+        return banked && (*banked)[page] != 0;
+    }
+    
+    // map_window calls that changed the page table
+    uint64_t get_bank_switches() const {
+        return bank_switches;
+    }
+    
+    // Block copy within RAM with memmove semantics, bypassing devices. The
+    // range is clipped at the top of memory. Works a page-sized chunk at a
+    // time through write_bytes, so shared pages stay shared where nothing
+    // changes and overwritten code is reported.
+    void copy_block(uint16_t destination, uint16_t source, size_t length) {
+        length = std::min({length, MEMORY_SIZE - destination, MEMORY_SIZE - source});
+        if (length == 0 || destination == source) return;
+        uint8_t chunk[PAGE_SIZE];
+        bool backwards = destination > source && destination < source + length;
+        size_t done = 0;
+        while (done < length) {
+            size_t count = std::min(PAGE_SIZE, length - done);
+            size_t offset = backwards ? length - done - count : done;
+            for (size_t i = 0; i < count;) {
+                size_t from = source + offset + i;
+                size_t run = std::min(count - i, PAGE_SIZE - from % PAGE_SIZE);
+                std::memcpy(chunk + i, page_data(from / PAGE_SIZE) + from % PAGE_SIZE, run);
+                i += run;
+            }
+            write_bytes(static_cast<uint16_t>(destination + offset), chunk, count);
+            done += count;
+        }
+    }
+    
+    // Block fill within RAM, bypassing devices; clipped at the top of memory
+    void fill_block(uint16_t destination, uint8_t value, size_t length) {
+        length = std::min(length, MEMORY_SIZE - destination);
+        uint8_t chunk[PAGE_SIZE];
+        std::memset(chunk, value, sizeof(chunk));
+        for (size_t done = 0; done < length; done += PAGE_SIZE) {
+            write_bytes(static_cast<uint16_t>(destination + done), chunk, std::min(PAGE_SIZE, length - done));
+        }
+    }
+    
+    // Copy raw bytes into RAM, bypassing devices (e.g. from an image file).
+    // Pages that already hold the bytes are left shared; watched code words
+    // in a changed page are reported like any other store.
+    void write_bytes(uint16_t address, const uint8_t* bytes, size_t length) {
+        size_t end = std::min(MEMORY_SIZE, static_cast<size_t>(address) + length);
+        for (size_t a = address; a < end;) {
+            size_t page = a / PAGE_SIZE;
+            size_t offset = a % PAGE_SIZE;
+            size_t count = std::min(PAGE_SIZE - offset, end - a);
+            const uint8_t* source = bytes + (a - address);
+            if (std::memcmp(page_data(page) + offset, source, count) != 0) {
+                if (code_watcher && !code_words.empty()) {
+                    for (size_t word = a & ~size_t(1); word < a + count; word += 2) {
+                        if (!is_code(static_cast<uint16_t>(word))) continue;
+                        unwatch_code(static_cast<uint16_t>(word));
+                        code_watcher->on_code_write(static_cast<uint16_t>(word));
+                    }
+                }
+                std::memcpy(writable_page(page) + offset, source, count);
+                dirty_pages[page] = 1;
+            }
+            a += count;
+        }
+    }
+    
+    // First RAM address below end where this and other differ, or end if none
+    size_t first_difference(const Memory& other, size_t end) const {
+        for (size_t page = 0; page * PAGE_SIZE < end; page++) {
+            if (pages[page] == other.pages[page]) continue;
+            const uint8_t* a = page_data(page);
+            const uint8_t* b = other.page_data(page);
+            size_t limit = std::min(PAGE_SIZE, end - page * PAGE_SIZE);
+            for (size_t i = 0; i < limit; i++) {
+                if (a[i] != b[i]) return page * PAGE_SIZE + i;
+            }
+        }
+        return end;
+    }
+    
+    // Page table and code-word bits, for translated code that performs plain
+    // RAM accesses itself and calls back into Memory for I/O, code words and
+    // the first write to a shared page. Null until code is first watched.
+    const uintptr_t* page_table() const {
+        return pages.data();
+    }
+    
+    const uint64_t* code_bitmap() const {
+        return code_words.data();
+    }
+    
+    // Translated stores set the byte for their page (see restore_image)
+    uint8_t* dirty_page_bytes() {
+        return dirty_pages.data();
+    }
+    
+    // Emit a partial output line and flush the console (the program halted)
+    void flush_output() {
+        if (!line_mode()) {
+            console_stream().end_output();
+            return;
+        }
+        if (output_buffer.empty()) return;
+        emit_line(output_buffer);
+        output_buffer.clear();
+    }
+    
+    // Write out buffered console bytes (control is returning to the host)
+    void flush_console() {
+        if (!line_mode()) console_stream().flush(ConsoleBuffer::HOST);
+    }
+    
+    // Timer flush, called between instruction slices
+    void poll_console() {
+        if (!line_mode()) console_stream().poll();
+    }
+    
     // Clear output buffer
     void clear_output() {
         output_buffer.clear();
@@ -95,7 +879,9 @@ public:
     }
     
     // Print memory dump (hex format)
-    void print_dump(uint16_t start = 0, uint16_t length = 256) const {
+    // overlay, if given, holds one character per byte from start, printed
+    // after each row (see HeatMap::glyphs)
+    void print_dump(uint16_t start = 0, uint16_t length = 256, const std::vector<char>* overlay = nullptr) const {
         std::cout << "=== Memory Dump (0x" << std::hex << std::setw(4) 
                   << std::setfill('0') << start << " - 0x" 
                   << std::setw(4) << (start + length - 1) << ") ===" << std::endl;
@@ -116,7 +902,15 @@ public:
                 char c = (byte >= 32 && byte < 127) ? static_cast<char>(byte) : '.';
                 std::cout << c;
             }
-            std::cout << "|" << std::endl;
+            std::cout << "|";
+            if (overlay) {
+                std::cout << " [";
+                for (int i = 0; i < 16 && static_cast<size_t>(addr - start + i) < overlay->size(); i++) {
+                    std::cout << (*overlay)[addr - start + i];
+                }
+                std::cout << "]";
+            }
+            std::cout << std::endl;
         }
         std::cout << std::dec;
     }
@@ -136,5 +930,55 @@ public:
     }
 };
 
+// STDOUT: writes go to the console; reads see nothing
+class ConsoleOutputDevice : public Device {
+public:
+    uint8_t read(const Memory&, uint16_t) override { return 0; }
+    void write(Memory& memory, uint16_t, uint8_t value) override { memory.console_write(value); }
+};
+
+// STDIN: takes the next byte from the input ring (0 if none has arrived)
+class ConsoleInputDevice : public Device {
+public:
+    uint8_t read(const Memory& memory, uint16_t) override { return memory.console_read(); }
+    void write(Memory&, uint16_t, uint8_t) override {}
+};
+
+// FLUSH: any write pushes buffered console output to the host
+class ConsoleFlushDevice : public Device {
+public:
+    uint8_t read(const Memory&, uint16_t) override { return 0; }
+    void write(Memory& memory, uint16_t, uint8_t) override { memory.console_flush(); }
+};
+
+// STATUS: bit 0 = output ready, kept in backing RAM (1 in the power-on
+// image) so each machine has its own copy; bit 1 = input waiting, bit 2 =
+// input closed, from the input source
+class ConsoleStatusDevice : public Device {
+public:
+    uint8_t read(const Memory& memory, uint16_t address) override {
+        uint8_t input_bits = ConsoleInput::STATUS_DATA | ConsoleInput::STATUS_CLOSED;
+        return static_cast<uint8_t>((memory.read_backing(address) & ~input_bits) | memory.input_status());
+    }
+    void write(Memory& memory, uint16_t address, uint8_t value) override { memory.write_backing(address, value); }
+};
+
+inline const Memory::DeviceMapPtr& Memory::console_devices() {
+    static ConsoleOutputDevice output;
+    static ConsoleInputDevice input;
+    static ConsoleStatusDevice status;
+    static ConsoleFlushDevice flush;
+    static const DeviceMapPtr map = [] {
+        auto console = std::make_shared<DeviceMap>();
+        console->mappings.push_back({IO_STDOUT, IO_STDOUT, &output});
+        console->mappings.push_back({IO_STDIN, IO_STDIN, &input});
+        console->mappings.push_back({IO_STATUS, IO_STATUS, &status});
+        console->mappings.push_back({IO_FLUSH, IO_FLUSH, &flush});
+        console->pages[IO_BASE >> 8] = true;
+        return DeviceMapPtr(std::move(console));
+    }();
+    return map;
+}
+
 } // namespace cpu
 
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "memory.hpp"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace cpu {
+
+// Bank-switching MMU
+// The address space is cut into windows of 4KB or 16KB. Every window except
+// the last (which holds the I/O page) has a 16-bit select register in the
+// I/O page: 0 shows the window's own RAM, n opens bank n-1 of a host-backed
+// physical store of up to 64MB. Selecting a bank only rewrites the window's
+// 16 or 64 page-table entries, so RAM accesses take the same path whether a
+// window is banked or not. The select registers live in the machine's
+// backing RAM like STATUS. The store is kept one bank per buffer: copies
+// and snapshots share the buffers, and a shared bank is cloned when it is
+// next selected, so only the machine that has a bank open writes to it.
+class Mmu : public Device {
+public:
+    static constexpr uint16_t REGISTER_BASE = 0xFF10;
+    static constexpr size_t MAX_STORE = size_t(64) << 20;
+    
+    // Bank buffers (nullptr = never selected, all zero)
+    using Bank = std::shared_ptr<std::vector<uint8_t>>;
+    using Store = std::vector<Bank>;
+
+private:
+    size_t window_size;
+    size_t window_pages;
+    size_t windows;   // Bankable windows (all but the I/O window)
+    size_t banks;
+    Store store;
+    uint64_t selects = 0;
+
+    uint16_t select_value(const Memory& memory, size_t window) const {
+        uint16_t address = register_address(window);
+        return static_cast<uint16_t>(memory.read_backing(address) | (memory.read_backing(address + 1) << 8));
+    }
+
+    // Bank n-1 for select value n, made private to this MMU first
+    uint8_t* open_bank(uint16_t value) {
+        if (value < 1 || value > banks) return nullptr;
+        Bank& bank = store[value - 1];
+        if (!bank) {
+            bank = std::make_shared<std::vector<uint8_t>>(window_size, 0);
+        } else if (bank.use_count() > 1) {
+            bank = std::make_shared<std::vector<uint8_t>>(*bank);
+        }
+        return bank->data();
+    }
+    
+    void apply(Memory& memory, size_t window, uint16_t value) {
+        memory.map_window(window * window_pages, window_pages, open_bank(value));
+        selects++;
+    }
+
+public:
+    // Throws std::invalid_argument unless window_bytes is 4KB or 16KB and
+    // store_bytes is a whole number of windows no larger than MAX_STORE
+    Mmu(size_t window_bytes, size_t store_bytes) : window_size(window_bytes) {
+        if (window_bytes != 4096 && window_bytes != 16384) {
+            throw std::invalid_argument("MMU window must be 4KB or 16KB");
+        }
+        if (store_bytes == 0 || store_bytes > MAX_STORE || store_bytes % window_bytes != 0) {
+            throw std::invalid_argument("MMU store must be a multiple of the window size, up to 64MB");
+        }
+        window_pages = window_size / Memory::PAGE_SIZE;
+        windows = Memory::MEMORY_SIZE / window_size - 1;
+        banks = store_bytes / window_size;
+        store.resize(banks);
+    }
+
+    // The copy shares every bank until one side selects it again; remap the
+    // copy onto its machine before either one runs
+    Mmu(const Mmu&) = default;
+    Mmu& operator=(const Mmu&) = delete;
+
+    uint16_t register_address(size_t window) const {
+        return static_cast<uint16_t>(REGISTER_BASE + 2 * window);
+    }
+
+    uint16_t last_register() const {
+        return static_cast<uint16_t>(register_address(windows) - 1);
+    }
+
+    size_t get_window_size() const { return window_size; }
+    size_t get_windows() const { return windows; }
+    size_t get_banks() const { return banks; }
+    size_t store_bytes() const { return banks * window_size; }
+    uint64_t get_selects() const { return selects; }
+
+    uint8_t read(const Memory& memory, uint16_t address) override {
+        return memory.read_backing(address);
+    }
+
+    // A word store reaches the low byte first, so the window briefly shows
+    // the bank with the old high byte; only the final selection matters
+    void write(Memory& memory, uint16_t address, uint8_t value) override {
+        memory.write_backing(address, value);
+        size_t window = (address - REGISTER_BASE) / 2;
+        apply(memory, window, select_value(memory, window));
+    }
+
+    // Re-apply every window's selection, e.g. after memory was replaced.
+    // With registers (a full 64KB image about to be restored) the windows
+    // are set from that image instead of from the current registers.
+    void remap(Memory& memory, const uint8_t* registers = nullptr) {
+        for (size_t window = 0; window < windows; window++) {
+            uint16_t address = register_address(window);
+            uint16_t value = registers ? static_cast<uint16_t>(registers[address] | (registers[address + 1] << 8))
+                                       : select_value(memory, window);
+            apply(memory, window, value);
+        }
+    }
+
+    // Every bank's contents as of now, sharing the buffers. Banks open in
+    // memory's windows are still being written, so those are copied.
+    Store save_store(const Memory& memory) const {
+        Store saved = store;
+        for (size_t window = 0; window < windows; window++) {
+            uint16_t value = select_value(memory, window);
+            if (value >= 1 && value <= banks && saved[value - 1] == store[value - 1] && store[value - 1]) {
+                saved[value - 1] = std::make_shared<std::vector<uint8_t>>(*store[value - 1]);
+            }
+        }
+        return saved;
+    }
+    
+    // Put back a save_store result and re-apply the windows as remap does.
+    // A store saved from a different geometry is ignored.
+    void restore_store(Memory& memory, const Store& saved, const uint8_t* registers = nullptr) {
+        if (saved.size() != banks) {
+            remap(memory, registers);
+            return;
+        }
+        Store current = std::move(store);  // Keeps open banks alive until the windows move
+        store = saved;
+        remap(memory, registers);
+    }
+    
+    void print_stats(const Memory& memory) const {
+        std::cout << "MMU: " << banks << " banks of " << (window_size >> 10) << "KB (" << (store_bytes() >> 10)
+                  << "KB store), " << windows << " windows at 0x" << std::hex << register_address(0) << "-0x"
+                  << last_register() << std::dec << ", " << selects << " selects, " << memory.get_bank_switches()
+                  << " page-table remaps; selected:";
+        for (size_t window = 0; window < windows; window++) {
+            uint16_t value = select_value(memory, window);
+            if (value) std::cout << " " << window << "=" << value;
+        }
+        std::cout << std::endl;
+    }
+};
+
+} // namespace cpu
@@ -0,0 +1,332 @@
+#pragma once
+
+#include "isa.hpp"
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+
+namespace cpu {
+
+// Five-stage pipeline timing model (IF ID EX MEM WB)
+// Runs beside the functional engine: the switch interpreter hands it each
+// retired instruction while a model is attached to the control unit, and it
+// works out when that instruction would have entered EX on an in-order,
+// single-issue pipeline. Nothing is simulated per stage; each instruction
+// costs a few max() operations against the cycle at which its sources become
+// ready and the cycle at which EX, MEM and the fetch stream are free again.
+//
+// The first instruction enters EX in cycle 2 and retires after WB in cycle
+// 4, so one instruction takes 5 cycles and a hazard-free stream adds one
+// cycle per instruction. Instructions are delayed by:
+//   control     a jump is resolved at the end of EX; if the fetch stream
+//               went the wrong way the wrong-path fetches are flushed and
+//               the right instruction enters EX branch cycles later than it
+//               would have. A JMP misses unless a BTB supplies its target,
+//               and a taken JZ/JNZ misses without a branch predictor (static
+//               not-taken). An interrupt, RTI, WFI wake-up or restore
+//               refetches the same way
+//   structural  EX is not pipelined, so an opcode with EX latency n holds
+//               the next instruction back n - 1 cycles
+//   memory      LD and ST hold MEM for the memory latency (or the D-cache
+//               latency when caches are attached)
+//   fetch       an I-cache access slower than one cycle holds IF
+//   load-use    a source register written by a LD that has not left MEM
+//   data        any other source (register or flags) not yet written
+// With forwarding an ALU result is usable by the next instruction's EX and
+// a loaded value one cycle after MEM; without it a value is read from the
+// register file the cycle after WB. A store needs its data register only
+// when it reaches MEM.
+class PipelineModel {
+public:
+    enum class Stall : uint8_t { LOAD_USE, DATA, STRUCTURAL, MEMORY, FETCH, CONTROL };
+    static constexpr int STALL_KINDS = 6;
+    static constexpr unsigned MAX_LATENCY = 64;
+
+    struct Config {
+        bool forwarding = true;
+        unsigned branch_penalty = 2;     // Cycles lost to a flush
+        unsigned memory_latency = 1;     // Cycles LD/ST spend in MEM
+        std::array<unsigned, 16> execute_latency;
+
+        Config() { execute_latency.fill(1); }
+    };
+
+    struct StallCount {
+        uint64_t cycles = 0;
+        uint64_t events = 0;     // Instructions delayed for this reason
+    };
+
+    static const char* stall_name(Stall kind) {
+        static const char* const NAMES[STALL_KINDS] = {"load-use", "data", "structural", "memory", "fetch",
+                                                             "control"};
+        return NAMES[static_cast<int>(kind)];
+    }
+
+    // Comma-separated settings on top of the defaults, e.g.
+    // "forward=off,branch=3,mem=2,LD=2"; an opcode name sets its EX latency.
+    // Throws std::invalid_argument on an unknown key or a bad value.
+    static Config parse_config(const std::string& spec) {
+        Config config;
+        std::stringstream items(spec);
+        std::string item;
+        while (std::getline(items, item, ',')) {
+            if (item.empty()) continue;
+            size_t eq = item.find('=');
+            if (eq == std::string::npos) throw std::invalid_argument("Expected key=value in pipeline spec: " + item);
+            std::string key = item.substr(0, eq);
+            std::string value = item.substr(eq + 1);
+            for (char& c : key) c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            if (key == "FORWARD") {
+                if (value == "on") {
+                    config.forwarding = true;
+                } else if (value == "off") {
+                    config.forwarding = false;
+                } else {
+                    throw std::invalid_argument("forward must be on or off: " + value);
+                }
+            } else if (key == "BRANCH") {
+                config.branch_penalty = parse_cycles(item, value, 0);
+            } else if (key == "MEM") {
+                config.memory_latency = parse_cycles(item, value, 1);
+            } else {
+                int op = 0;
+                while (op < 16 && key != opcode_name(static_cast<Opcode>(op))) op++;
+                if (op == 16) throw std::invalid_argument("Unknown pipeline setting: " + item);
+                config.execute_latency[op] = parse_cycles(item, value, 1);
+            }
+        }
+        return config;
+    }
+
+private:
+    // Operand use per opcode; register 8 stands for the flags
+    static constexpr uint8_t READS_RS1 = 1;
+    static constexpr uint8_t READS_RS2 = 2;      // Unless the immediate form
+    static constexpr uint8_t READS_RD = 4;       // Store data, needed at MEM
+    static constexpr uint8_t READS_FLAGS = 8;
+    static constexpr uint8_t WRITES_RD = 16;
+    static constexpr uint8_t WRITES_FLAGS = 32;
+    static constexpr uint8_t MEMORY_OP = 64;
+    static constexpr uint8_t BRANCH = 128;
+    static constexpr int FLAGS = 8;
+    static constexpr uint8_t ALU_OP = READS_RS1 | READS_RS2 | WRITES_RD | WRITES_FLAGS;
+    static constexpr uint8_t USES[16] = {
+        0,                                                   // NOP
+        ALU_OP, ALU_OP, ALU_OP, ALU_OP, ALU_OP,              // ADD SUB AND OR XOR
+        READS_RS1 | WRITES_RD | WRITES_FLAGS,                // NOT
+        READS_RS1 | WRITES_RD | WRITES_FLAGS,                // SHL
+        READS_RS1 | WRITES_RD | WRITES_FLAGS,                // SHR
+        READS_RS1 | WRITES_RD | MEMORY_OP,                   // LD
+        READS_RS1 | READS_RD | MEMORY_OP,                    // ST
+        WRITES_RD,                                           // LDI
+        READS_RS1 | BRANCH,                                  // JMP
+        READS_RS1 | READS_FLAGS | BRANCH,                    // JZ
+        READS_RS1 | READS_FLAGS | BRANCH,                    // JNZ
+        0                                                    // HLT
+    };
+
+    Config config;
+
+    // Timing state, all in cycles
+    uint64_t last_ex = 1;            // EX start of the previous instruction
+    uint64_t ex_free = 0;            // EX unit free from
+    uint64_t mem_free = 0;           // MEM stage free from
+    uint64_t front_ready = 0;        // Earliest EX start after a flush
+    uint64_t finish = 0;             // Cycle after the last WB
+    std::array<uint64_t, 9> ready{}; // Register (and flags) usable at EX from
+    std::array<bool, 9> from_load{};
+
+    uint64_t instructions = 0;
+    uint64_t branches = 0;           // JZ/JNZ
+    uint64_t taken = 0;
+    uint64_t mispredicts = 0;
+    uint64_t jumps = 0;              // JMP, counted apart
+    uint64_t jump_mispredicts = 0;
+    uint64_t redirects = 0;
+    std::array<StallCount, STALL_KINDS> stalls{};
+    std::string prediction = "static";    // Name of the predictor feeding step()
+    bool cached = false;                  // Caches pass fetch and data cycles to step()
+
+    static unsigned parse_cycles(const std::string& item, const std::string& value, unsigned low) {
+        size_t used = 0;
+        unsigned long cycles = 0;
+        try {
+            cycles = std::stoul(value, &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used == 0 || used != value.size() || cycles < low || cycles > MAX_LATENCY) {
+            throw std::invalid_argument("Bad cycle count in pipeline spec (" + std::to_string(low) + "-" +
+                                        std::to_string(MAX_LATENCY) + "): " + item);
+        }
+        return static_cast<unsigned>(cycles);
+    }
+
+    // Push start up to at least cycle, charging the difference to kind
+    void delay(uint64_t& start, uint64_t cycle, Stall kind) {
+        if (cycle <= start) return;
+        StallCount& count = stalls[static_cast<int>(kind)];
+        count.cycles += cycle - start;
+        count.events++;
+        start = cycle;
+    }
+
+    void wait_for(uint64_t& start, int reg, unsigned offset) {
+        uint64_t cycle = ready[reg] > offset ? ready[reg] - offset : 0;
+        delay(start, cycle, from_load[reg] ? Stall::LOAD_USE : Stall::DATA);
+    }
+
+public:
+    PipelineModel() = default;
+    explicit PipelineModel(const Config& settings) : config(settings) {}
+
+    // Replaces the settings and clears the counts
+    void configure(const Config& settings) {
+        config = settings;
+        clear();
+    }
+
+    const Config& get_config() const { return config; }
+
+    // Which predictor decides mispredicted in step(), for the report
+    void set_prediction(const std::string& name) { prediction = name; }
+
+    // Whether caches supply the memory timing, for the report
+    void set_cached(bool caches) { cached = caches; }
+
+    // One retired instruction; jumped is true for a taken jump and
+    // mispredicted when the fetch stream went the wrong way past it. Caches
+    // pass the cycles its fetch and data access took; data_cycles 0 means
+    // the configured memory latency.
+    void step(const Instruction& instr, bool jumped, bool mispredicted, unsigned fetch_cycles = 1,
+              unsigned data_cycles = 0) {
+        const int op = static_cast<int>(instr.opcode);
+        const uint8_t uses = USES[op];
+        const unsigned latency = config.execute_latency[op];
+        const unsigned mem_cycles = !(uses & MEMORY_OP) ? 1 : data_cycles ? data_cycles : config.memory_latency;
+
+        uint64_t start = last_ex + 1;
+        delay(start, front_ready, Stall::CONTROL);
+        delay(start, std::max(last_ex + 1, front_ready) + fetch_cycles - 1, Stall::FETCH);
+        delay(start, ex_free, Stall::STRUCTURAL);
+        delay(start, mem_free > latency ? mem_free - latency : 0, Stall::MEMORY);
+        if (uses & READS_RS1) wait_for(start, instr.rs1, 0);
+        if ((uses & READS_RS2) && !instr.is_immediate) wait_for(start, instr.rs2, 0);
+        if (uses & READS_RD) wait_for(start, instr.rd, latency);
+        if (uses & READS_FLAGS) wait_for(start, FLAGS, 0);
+
+        const uint64_t ex_end = start + latency;
+        const uint64_t wb = ex_end + mem_cycles;
+        last_ex = start;
+        ex_free = ex_end;
+        mem_free = wb;
+        finish = wb + 1;
+
+        if (uses & (WRITES_RD | WRITES_FLAGS)) {
+            const bool load = (uses & MEMORY_OP) != 0;
+            const uint64_t usable = !config.forwarding ? wb + 1 : load ? wb : ex_end;
+            if (uses & WRITES_RD) {
+                ready[instr.rd] = usable;
+                from_load[instr.rd] = load;
+            }
+            if (uses & WRITES_FLAGS) {
+                ready[FLAGS] = usable;
+                from_load[FLAGS] = false;
+            }
+        }
+
+        if (uses & BRANCH) {
+            if (instr.opcode == Opcode::JMP) {
+                jumps++;
+                if (mispredicted) jump_mispredicts++;
+            } else {
+                branches++;
+                if (jumped) taken++;
+                if (mispredicted) mispredicts++;
+            }
+            if (mispredicted) front_ready = ex_end + config.branch_penalty;
+        }
+        instructions++;
+    }
+
+    // Execution continues somewhere the fetch stream could not know about
+    // (interrupt entry, RTI, WFI wake-up, a restore): refetch like a flush
+    void redirect() {
+        if (instructions == 0) return;
+        redirects++;
+        front_ready = std::max(front_ready, ex_free + config.branch_penalty);
+    }
+
+    void clear() {
+        last_ex = 1;
+        ex_free = mem_free = front_ready = finish = 0;
+        ready.fill(0);
+        from_load.fill(false);
+        instructions = branches = taken = mispredicts = jumps = jump_mispredicts = redirects = 0;
+        stalls.fill(StallCount{});
+    }
+
+    uint64_t get_instructions() const { return instructions; }
+    uint64_t get_cycles() const { return finish; }
+    uint64_t get_branches() const { return branches; }
+    uint64_t get_taken() const { return taken; }
+    uint64_t get_mispredicts() const { return mispredicts; }
+    uint64_t get_jumps() const { return jumps; }
+    uint64_t get_jump_mispredicts() const { return jump_mispredicts; }
+    uint64_t get_redirects() const { return redirects; }
+    const StallCount& get_stalls(Stall kind) const { return stalls[static_cast<int>(kind)]; }
+
+    uint64_t get_stall_cycles() const {
+        uint64_t total = 0;
+        for (const StallCount& count : stalls) total += count.cycles;
+        return total;
+    }
+
+    // "forwarding on, branch penalty 2, memory latency 1" plus any EX
+    // latency other than 1 and the predictor
+    std::string describe() const {
+        std::string text = std::string("forwarding ") + (config.forwarding ? "on" : "off") + ", branch penalty " +
+                           std::to_string(config.branch_penalty) + ", memory latency " +
+                           (cached ? "from caches" : std::to_string(config.memory_latency));
+        for (int op = 0; op < 16; op++) {
+            if (config.execute_latency[op] == 1) continue;
+            text += std::string(", ") + opcode_name(static_cast<Opcode>(op)) + " " +
+                    std::to_string(config.execute_latency[op]);
+        }
+        return text + ", predictor " + prediction;
+    }
+
+    // CPI, the stall breakdown and jump outcomes
+    void print_report() const {
+        std::cout << "\n=== Pipeline Timing ===" << std::endl;
+        std::cout << "Model: " << describe() << std::endl;
+        std::cout << "Instructions: " << instructions << std::endl;
+        std::cout << "Cycles: " << finish << std::endl;
+        if (instructions == 0) return;
+        const double cycles = static_cast<double>(finish);
+        std::cout << std::fixed << std::setprecision(3) << std::setfill(' ');
+        std::cout << "CPI: " << cycles / static_cast<double>(instructions)
+                  << " (IPC " << static_cast<double>(instructions) / cycles << ")" << std::endl;
+        std::cout << std::setprecision(1);
+        std::cout << "Stall cycles: " << get_stall_cycles() << " (" << 100.0 * get_stall_cycles() / cycles
+                  << "% of cycles), pipeline fill 4" << std::endl;
+        std::cout << "  cause        " << std::setw(14) << "cycles" << std::setw(14) << "events" << std::endl;
+        for (int kind = 0; kind < STALL_KINDS; kind++) {
+            std::cout << "  " << std::left << std::setw(11) << stall_name(static_cast<Stall>(kind)) << std::right
+                      << std::setw(16) << stalls[kind].cycles << std::setw(14) << stalls[kind].events << std::endl;
+        }
+        std::cout << "Jumps: JZ/JNZ " << branches << ", taken " << taken << ", mispredicted " << mispredicts;
+        if (branches > 0) std::cout << " (" << 100.0 * mispredicts / branches << "%)";
+        std::cout << "; JMP " << jumps << ", mispredicted " << jump_mispredicts << std::endl;
+        std::cout << "Redirects (interrupts, RTI, WFI, restores): " << redirects << std::endl;
+        std::cout << std::defaultfloat;
+    }
+};
+
+} // namespace cpu
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "isa.hpp"
+#include "memory.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace cpu {
+
+// Execution profile
+// Flat counters indexed by PC and opcode, bumped once per instruction by the
+// switch interpreter while a profiler is attached to the control unit. The
+// hot path is three array increments and no lookups; labels and source
+// lines are matched up only when a report is built (see ProfileReport).
+class Profiler {
+private:
+    std::vector<uint64_t> executions;    // By PC
+    std::vector<uint64_t> taken;         // Jumps by PC
+    std::vector<uint64_t> not_taken;
+    std::array<uint64_t, 16> opcodes{};
+    uint64_t total = 0;
+
+public:
+    Profiler()
+        : executions(Memory::MEMORY_SIZE, 0), taken(Memory::MEMORY_SIZE, 0), not_taken(Memory::MEMORY_SIZE, 0) {}
+
+    static bool is_branch(Opcode op) {
+        return op == Opcode::JMP || op == Opcode::JZ || op == Opcode::JNZ;
+    }
+
+    void count(uint16_t pc, Opcode op, bool jumped) {
+        executions[pc]++;
+        opcodes[static_cast<uint8_t>(op)]++;
+        total++;
+        if (is_branch(op)) (jumped ? taken : not_taken)[pc]++;
+    }
+
+    void clear() {
+        std::fill(executions.begin(), executions.end(), 0);
+        std::fill(taken.begin(), taken.end(), 0);
+        std::fill(not_taken.begin(), not_taken.end(), 0);
+        opcodes.fill(0);
+        total = 0;
+    }
+
+    uint64_t get_total() const { return total; }
+    uint64_t get_executions(uint16_t pc) const { return executions[pc]; }
+    uint64_t get_taken(uint16_t pc) const { return taken[pc]; }
+    uint64_t get_not_taken(uint16_t pc) const { return not_taken[pc]; }
+    uint64_t get_opcode(Opcode op) const { return opcodes[static_cast<uint8_t>(op)]; }
+};
+
+} // namespace cpu
@@ -8,42 +8,16 @@ namespace cpu {
 
 // General Purpose Registers (8 registers)
 struct GPRs {
-    int16_t r0 = 0;
-    int16_t r1 = 0;
-    int16_t r2 = 0;
-    int16_t r3 = 0;
-    int16_t r4 = 0;
-    int16_t r5 = 0;
-    int16_t r6 = 0;
-    int16_t r7 = 0;
+    // R0-R7, stored as an array so indexed access is a single load
+    int16_t r[8] = {};
 
     // Access register by index (0-7)
     int16_t& operator[](int index) {
-        switch(index) {
-            case 0: return r0;
-            case 1: return r1;
-            case 2: return r2;
-            case 3: return r3;
-            case 4: return r4;
-            case 5: return r5;
-            case 6: return r6;
-            case 7: return r7;
-            default: return r0;
-        }
+        return r[index & 7];
     }
 
     const int16_t& operator[](int index) const {
-        switch(index) {
-            case 0: return r0;
-            case 1: return r1;
-            case 2: return r2;
-            case 3: return r3;
-            case 4: return r4;
-            case 5: return r5;
-            case 6: return r6;
-            case 7: return r7;
-            default: return r0;
-        }
+        return r[index & 7];
     }
 
     void print() const {
@@ -68,7 +42,56 @@ struct SPRs {
         bool C = false;  // Carry flag
         bool V = false;  // Overflow flag
         
+        // Lazy evaluation: the last ADD/SUB or logic op is recorded instead of
+        // its flags, which are computed only when read (see resolve)
+        enum class Pending : uint8_t { NONE, ADD, LOGIC };
+        Pending pending = Pending::NONE;
+        int16_t lazy_a = 0;       // ADD operands (SUB is recorded as a + -b)
+        int16_t lazy_b = 0;
+        int16_t lazy_result = 0;
+        
+        void defer_add(int16_t a, int16_t b, int16_t result) {
+            pending = Pending::ADD;
+            lazy_a = a;
+            lazy_b = b;
+            lazy_result = result;
+        }
+        
+        void defer_logic(int16_t result) {
+            pending = Pending::LOGIC;
+            lazy_result = result;
+        }
+        
+        // Z without materializing the other flags (for branches)
+        bool zero() const {
+            return pending == Pending::NONE ? Z : lazy_result == 0;
+        }
+        
+        // Materialize Z/N/C/V from the recorded operation
+        void resolve() {
+            if (pending == Pending::NONE) return;
+            Z = (lazy_result == 0);
+            N = (lazy_result < 0);
+            if (pending == Pending::ADD) {
+                int32_t sum = static_cast<int32_t>(lazy_a) + static_cast<int32_t>(lazy_b);
+                C = (sum > 32767) || (sum < -32768);
+                V = (lazy_a > 0 && lazy_b > 0 && lazy_result < 0) ||
+                    (lazy_a < 0 && lazy_b < 0 && lazy_result > 0);
+            } else {
+                C = false;
+                V = false;
+            }
+            pending = Pending::NONE;
+        }
+        
+        Flags resolved() const {
+            Flags flags = *this;
+            flags.resolve();
+            return flags;
+        }
+        
         uint8_t to_byte() const {
+            if (pending != Pending::NONE) return resolved().to_byte();
             return (Z ? 0x01 : 0) | (N ? 0x02 : 0) | (C ? 0x04 : 0) | (V ? 0x08 : 0);
         }
         
@@ -77,6 +100,7 @@ struct SPRs {
             N = (byte & 0x02) != 0;
             C = (byte & 0x04) != 0;
             V = (byte & 0x08) != 0;
+            pending = Pending::NONE;
         }
     } flags;
 
@@ -84,8 +108,9 @@ struct SPRs {
         std::cout << "=== Special Purpose Registers ===" << std::endl;
         std::cout << "PC:  0x" << std::hex << std::setw(4) << std::setfill('0') << PC << std::endl;
         std::cout << "SP:  0x" << std::hex << std::setw(4) << std::setfill('0') << SP << std::endl;
-        std::cout << "FLAGS: Z=" << flags.Z << " N=" << flags.N 
-                  << " C=" << flags.C << " V=" << flags.V << std::endl;
+        const Flags current = flags.resolved();
+        std::cout << "FLAGS: Z=" << current.Z << " N=" << current.N 
+                  << " C=" << current.C << " V=" << current.V << std::endl;
         std::cout << std::dec;
     }
 };
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+namespace cpu {
+
+// Lock-free single-producer / single-consumer byte ring
+// Each side caches the other side's index and only reloads it when the
+// cached value says the ring is empty (consumer) or full (producer), so the
+// shared cache lines are touched about once per batch rather than per byte.
+class SpscRing {
+private:
+    std::vector<uint8_t> buffer;
+    size_t mask = 0;
+    alignas(64) std::atomic<uint64_t> head{0};  // Written by the producer
+    uint64_t cached_tail = 0;                   // Producer's view of tail
+    alignas(64) std::atomic<uint64_t> tail{0};  // Written by the consumer
+    uint64_t cached_head = 0;                   // Consumer's view of head
+
+public:
+    explicit SpscRing(size_t capacity = 1 << 16) {
+        size_t size = 16;
+        while (size < capacity) size <<= 1;
+        buffer.assign(size, 0);
+        mask = size - 1;
+    }
+
+    size_t capacity() const { return buffer.size(); }
+
+    // Producer: up to two free spans, in order; returns how many are non-empty
+    int free_spans(uint8_t* spans[2], size_t lengths[2]) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h - cached_tail == buffer.size()) cached_tail = tail.load(std::memory_order_acquire);
+        size_t space = buffer.size() - static_cast<size_t>(h - cached_tail);
+        if (space == 0) return 0;
+        size_t start = h & mask;
+        lengths[0] = std::min(space, buffer.size() - start);
+        spans[0] = &buffer[start];
+        lengths[1] = space - lengths[0];
+        spans[1] = buffer.data();
+        return lengths[1] ? 2 : 1;
+    }
+
+    // Producer: publish count bytes written into the free spans
+    void commit(size_t count) {
+        head.store(head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Consumer: take one byte if any is available
+    bool pop(uint8_t& byte) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t == cached_head) {
+            cached_head = head.load(std::memory_order_acquire);
+            if (t == cached_head) return false;
+        }
+        byte = buffer[t & mask];
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: up to two filled spans, in order; returns how many are non-empty
+    int filled_spans(const uint8_t* spans[2], size_t lengths[2]) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t == cached_head) cached_head = head.load(std::memory_order_acquire);
+        size_t filled = static_cast<size_t>(cached_head - t);
+        if (filled == 0) return 0;
+        size_t start = t & mask;
+        lengths[0] = std::min(filled, buffer.size() - start);
+        spans[0] = &buffer[start];
+        lengths[1] = filled - lengths[0];
+        spans[1] = buffer.data();
+        return lengths[1] ? 2 : 1;
+    }
+
+    // Consumer: hand count bytes taken from the filled spans back to the producer
+    void release(size_t count) {
+        tail.store(tail.load(std::memory_order_relaxed) + count, std::memory_order_release);
+    }
+
+    // Consumer: whether pop would fail right now
+    bool empty() {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t != cached_head) return false;
+        cached_head = head.load(std::memory_order_acquire);
+        return t == cached_head;
+    }
+
+    // Only while neither side is running
+    void reset() {
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+        cached_head = cached_tail = 0;
+    }
+};
+
+} // namespace cpu
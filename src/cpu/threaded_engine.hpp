@@ -0,0 +1,378 @@
+#pragma once
+
+#include "isa.hpp"
+#include "registers.hpp"
+#include "alu.hpp"
+#include "memory.hpp"
+#include "compiler.hpp"
+#include <cstdint>
+#include <vector>
+
+// Direct-threaded dispatch needs labels-as-values (GCC/Clang). Other compilers,
+// or builds with -DCPU_NO_COMPUTED_GOTO, use the call-threaded fallback.
+#if defined(__GNUC__) && !defined(CPU_NO_COMPUTED_GOTO)
+#define CPU_COMPUTED_GOTO 1
+#else
+#define CPU_COMPUTED_GOTO 0
+#endif
+
+namespace cpu {
+
+// Threaded-code interpreter
+// Each even PC below the I/O page owns one pre-translated op whose handler is
+// specialized for the opcode and operand form, so dispatch is a single
+// indirect jump from one handler to the next instead of a nested switch.
+class ThreadedEngine {
+public:
+    // Handler identifiers, one per opcode/operand form
+    enum Handler : uint8_t {
+        TRANSLATE,   // Slot not translated yet (or invalidated)
+        EXIT,        // Sentinel past the last cacheable slot
+        NOP,
+        ADD_RR, SUB_RR, AND_RR, OR_RR, XOR_RR,
+        NOT_R,
+        SHL_RI, SHR_RI,
+        SHIFT_ZERO,  // Shift amount outside 0-15 always yields 0
+        LD_RI, ST_RI,
+        LDI_I,
+        JMP_RI, JZ_RI, JNZ_RI,
+        HLT,
+        HANDLER_COUNT
+    };
+
+    struct Op {
+        const void* target = nullptr;  // Handler label (computed goto builds)
+        uint8_t handler = TRANSLATE;
+        uint8_t rd = 0;
+        uint8_t rs1 = 0;
+        uint8_t rs2 = 0;
+        int8_t imm = 0;
+    };
+
+    static constexpr size_t SLOT_COUNT = 0xFF00 / 2;
+
+    static bool cacheable(uint16_t pc) {
+        return (pc & 1) == 0 && pc < 0xFF00;
+    }
+
+private:
+    // Machine state seen by the handlers for the duration of one run
+    struct Context {
+        ThreadedEngine& engine;
+        Memory& memory;
+        GPRs& gprs;
+        SPRs& sprs;
+        Memory::CodeWatcher* watcher;
+        uint16_t exit_pc;
+        bool halted;
+        uint64_t first_cycle;  // Cycle count when the run started
+        uint64_t executed;     // Instructions finished so far
+    };
+
+    using HandlerFn = Op* (*)(Context&, Op*);
+
+    std::vector<Op> ops;              // SLOT_COUNT slots plus the EXIT sentinel
+    const void* translate_target = nullptr;
+    uint64_t translations = 0;
+
+    uint16_t pc_of(const Op* op) const {
+        return static_cast<uint16_t>((op - ops.data()) * 2);
+    }
+
+    // Next op after a control transfer, or nullptr if the target cannot be threaded
+    static CPU_ALWAYS_INLINE Op* branch_to(Context& c, uint16_t target) {
+        if (!cacheable(target)) {
+            c.exit_pc = target;
+            return nullptr;
+        }
+        return &c.engine.ops[target >> 1];
+    }
+
+    static CPU_ALWAYS_INLINE uint16_t jump_target(const Context& c, const Op* op) {
+        uint16_t base = (c.gprs[op->rs1] == 0) ? static_cast<uint16_t>(c.engine.pc_of(op) + 2)
+                                               : static_cast<uint16_t>(c.gprs[op->rs1]);
+        return static_cast<uint16_t>(base + static_cast<int16_t>(op->imm));
+    }
+
+    static CPU_ALWAYS_INLINE void set_flags(SPRs& sprs, const ALUResult& result) {
+        sprs.flags.Z = result.zero;
+        sprs.flags.N = result.negative;
+        sprs.flags.C = result.carry;
+        sprs.flags.V = result.overflow;
+    }
+
+    // Decode the word at the slot's PC and pick its specialized handler
+    static CPU_NOINLINE Op* h_translate(Context& c, Op* op) {
+        uint16_t pc = c.engine.pc_of(op);
+        c.memory.watch_code(pc, c.watcher);
+        Instruction instr = Instruction::decode(c.memory.read_word(pc));
+        op->rd = instr.rd;
+        op->rs1 = instr.rs1;
+        op->rs2 = instr.rs2;
+        op->imm = instr.imm;
+        switch (instr.opcode) {
+            case Opcode::NOP: op->handler = NOP; break;
+            case Opcode::ADD: op->handler = ADD_RR; break;
+            case Opcode::SUB: op->handler = SUB_RR; break;
+            case Opcode::AND: op->handler = AND_RR; break;
+            case Opcode::OR:  op->handler = OR_RR; break;
+            case Opcode::XOR: op->handler = XOR_RR; break;
+            case Opcode::NOT: op->handler = NOT_R; break;
+            case Opcode::SHL:
+                op->handler = (instr.imm < 0 || instr.imm > 15) ? SHIFT_ZERO : SHL_RI;
+                break;
+            case Opcode::SHR:
+                op->handler = (instr.imm < 0 || instr.imm > 15) ? SHIFT_ZERO : SHR_RI;
+                break;
+            case Opcode::LD:  op->handler = LD_RI; break;
+            case Opcode::ST:  op->handler = ST_RI; break;
+            case Opcode::LDI: op->handler = LDI_I; break;
+            case Opcode::JMP: op->handler = JMP_RI; break;
+            case Opcode::JZ:  op->handler = JZ_RI; break;
+            case Opcode::JNZ: op->handler = JNZ_RI; break;
+            case Opcode::HLT: op->handler = HLT; break;
+        }
+        c.engine.translations++;
+        return op;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_exit(Context& c, Op* op) {
+        c.exit_pc = c.engine.pc_of(op);
+        return nullptr;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_nop(Context&, Op* op) {
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_add_rr(Context& c, Op* op) {
+        ALUResult r = ALU::add(c.gprs[op->rs1], c.gprs[op->rs2]);
+        c.gprs[op->rd] = r.output;
+        set_flags(c.sprs, r);
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_sub_rr(Context& c, Op* op) {
+        ALUResult r = ALU::subtract(c.gprs[op->rs1], c.gprs[op->rs2]);
+        c.gprs[op->rd] = r.output;
+        set_flags(c.sprs, r);
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_and_rr(Context& c, Op* op) {
+        ALUResult r = ALU::and_op(c.gprs[op->rs1], c.gprs[op->rs2]);
+        c.gprs[op->rd] = r.output;
+        set_flags(c.sprs, r);
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_or_rr(Context& c, Op* op) {
+        ALUResult r = ALU::or_op(c.gprs[op->rs1], c.gprs[op->rs2]);
+        c.gprs[op->rd] = r.output;
+        set_flags(c.sprs, r);
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_xor_rr(Context& c, Op* op) {
+        ALUResult r = ALU::xor_op(c.gprs[op->rs1], c.gprs[op->rs2]);
+        c.gprs[op->rd] = r.output;
+        set_flags(c.sprs, r);
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_not_r(Context& c, Op* op) {
+        int16_t value = ~c.gprs[op->rs1];
+        c.gprs[op->rd] = value;
+        c.sprs.flags.Z = (value == 0);
+        c.sprs.flags.N = (value < 0);
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_shl_ri(Context& c, Op* op) {
+        ALUResult r = ALU::shift_left(c.gprs[op->rs1], op->imm);
+        c.gprs[op->rd] = r.output;
+        c.sprs.flags.Z = r.zero;
+        c.sprs.flags.N = r.negative;
+        c.sprs.flags.C = r.carry;
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_shr_ri(Context& c, Op* op) {
+        ALUResult r = ALU::shift_right(c.gprs[op->rs1], op->imm);
+        c.gprs[op->rd] = r.output;
+        c.sprs.flags.Z = r.zero;
+        c.sprs.flags.N = r.negative;
+        c.sprs.flags.C = r.carry;
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_shift_zero(Context& c, Op* op) {
+        c.gprs[op->rd] = 0;
+        c.sprs.flags.Z = true;
+        c.sprs.flags.N = false;
+        c.sprs.flags.C = false;
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_ld_ri(Context& c, Op* op) {
+        uint16_t addr = static_cast<uint16_t>(c.gprs[op->rs1] + op->imm);
+        c.gprs[op->rd] = static_cast<int16_t>(c.memory.read_word(addr));
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_st_ri(Context& c, Op* op) {
+        uint16_t addr = static_cast<uint16_t>(c.gprs[op->rs1] + op->imm);
+        c.memory.write_word(addr, static_cast<uint16_t>(c.gprs[op->rd]), c.first_cycle + c.executed);
+        if (c.memory.is_slice_ended()) {
+            c.exit_pc = c.engine.pc_of(op + 1);
+            return nullptr;
+        }
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_ldi_i(Context& c, Op* op) {
+        c.gprs[op->rd] = static_cast<int16_t>(op->imm);
+        return op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_jmp_ri(Context& c, Op* op) {
+        return branch_to(c, jump_target(c, op));
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_jz_ri(Context& c, Op* op) {
+        return c.sprs.flags.Z ? branch_to(c, jump_target(c, op)) : op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_jnz_ri(Context& c, Op* op) {
+        return !c.sprs.flags.Z ? branch_to(c, jump_target(c, op)) : op + 1;
+    }
+
+    static CPU_ALWAYS_INLINE Op* h_hlt(Context& c, Op* op) {
+        c.halted = true;
+        c.exit_pc = c.engine.pc_of(op);
+        return nullptr;
+    }
+
+    void allocate(const void* const* targets) {
+        ops.assign(SLOT_COUNT + 1, Op());
+        translate_target = targets ? targets[TRANSLATE] : nullptr;
+        for (Op& op : ops) {
+            op.target = translate_target;
+        }
+        ops[SLOT_COUNT].handler = EXIT;
+        ops[SLOT_COUNT].target = targets ? targets[EXIT] : nullptr;
+    }
+
+public:
+    // Drop the translation covering a written byte (self-modifying code)
+    void invalidate(uint16_t address) {
+        if (ops.empty() || address >= 0xFF00) return;
+        Op& op = ops[address >> 1];
+        op.handler = TRANSLATE;
+        op.target = translate_target;
+    }
+
+    void clear() {
+        ops.clear();
+    }
+
+    uint64_t get_translations() const { return translations; }
+
+    // Run from sprs.PC for at most budget instructions
+    // Returns the number of instructions executed. Stops early on HLT (setting
+    // halted), after a store that ends the run slice, or when control reaches
+    // a PC that cannot be threaded (odd or in the I/O page); the caller
+    // single-steps those with the switch interpreter.
+    // cycle is the cycle count before the first instruction, the time a
+    // device sees for the stores that follow.
+    uint64_t run(Memory& memory, GPRs& gprs, SPRs& sprs, Memory::CodeWatcher* watcher,
+                 uint64_t cycle, uint64_t budget, bool& halted) {
+        if (budget == 0 || !cacheable(sprs.PC)) return 0;
+
+        Context c{*this, memory, gprs, sprs, watcher, sprs.PC, false, cycle, 0};
+
+#if CPU_COMPUTED_GOTO
+        static const void* const targets[HANDLER_COUNT] = {
+            &&do_translate, &&do_exit, &&do_nop,
+            &&do_add_rr, &&do_sub_rr, &&do_and_rr, &&do_or_rr, &&do_xor_rr,
+            &&do_not_r, &&do_shl_ri, &&do_shr_ri, &&do_shift_zero,
+            &&do_ld_ri, &&do_st_ri, &&do_ldi_i,
+            &&do_jmp_ri, &&do_jz_ri, &&do_jnz_ri, &&do_hlt
+        };
+        if (ops.empty()) allocate(targets);
+
+        Op* op = &ops[sprs.PC >> 1];
+        goto *op->target;
+
+// Count the finished instruction, then jump straight to the next handler
+#define CPU_THREADED_NEXT(handler_fn)                       \
+        op = handler_fn(c, op);                             \
+        c.executed++;                                       \
+        if (op == nullptr) goto done;                       \
+        if (c.executed == budget) { c.exit_pc = pc_of(op); goto done; } \
+        goto *op->target;
+
+    do_translate:
+        op = h_translate(c, op);
+        op->target = targets[op->handler];
+        goto *op->target;
+    do_exit:
+        h_exit(c, op);
+        goto done;
+    do_nop:        CPU_THREADED_NEXT(h_nop)
+    do_add_rr:     CPU_THREADED_NEXT(h_add_rr)
+    do_sub_rr:     CPU_THREADED_NEXT(h_sub_rr)
+    do_and_rr:     CPU_THREADED_NEXT(h_and_rr)
+    do_or_rr:      CPU_THREADED_NEXT(h_or_rr)
+    do_xor_rr:     CPU_THREADED_NEXT(h_xor_rr)
+    do_not_r:      CPU_THREADED_NEXT(h_not_r)
+    do_shl_ri:     CPU_THREADED_NEXT(h_shl_ri)
+    do_shr_ri:     CPU_THREADED_NEXT(h_shr_ri)
+    do_shift_zero: CPU_THREADED_NEXT(h_shift_zero)
+    do_ld_ri:      CPU_THREADED_NEXT(h_ld_ri)
+    do_st_ri:      CPU_THREADED_NEXT(h_st_ri)
+    do_ldi_i:      CPU_THREADED_NEXT(h_ldi_i)
+    do_jmp_ri:     CPU_THREADED_NEXT(h_jmp_ri)
+    do_jz_ri:      CPU_THREADED_NEXT(h_jz_ri)
+    do_jnz_ri:     CPU_THREADED_NEXT(h_jnz_ri)
+    do_hlt:        CPU_THREADED_NEXT(h_hlt)
+
+#undef CPU_THREADED_NEXT
+#else
+        // Call-threaded fallback: each handler returns the next op and a
+        // trampoline calls it, standing in for guaranteed tail calls
+        static const HandlerFn handlers[HANDLER_COUNT] = {
+            h_translate, h_exit, h_nop,
+            h_add_rr, h_sub_rr, h_and_rr, h_or_rr, h_xor_rr,
+            h_not_r, h_shl_ri, h_shr_ri, h_shift_zero,
+            h_ld_ri, h_st_ri, h_ldi_i,
+            h_jmp_ri, h_jz_ri, h_jnz_ri, h_hlt
+        };
+        if (ops.empty()) allocate(nullptr);
+
+        Op* op = &ops[sprs.PC >> 1];
+        while (true) {
+            if (op->handler == TRANSLATE) h_translate(c, op);
+            if (op->handler == EXIT) {
+                h_exit(c, op);
+                break;
+            }
+            op = handlers[op->handler](c, op);
+            c.executed++;
+            if (op == nullptr) break;
+            if (c.executed == budget) {
+                c.exit_pc = pc_of(op);
+                break;
+            }
+        }
+        goto done;
+#endif
+
+    done:
+        sprs.PC = c.exit_pc;
+        halted = c.halted;
+        return c.executed;
+    }
+};
+
+} // namespace cpu
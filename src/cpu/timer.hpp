@@ -0,0 +1,110 @@
+#pragma once
+
+#include "interrupts.hpp"
+#include "memory.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+
+namespace cpu {
+
+// Programmable interval timer
+// PERIOD (16-bit) shifted left by the prescale in CTRL bits 4-7 gives the
+// interval in cycles (PERIOD 0 counts as 65536). Writing CTRL with ENABLE
+// set starts a countdown from the cycle of that store, replacing any
+// running one; each expiry adds one to COUNT and raises the timer line on
+// the interrupt controller. A PERIODIC timer reloads from its due cycle, so
+// the period does not drift; a one-shot timer clears ENABLE. The timer is
+// never polled: each expiry is one event in the Memory's event queue. The
+// low 32 bits of the next expiry's cycle are kept in DUE, so a restored
+// snapshot or image re-arms the countdown where it left off.
+class Timer : public Device {
+public:
+    static constexpr uint16_t PERIOD = 0xFF50;
+    static constexpr uint16_t CTRL = 0xFF52;
+    static constexpr uint16_t COUNT = 0xFF54;    // Expiries, wrapping
+    static constexpr uint16_t DUE = 0xFF56;      // Read-only
+    static constexpr uint16_t LAST = 0xFF59;
+
+    static constexpr uint8_t ENABLE = 0x01;
+    static constexpr uint8_t PERIODIC = 0x02;
+    static constexpr unsigned PRESCALE_SHIFT = 4;
+
+private:
+    uint64_t starts = 0;
+    uint64_t expiries = 0;
+
+    static uint64_t interval(const Memory& memory) {
+        uint64_t period = memory.read_backing(PERIOD) | (memory.read_backing(PERIOD + 1) << 8);
+        if (period == 0) period = 65536;
+        return period << (memory.read_backing(CTRL) >> PRESCALE_SHIFT);
+    }
+
+    void arm(Memory& memory, uint64_t due) {
+        for (uint16_t i = 0; i < 4; i++) {
+            memory.write_backing(static_cast<uint16_t>(DUE + i), static_cast<uint8_t>(due >> (8 * i)));
+        }
+        memory.schedule(this, due);
+    }
+
+    static uint32_t saved_due(const Memory& memory) {
+        uint32_t due = 0;
+        for (uint16_t i = 0; i < 4; i++) {
+            due |= static_cast<uint32_t>(memory.read_backing(static_cast<uint16_t>(DUE + i))) << (8 * i);
+        }
+        return due;
+    }
+
+public:
+    uint8_t read(const Memory& memory, uint16_t address) override {
+        return memory.read_backing(address);
+    }
+
+    void write(Memory& memory, uint16_t address, uint8_t value) override {
+        if (address >= DUE) return;
+        memory.write_backing(address, value);
+        if (address != CTRL) return;
+        memory.cancel_events(this);
+        if (!(value & ENABLE)) return;
+        arm(memory, memory.device_clock() + interval(memory));
+        if (!memory.is_replay()) starts++;
+    }
+
+    void tick(Memory& memory, uint64_t cycle) override {
+        uint8_t control = memory.read_backing(CTRL);
+        if (!(control & ENABLE)) return;
+        uint16_t count = static_cast<uint16_t>(memory.read_backing(COUNT) | (memory.read_backing(COUNT + 1) << 8));
+        count++;
+        memory.write_backing(COUNT, static_cast<uint8_t>(count));
+        memory.write_backing(COUNT + 1, static_cast<uint8_t>(count >> 8));
+        InterruptController::raise(memory, InterruptController::TIMER_LINE);
+        if (control & PERIODIC) {
+            arm(memory, cycle + interval(memory));
+        } else {
+            memory.write_backing(CTRL, control & ~ENABLE);
+        }
+        expiries++;
+    }
+
+    // A running timer resumes at its saved due cycle. One more than an
+    // interval away cannot belong to this cycle count (e.g. after a reset),
+    // so that starts a fresh interval instead.
+    void restart(Memory& memory, uint64_t now) override {
+        if (!(memory.read_backing(CTRL) & ENABLE)) return;
+        uint64_t remaining = static_cast<uint32_t>(saved_due(memory) - static_cast<uint32_t>(now));
+        arm(memory, now + std::min(remaining, interval(memory)));
+    }
+
+    uint64_t get_expiries() const { return expiries; }
+
+    void print_stats(const Memory& memory) const {
+        std::cout << "Timer: " << starts << " starts, " << expiries << " expiries";
+        if (memory.read_backing(CTRL) & ENABLE) {
+            std::cout << ", running every " << interval(memory) << " cycles"
+                      << (memory.read_backing(CTRL) & PERIODIC ? "" : " (one-shot)");
+        }
+        std::cout << std::endl;
+    }
+};
+
+} // namespace cpu
@@ -0,0 +1,440 @@
+#pragma once
+
+#include "compiler.hpp"
+#include "isa.hpp"
+#include "memory.hpp"
+#include "registers.hpp"
+#include "spsc_ring.hpp"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#define CPU_TRACE_WRITEV 1
+#else
+#define CPU_TRACE_WRITEV 0
+#endif
+
+namespace cpu {
+
+// Binary execution trace
+//
+//   header   "CPUTRACE", u32 version, u32 flags (DELTA)
+//   records  a tag byte, then the fields the tag says are present
+//
+// STATE (tag 0x80): u64 cycle, u16 PC, u8 flags byte, R0-R7 as u16. Starts
+//   the trace and follows anything that changes registers or the cycle
+//   count outside an instruction (interrupt entry, RTI, WFI, restore).
+// STEP (tag < 0x80): one instruction, one cycle after the previous record.
+//   PC       u16, if HAS_PC; otherwise the previous STEP's PC + 2
+//   word     u16, if HAS_WORD; otherwise the last word seen at this PC
+//   value    if HAS_VALUE: the register written (or the word stored);
+//            u16, or in a DELTA trace a zigzag varint of the change to RD
+//   address  u16, if HAS_ADDRESS: LD/ST effective address
+// A raw trace sets every field. A DELTA trace leaves out what a reader can
+// work out from earlier records (sequential PCs, repeated words, store
+// values and addresses), which brings a typical loop to 1-3 bytes per
+// instruction. All fields are little-endian.
+struct TraceFormat {
+    static constexpr char MAGIC[8] = {'C', 'P', 'U', 'T', 'R', 'A', 'C', 'E'};
+    static constexpr uint32_t VERSION = 1;
+    static constexpr uint32_t DELTA = 1;
+
+    static constexpr uint8_t STATE = 0x80;
+    static constexpr uint8_t TAKEN = 0x01;       // Jump taken
+    static constexpr uint8_t HAS_PC = 0x02;
+    static constexpr uint8_t HAS_WORD = 0x04;
+    static constexpr uint8_t HAS_VALUE = 0x08;
+    static constexpr uint8_t HAS_ADDRESS = 0x10;
+
+    static bool writes_register(Opcode op) {
+        return (op >= Opcode::ADD && op <= Opcode::LD) || op == Opcode::LDI;
+    }
+
+    static uint32_t zigzag(int16_t delta) {
+        return (static_cast<uint32_t>(delta) << 1) ^ static_cast<uint32_t>(delta >> 15);
+    }
+
+    static int16_t unzigzag(uint32_t value) {
+        return static_cast<int16_t>((value >> 1) ^ (0u - (value & 1)));
+    }
+};
+
+// Records instructions into a staging buffer on the emulation thread and
+// hands full buffers to a lock-free SPSC ring; a background thread streams
+// the ring to the file with writev. When the writer falls behind, the
+// emulation thread waits for space rather than dropping records.
+class TraceWriter {
+private:
+    static constexpr size_t STAGING = 1 << 15;
+    static constexpr size_t MAX_RECORD = 32;
+
+    SpscRing ring;
+    int fd = -1;
+    std::FILE* file = nullptr;  // Hosts without writev
+    bool delta;
+    std::thread writer;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> write_calls{0};
+
+    std::array<uint8_t, STAGING> staging;
+    size_t used = 0;
+    // Reader-visible state a DELTA trace is relative to
+    std::vector<uint32_t> words;   // Word at each PC + 1 (0 = not seen yet)
+    int16_t registers[8] = {};
+    uint16_t next_pc = 0;
+
+    uint64_t steps = 0;
+    uint64_t states = 0;
+    uint64_t bytes = 0;
+    uint64_t stalls = 0;           // Publishes that found the ring full
+
+    // Encoders write through a local cursor: stores through uint8_t may
+    // alias any member, so indexing with used would reload it every byte
+    static uint8_t* put16(uint8_t* out, uint16_t value) {
+        out[0] = static_cast<uint8_t>(value);
+        out[1] = static_cast<uint8_t>(value >> 8);
+        return out + 2;
+    }
+
+    static uint8_t* put_varint(uint8_t* out, uint32_t value) {
+        while (value >= 0x80) {
+            *out++ = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = static_cast<uint8_t>(value);
+        return out;
+    }
+
+    uint8_t* cursor() {
+        if (used > STAGING - MAX_RECORD) publish();
+        return staging.data() + used;
+    }
+
+    void write_out(const uint8_t* data, size_t length) {
+#if CPU_TRACE_WRITEV
+        while (length > 0) {
+            ssize_t written = ::write(fd, data, length);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) return;
+            data += written;
+            length -= static_cast<size_t>(written);
+        }
+#else
+        std::fwrite(data, 1, length, file);
+#endif
+    }
+
+    void write_loop() {
+        while (true) {
+            const uint8_t* spans[2];
+            size_t lengths[2];
+            int count = ring.filled_spans(spans, lengths);
+            if (count == 0) {
+                if (stopping.load(std::memory_order_acquire)) {
+                    // The producer publishes everything before stopping
+                    if (ring.filled_spans(spans, lengths) == 0) break;
+                    continue;
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            size_t total = lengths[0] + (count > 1 ? lengths[1] : 0);
+#if CPU_TRACE_WRITEV
+            struct iovec segments[2] = {{const_cast<uint8_t*>(spans[0]), lengths[0]},
+                                        {const_cast<uint8_t*>(spans[1]), lengths[1]}};
+            ssize_t written = ::writev(fd, segments, count);
+            if (written < 0 && errno == EINTR) continue;
+            // A failing file drops the rest rather than stalling the machine
+            ring.release(written > 0 ? static_cast<size_t>(written) : total);
+#else
+            std::fwrite(spans[0], 1, lengths[0], file);
+            if (count > 1) std::fwrite(spans[1], 1, lengths[1], file);
+            ring.release(total);
+#endif
+            write_calls.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Move the staging buffer into the ring, waiting for space if needed
+    void publish() {
+        size_t done = 0;
+        while (done < used) {
+            uint8_t* spans[2];
+            size_t lengths[2];
+            int count = ring.free_spans(spans, lengths);
+            if (count == 0) {
+                stalls++;
+                std::this_thread::yield();
+                continue;
+            }
+            size_t moved = 0;
+            for (int i = 0; i < count && done + moved < used; i++) {
+                size_t n = std::min(lengths[i], used - done - moved);
+                std::memcpy(spans[i], &staging[done + moved], n);
+                moved += n;
+            }
+            ring.commit(moved);
+            done += moved;
+        }
+        bytes += used;
+        used = 0;
+    }
+
+public:
+    // Throws std::runtime_error if the file cannot be created
+    TraceWriter(const std::string& path, bool delta_compress, size_t ring_bytes = 1 << 22)
+        : ring(ring_bytes), delta(delta_compress), words(Memory::MEMORY_SIZE, 0) {
+#if CPU_TRACE_WRITEV
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("Cannot create trace file: " + path);
+#else
+        file = std::fopen(path.c_str(), "wb");
+        if (!file) throw std::runtime_error("Cannot create trace file: " + path);
+#endif
+        uint8_t header[16];
+        std::memcpy(header, TraceFormat::MAGIC, 8);
+        uint32_t fields[2] = {TraceFormat::VERSION, delta ? TraceFormat::DELTA : 0u};
+        std::memcpy(header + 8, fields, sizeof(fields));
+        write_out(header, sizeof(header));
+        bytes = sizeof(header);
+        writer = std::thread(&TraceWriter::write_loop, this);
+    }
+
+    ~TraceWriter() {
+        finish();
+    }
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    // Publish what is staged, drain the ring and close the file
+    void finish() {
+        if (!writer.joinable()) return;
+        publish();
+        stopping.store(true, std::memory_order_release);
+        writer.join();
+#if CPU_TRACE_WRITEV
+        ::close(fd);
+#else
+        std::fclose(file);
+#endif
+    }
+
+    void state(uint64_t cycle, const GPRs& gprs, const SPRs& sprs) {
+        uint8_t* out = cursor();
+        *out++ = TraceFormat::STATE;
+        for (int shift = 0; shift < 64; shift += 8) *out++ = static_cast<uint8_t>(cycle >> shift);
+        out = put16(out, sprs.PC);
+        *out++ = sprs.flags.to_byte();
+        for (int r = 0; r < 8; r++) {
+            registers[r] = gprs[r];
+            out = put16(out, static_cast<uint16_t>(gprs[r]));
+        }
+        used = static_cast<size_t>(out - staging.data());
+        next_pc = sprs.PC;
+        states++;
+    }
+
+    // One executed instruction; gprs are the registers after it ran
+    // A raw record is one fixed 9-byte store and leaves the delta state alone
+    CPU_ALWAYS_INLINE void step(uint16_t pc, uint16_t word, const Instruction& instr, const GPRs& gprs, bool taken,
+                                uint16_t address) {
+        uint8_t* const start = cursor();
+        const int16_t result = gprs[instr.rd];
+        if (!delta) {
+            uint8_t record[9] = {
+                static_cast<uint8_t>((taken ? TraceFormat::TAKEN : 0) | TraceFormat::HAS_PC | TraceFormat::HAS_WORD |
+                                     TraceFormat::HAS_VALUE | TraceFormat::HAS_ADDRESS),
+                static_cast<uint8_t>(pc), static_cast<uint8_t>(pc >> 8),
+                static_cast<uint8_t>(word), static_cast<uint8_t>(word >> 8),
+                static_cast<uint8_t>(result), static_cast<uint8_t>(static_cast<uint16_t>(result) >> 8),
+                static_cast<uint8_t>(address), static_cast<uint8_t>(address >> 8)};
+            std::memcpy(start, record, sizeof(record));
+            used += sizeof(record);
+            steps++;
+            return;
+        }
+        uint8_t* out = start + 1;
+        uint8_t tag = taken ? TraceFormat::TAKEN : 0;
+        if (pc != next_pc) {
+            tag |= TraceFormat::HAS_PC;
+            out = put16(out, pc);
+        }
+        if (words[pc] != word + 1u) {
+            tag |= TraceFormat::HAS_WORD;
+            words[pc] = word + 1u;
+            out = put16(out, word);
+        }
+        if (TraceFormat::writes_register(instr.opcode)) {
+            tag |= TraceFormat::HAS_VALUE;
+            out = put_varint(out, TraceFormat::zigzag(static_cast<int16_t>(result - registers[instr.rd])));
+            registers[instr.rd] = result;
+        }
+        *start = tag;
+        used = static_cast<size_t>(out - staging.data());
+        next_pc = static_cast<uint16_t>(pc + 2);
+        steps++;
+    }
+
+    uint64_t get_steps() const { return steps; }
+
+    void print_stats() const {
+        uint64_t total = bytes + used;
+        std::cout << "Trace: " << steps << " instructions, " << states << " state records, " << total
+                  << " bytes (" << std::fixed << std::setprecision(2)
+                  << (steps ? static_cast<double>(total) / steps : 0.0) << std::defaultfloat
+                  << " per instruction, " << (delta ? "delta" : "raw") << "), " << write_calls.load()
+                  << " writes, " << stalls << " ring-full waits" << std::endl;
+    }
+};
+
+// Reads a trace written by TraceWriter one record at a time, keeping the
+// register file and PC the records imply so every field is filled in
+class TraceReader {
+public:
+    struct Record {
+        bool is_state = false;
+        uint64_t cycle = 0;      // STEP: the instruction's cycle number (from 1)
+        uint16_t pc = 0;
+        uint16_t word = 0;
+        Instruction instr{};
+        bool taken = false;
+        uint16_t address = 0;    // LD/ST effective address
+        uint16_t value = 0;      // Register written, or the word stored
+        int16_t before[8] = {};  // Registers before the instruction
+        uint8_t flags = 0;       // STATE only
+    };
+
+private:
+    std::ifstream in;
+    std::vector<char> buffer;
+    size_t pos = 0;
+    size_t end = 0;
+    bool delta = false;
+    std::vector<uint32_t> words;
+    int16_t registers[8] = {};
+    uint16_t next_pc = 0;
+    uint64_t cycle = 0;
+
+    bool fill() {
+        if (!in) return false;
+        in.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+        end = static_cast<size_t>(in.gcount());
+        pos = 0;
+        return end > 0;
+    }
+
+    bool get8(uint8_t& value) {
+        if (pos == end && !fill()) return false;
+        value = static_cast<uint8_t>(buffer[pos++]);
+        return true;
+    }
+
+    uint16_t get16() {
+        uint8_t low = 0, high = 0;
+        if (!get8(low) || !get8(high)) throw std::runtime_error("Truncated trace record");
+        return static_cast<uint16_t>(low | (high << 8));
+    }
+
+    uint32_t get_varint() {
+        uint32_t value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            uint8_t byte = 0;
+            if (!get8(byte)) throw std::runtime_error("Truncated trace record");
+            value |= static_cast<uint32_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) return value;
+        }
+        throw std::runtime_error("Corrupt trace varint");
+    }
+
+public:
+    // Throws std::runtime_error unless path holds a trace of this version
+    explicit TraceReader(const std::string& path)
+        : in(path, std::ios::binary), buffer(1 << 20), words(Memory::MEMORY_SIZE, 0) {
+        if (!in) throw std::runtime_error("Cannot open trace: " + path);
+        uint8_t header[16];
+        for (uint8_t& byte : header) {
+            if (!get8(byte)) throw std::runtime_error("Not a trace file: " + path);
+        }
+        if (std::memcmp(header, TraceFormat::MAGIC, 8) != 0) throw std::runtime_error("Not a trace file: " + path);
+        uint32_t fields[2];
+        std::memcpy(fields, header + 8, sizeof(fields));
+        if (fields[0] != TraceFormat::VERSION) {
+            throw std::runtime_error("Unsupported trace version " + std::to_string(fields[0]) + ": " + path);
+        }
+        delta = (fields[1] & TraceFormat::DELTA) != 0;
+    }
+
+    bool is_delta() const { return delta; }
+
+    // False at the end of the trace; throws std::runtime_error on a
+    // malformed record
+    bool next(Record& record) {
+        uint8_t tag = 0;
+        if (!get8(tag)) return false;
+        record = Record();
+        if (tag == TraceFormat::STATE) {
+            uint64_t value = 0;
+            for (int shift = 0; shift < 64; shift += 8) {
+                uint8_t byte = 0;
+                if (!get8(byte)) throw std::runtime_error("Truncated trace record");
+                value |= static_cast<uint64_t>(byte) << shift;
+            }
+            record.is_state = true;
+            record.cycle = cycle = value;
+            record.pc = next_pc = get16();
+            if (!get8(record.flags)) throw std::runtime_error("Truncated trace record");
+            for (int r = 0; r < 8; r++) registers[r] = static_cast<int16_t>(get16());
+            std::memcpy(record.before, registers, sizeof(registers));
+            return true;
+        }
+        if (tag & TraceFormat::STATE) throw std::runtime_error("Corrupt trace record tag");
+
+        record.cycle = ++cycle;
+        record.pc = (tag & TraceFormat::HAS_PC) ? get16() : next_pc;
+        if (tag & TraceFormat::HAS_WORD) {
+            record.word = get16();
+            words[record.pc] = record.word + 1u;
+        } else {
+            if (!words[record.pc]) throw std::runtime_error("Trace refers to an instruction word it never recorded");
+            record.word = static_cast<uint16_t>(words[record.pc] - 1);
+        }
+        record.instr = Instruction::decode(record.word);
+        record.taken = (tag & TraceFormat::TAKEN) != 0;
+        std::memcpy(record.before, registers, sizeof(registers));
+        const Instruction& instr = record.instr;
+        bool writes = TraceFormat::writes_register(instr.opcode);
+        bool memory_op = instr.opcode == Opcode::LD || instr.opcode == Opcode::ST;
+        uint16_t derived_address = static_cast<uint16_t>(registers[instr.rs1] + instr.imm);
+        if (tag & TraceFormat::HAS_VALUE) {
+            if (delta) {
+                record.value = static_cast<uint16_t>(registers[instr.rd] + TraceFormat::unzigzag(get_varint()));
+            } else {
+                record.value = get16();
+            }
+        } else {
+            record.value = static_cast<uint16_t>(registers[instr.rd]);
+        }
+        record.address = (tag & TraceFormat::HAS_ADDRESS) ? get16() : (memory_op ? derived_address : 0);
+        if (writes) registers[instr.rd] = static_cast<int16_t>(record.value);
+        next_pc = static_cast<uint16_t>(record.pc + 2);
+        return true;
+    }
+};
+
+} // namespace cpu
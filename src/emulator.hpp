@@ -6,13 +6,64 @@
 #include "cpu/memory.hpp"
 #include "cpu/isa.hpp"
 #include "cpu/control_unit.hpp"
+#include "cpu/jit_validator.hpp"
+#include "cpu/image_file.hpp"
+#include "cpu/mmu.hpp"
+#include "cpu/dma.hpp"
+#include "cpu/interrupts.hpp"
+#include "cpu/timer.hpp"
+#include "cpu/profiler.hpp"
+#include "cpu/heat_map.hpp"
+#include "cpu/pipeline.hpp"
+#include "cpu/branch_predictor.hpp"
+#include "cpu/cache.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <iomanip>
 #include <iostream>
+#include <memory>
 
 namespace emulator {
 
+// Why a bounded run returned
+enum class StopReason {
+    HALTED,      // Executed HLT
+    BUDGET,      // Instruction budget used up
+    BREAKPOINT,  // Reached the requested PC
+    DEADLINE     // Wall-clock deadline passed
+};
+
+inline const char* stop_reason_name(StopReason reason) {
+    switch (reason) {
+        case StopReason::HALTED: return "halted";
+        case StopReason::BUDGET: return "budget";
+        case StopReason::BREAKPOINT: return "breakpoint";
+        case StopReason::DEADLINE: return "deadline";
+    }
+    return "unknown";
+}
+
+// Outcome of run_for / run_until / run_until_deadline
+struct RunResult {
+    StopReason reason;
+    uint64_t instructions;  // Executed by this call
+};
+
+// Whole-machine state captured by CPUEmulator::snapshot
+struct Snapshot {
+    cpu::GPRs gprs;
+    cpu::SPRs sprs;
+    cpu::BusSystem buses;
+    uint64_t cycle_count = 0;
+    bool halted = false;
+    uint16_t program_start = 0;
+    cpu::Memory::Image memory;
+    cpu::Mmu::Store banks;   // Empty without an MMU
+};
+
 // Main CPU Emulator class
 class CPUEmulator {
 private:
@@ -21,40 +72,402 @@ private:
     cpu::Memory memory;
     cpu::ControlUnit control_unit;
     cpu::BusSystem buses;
+    std::unique_ptr<cpu::JitValidator> validator;  // Created by the first set_jit_validation(true)
     
     bool running;
+    bool validate_jit = false;
     uint16_t program_start;
+    cpu::Memory::SharedImage image_base;  // Last complete image file, for changed-page dumps
+    std::unique_ptr<cpu::Mmu> mmu;        // Bank switching, nullptr = off (forks get a copy-on-write copy)
+    // Built-in devices; every machine has its own
+    std::shared_ptr<cpu::DmaController> dma;
+    std::shared_ptr<cpu::InterruptController> interrupts;
+    std::shared_ptr<cpu::Timer> timer;
+    std::unique_ptr<cpu::TraceWriter> trace_writer;  // Binary trace file (nullptr = off)
+    std::unique_ptr<cpu::Profiler> profiler;         // Kept after profiling stops, for reports
+    std::unique_ptr<cpu::HeatMap> heat_map;          // Likewise
+    std::unique_ptr<cpu::PipelineModel> pipeline;    // Likewise
+    std::unique_ptr<cpu::BranchPredictorSet> predictors;
+    std::unique_ptr<cpu::CacheSystem> caches;
+    
+    // Instructions between wall-clock checks in run_until_deadline, and
+    // between console timer polls in run_for
+    static constexpr uint64_t DEADLINE_BATCH = 1 << 20;
+    // Longest slice between device ticks while a device event is pending
+    static constexpr uint64_t DEVICE_QUANTUM = 1 << 14;
+    
+    void attach_builtin_devices() {
+        memory.attach_device(cpu::DmaController::SRC, cpu::DmaController::LAST, dma.get());
+        memory.attach_device(cpu::InterruptController::PENDING, cpu::InterruptController::LAST, interrupts.get());
+        memory.attach_device(cpu::Timer::PERIOD, cpu::Timer::LAST, timer.get());
+    }
+    
+    // Registers, PC or the cycle count changed outside an instruction; the
+    // binary trace restarts from the new state
+    void trace_state() {
+        if (trace_writer) trace_writer->state(control_unit.get_cycle_count(), gprs, sprs);
+    }
+    
+    // Execution continues from a state the last instruction did not lead to
+    // (interrupt entry, RTI, WFI, load, restore, reset): the binary trace
+    // records it and the pipeline model refetches
+    void state_changed() {
+        trace_state();
+        if (control_unit.is_timing_pipeline()) pipeline->redirect();
+    }
+    
+    // The pipeline report names the predictor and memory timing it is fed
+    void label_pipeline() {
+        if (!pipeline) return;
+        pipeline->set_prediction(control_unit.is_predicting_branches() ? predictors->name(0) : "static");
+        pipeline->set_cached(control_unit.is_caching());
+    }
+    
+    // Enter the handler if an enabled interrupt is pending. Only called
+    // between instructions, with flags resolved.
+    void take_interrupt() {
+        if (!cpu::InterruptController::ready(memory)) return;
+        interrupts->enter(memory, gprs, sprs);
+        if (validate_jit) validator->sync(memory, gprs, sprs);
+        state_changed();
+    }
+    
+    // The engines stop on every HLT encoding, leaving PC on it. Carry out
+    // RTI, or WFI by fast-forwarding the cycle count from one device event
+    // to the next until an interrupt is pending, at most remaining cycles.
+    // Returns false for a real HLT, and for a WFI with no event left to end
+    // it (the machine stays halted there).
+    bool resume_after_halt(uint64_t remaining) {
+        uint64_t now = control_unit.get_cycle_count();
+        cpu::Instruction instr = cpu::Instruction::decode(memory.read_word(sprs.PC));
+        if (instr.rd == static_cast<uint8_t>(cpu::SystemOp::RTI)) {
+            interrupts->leave(memory, gprs, sprs);
+        } else if (instr.rd == static_cast<uint8_t>(cpu::SystemOp::WFI)) {
+            uint64_t limit = remaining > UINT64_MAX - now ? UINT64_MAX : now + remaining;
+            uint64_t cycle = now;
+            while (!cpu::InterruptController::pending(memory)) {
+                uint64_t next = memory.next_device_event();
+                if (next == UINT64_MAX) return false;
+                if (next >= limit) {
+                    // Out of budget while idle; the WFI runs again next time
+                    interrupts->record_wait(limit - now);
+                    control_unit.restore_state(limit, false);
+                    state_changed();
+                    return true;
+                }
+                cycle = std::max(cycle, next);
+                memory.tick_devices(cycle);
+            }
+            interrupts->record_wait(cycle - now);
+            sprs.PC += 2;
+            now = cycle;
+        } else {
+            return false;
+        }
+        control_unit.restore_state(now, false);
+        if (validate_jit) validator->sync(memory, gprs, sprs);
+        state_changed();
+        return true;
+    }
+    
+    // Tick due devices and take a pending interrupt, then size the next
+    // slice so it ends no later than the next device event
+    uint64_t next_slice(uint64_t remaining) {
+        uint64_t now = control_unit.get_cycle_count();
+        memory.tick_devices(now);
+        take_interrupt();
+        if (!memory.has_pending_events()) return std::min(remaining, DEADLINE_BATCH);
+        uint64_t until_event = memory.next_device_event() - now;  // Events left are all in the future
+        return std::min({remaining, DEVICE_QUANTUM, until_event});
+    }
+    
+    // Pending device events belong to the old timeline once RAM or the cycle
+    // count is replaced; devices re-arm from their registers
+    void restart_devices() {
+        memory.restart_devices(control_unit.get_cycle_count());
+    }
+    
+    // Traced runs go one instruction at a time, so every limit is exact
+    RunResult run_traced(uint64_t max_cycles, bool use_breakpoint, uint16_t breakpoint) {
+        uint64_t start = control_unit.get_cycle_count();
+        running = true;
+        while (true) {
+            uint64_t done = control_unit.get_cycle_count() - start;
+            if (control_unit.is_halted()) {
+                if (!resume_after_halt(max_cycles - done)) break;
+                continue;
+            }
+            if (done >= max_cycles) return finish_run(StopReason::BUDGET, start);
+            if (use_breakpoint && done > 0 && sprs.PC == breakpoint) {
+                return finish_run(StopReason::BREAKPOINT, start);
+            }
+            memory.tick_devices(control_unit.get_cycle_count());
+            take_interrupt();
+            control_unit.execute_cycle(memory, gprs, sprs, buses);
+            memory.poll_console();
+        }
+        return finish_run(StopReason::HALTED, start);
+    }
+    
+    RunResult finish_run(StopReason reason, uint64_t start_cycles) {
+        running = false;
+        if (control_unit.is_halted()) reason = StopReason::HALTED;
+        // Control returns to the host whatever stopped the run: flush any
+        // remaining output, ending a partial line
+        memory.flush_output();
+        return RunResult{reason, control_unit.get_cycle_count() - start_cycles};
+    }
     
 public:
     CPUEmulator(bool trace = false) 
-        : control_unit(trace), running(false), program_start(0x0000) {}
+        : control_unit(trace), running(false), program_start(0x0000), dma(std::make_shared<cpu::DmaController>()),
+          interrupts(std::make_shared<cpu::InterruptController>()), timer(std::make_shared<cpu::Timer>()) {
+        attach_builtin_devices();
+    }
     
     // Load program into memory
     void load_program(const std::vector<uint16_t>& program, uint16_t start_address = 0x0000) {
         program_start = start_address;
         sprs.PC = start_address;
         memory.load_program(start_address, program);
+        state_changed();
     }
     
     // Run program until halt
+    // Uses the zero-overhead interpreter unless tracing is on
     void run() {
+        run_for(UINT64_MAX);
+    }
+    
+    // Run at most max_cycles instructions
+    RunResult run_for(uint64_t max_cycles) {
+        if (control_unit.is_trace_enabled()) return run_traced(max_cycles, false, 0);
+        uint64_t start = control_unit.get_cycle_count();
         running = true;
-        while (running && !control_unit.is_halted()) {
-            running = control_unit.execute_cycle(memory, gprs, sprs, buses);
+        if (validate_jit) validator->sync(memory, gprs, sprs);
+        while (true) {
+            uint64_t done = control_unit.get_cycle_count() - start;
+            if (control_unit.is_halted()) {
+                if (!resume_after_halt(max_cycles - done)) break;
+                continue;
+            }
+            if (done >= max_cycles) break;
+            control_unit.run_fast(memory, gprs, sprs, buses, next_slice(max_cycles - done));
+            memory.poll_console();
         }
-        // Flush any remaining output in the buffer
-        std::string remaining = memory.get_output();
-        if (!remaining.empty()) {
-            std::cout << remaining << std::endl;
-            memory.clear_output();
+        if (validate_jit) validator->print_summary();
+        return finish_run(StopReason::BUDGET, start);
+    }
+    
+    // Run until the PC reaches pc (after at least one instruction), HLT, or
+    // max_cycles instructions
+    RunResult run_until(uint16_t pc, uint64_t max_cycles = UINT64_MAX) {
+        if (control_unit.is_trace_enabled()) return run_traced(max_cycles, true, pc);
+        uint64_t start = control_unit.get_cycle_count();
+        running = true;
+        while (true) {
+            uint64_t done = control_unit.get_cycle_count() - start;
+            if (control_unit.is_halted()) {
+                if (!resume_after_halt(max_cycles - done)) break;
+                continue;
+            }
+            if (done >= max_cycles) break;
+            if (done > 0 && sprs.PC == pc) break;
+            control_unit.run_to_breakpoint(memory, gprs, sprs, buses, pc, next_slice(max_cycles - done));
+            memory.poll_console();
         }
+        bool at_breakpoint = control_unit.get_cycle_count() != start && sprs.PC == pc && !control_unit.is_halted();
+        return finish_run(at_breakpoint ? StopReason::BREAKPOINT : StopReason::BUDGET, start);
     }
     
-    // Step one instruction
-    void step() {
-        if (!control_unit.is_halted()) {
-            control_unit.execute_cycle(memory, gprs, sprs, buses);
+    // Run until HLT, the wall-clock deadline, or max_cycles instructions
+    // The clock is read between batches of DEADLINE_BATCH instructions.
+    RunResult run_until_deadline(std::chrono::steady_clock::time_point deadline,
+                                 uint64_t max_cycles = UINT64_MAX) {
+        uint64_t start = control_unit.get_cycle_count();
+        bool fast = !control_unit.is_trace_enabled();
+        if (fast && validate_jit) validator->sync(memory, gprs, sprs);
+        StopReason reason = StopReason::HALTED;
+        while (true) {
+            uint64_t done = control_unit.get_cycle_count() - start;
+            if (control_unit.is_halted()) {
+                if (!resume_after_halt(max_cycles - done)) break;
+                continue;
+            }
+            if (done >= max_cycles) {
+                reason = StopReason::BUDGET;
+                break;
+            }
+            if (std::chrono::steady_clock::now() >= deadline) {
+                reason = StopReason::DEADLINE;
+                break;
+            }
+            uint64_t batch = fast ? next_slice(max_cycles - done) : std::min(max_cycles - done, DEADLINE_BATCH);
+            if (fast) {
+                control_unit.run_fast(memory, gprs, sprs, buses, batch);
+                memory.poll_console();
+            } else {
+                run_traced(batch, false, 0);
+            }
+        }
+        if (fast && validate_jit) validator->print_summary();
+        return finish_run(reason, start);
+    }
+    
+    // Zero memory and drop all decoded code, for reusing an instance on a new program
+    void clear_memory() {
+        control_unit.flush_code();
+        memory.clear();
+        restart_devices();
+    }
+    
+    // Store a word in memory (program inputs)
+    void write_word(uint16_t address, uint16_t value) {
+        memory.write_word(address, value);
+    }
+    
+    // Console lines go to sink instead of std::cout (nullptr restores std::cout)
+    void set_output_sink(cpu::Memory::OutputSink* sink) {
+        memory.set_output_sink(sink);
+    }
+    
+    // Console stream for guest output (nullptr = standard output)
+    void set_console(cpu::ConsoleBuffer* console) {
+        memory.set_console(console);
+    }
+    
+    cpu::ConsoleBuffer& get_console() const {
+        return memory.console_stream();
+    }
+    
+    // Source for guest STDIN reads (nullptr = none); the caller keeps it alive
+    void set_input(cpu::ConsoleInput* input) {
+        memory.set_input(input);
+    }
+    
+    cpu::ConsoleInput* get_input() const {
+        return memory.get_input();
+    }
+    
+    // Bank switching: select registers at Mmu::REGISTER_BASE open window_bytes
+    // (4KB or 16KB) windows onto a store_bytes physical store. Throws
+    // std::invalid_argument for unsupported sizes.
+    void enable_mmu(size_t window_bytes, size_t store_bytes) {
+        disable_mmu();
+        mmu = std::make_unique<cpu::Mmu>(window_bytes, store_bytes);
+        memory.attach_device(cpu::Mmu::REGISTER_BASE, mmu->last_register(), mmu.get());
+        mmu->remap(memory);
+    }
+    
+    // Every window shows its own RAM again; the select registers become RAM
+    void disable_mmu() {
+        if (!mmu) return;
+        memory.detach_device(mmu.get());
+        for (size_t window = 0; window < mmu->get_windows(); window++) {
+            memory.map_window(window * mmu->get_window_size() / cpu::Memory::PAGE_SIZE,
+                              mmu->get_window_size() / cpu::Memory::PAGE_SIZE, nullptr);
         }
+        mmu.reset();
+    }
+    
+    const cpu::Mmu* get_mmu() const {
+        return mmu.get();
+    }
+    
+    const cpu::DmaController& get_dma() const {
+        return *dma;
+    }
+    
+    const cpu::InterruptController& get_interrupts() const {
+        return *interrupts;
+    }
+    
+    // Map a device over [base, last]; the caller keeps it alive. Forks share it.
+    void attach_device(uint16_t base, uint16_t last, cpu::Device* device) {
+        memory.attach_device(base, last, device);
+    }
+    
+    void detach_device(cpu::Device* device) {
+        memory.detach_device(device);
+    }
+    
+    // Capture registers, cycle/halt state and memory. Memory starts tracking
+    // dirty pages from here, so restoring this snapshot copies only those.
+    Snapshot snapshot() {
+        Snapshot snap;
+        snap.gprs = gprs;
+        snap.sprs = sprs;
+        snap.buses = buses;
+        snap.cycle_count = control_unit.get_cycle_count();
+        snap.halted = control_unit.is_halted();
+        snap.program_start = program_start;
+        snap.memory = memory.save_image();
+        if (mmu) snap.banks = mmu->save_store(memory);
+        return snap;
+    }
+    
+    // Return to a snapshot (from this or any other emulator); returns the
+    // number of memory pages copied
+    size_t restore(const Snapshot& snap) {
+        gprs = snap.gprs;
+        sprs = snap.sprs;
+        buses = snap.buses;
+        control_unit.restore_state(snap.cycle_count, snap.halted);
+        program_start = snap.program_start;
+        running = false;
+        // Open the snapshot's banks first so its window contents land in them
+        if (mmu) mmu->restore_store(memory, snap.banks, snap.memory.bytes.data());
+        size_t copied = memory.restore_image(snap.memory);
+        restart_devices();
+        state_changed();
+        return copied;
+    }
+    
+    // Independent copy of this machine and its settings; the child starts with
+    // empty code caches and prints to std::cout
+    std::unique_ptr<CPUEmulator> fork() const {
+        auto child = std::make_unique<CPUEmulator>(control_unit.is_trace_enabled());
+        child->set_engine(control_unit.get_engine());
+        child->set_fusion(control_unit.get_fusion());
+        child->set_lazy_flags(control_unit.get_lazy_flags());
+        child->set_jit_threshold(control_unit.get_jit_threshold());
+        child->gprs = gprs;
+        child->sprs = sprs;
+        child->buses = buses;
+        child->control_unit.restore_state(control_unit.get_cycle_count(), control_unit.is_halted());
+        child->program_start = program_start;
+        child->memory = memory;
+        if (mmu) {
+            // The copied windows still show our banks until the child's copy remaps them
+            child->memory.detach_device(mmu.get());
+            child->mmu = std::make_unique<cpu::Mmu>(*mmu);
+            child->memory.attach_device(cpu::Mmu::REGISTER_BASE, mmu->last_register(), child->mmu.get());
+            child->mmu->remap(child->memory);
+        }
+        // The child gets its own built-in devices, re-armed from the copied
+        // registers (pending transfers and expiries keep their due cycles)
+        child->memory.detach_device(dma.get());
+        child->memory.detach_device(interrupts.get());
+        child->memory.detach_device(timer.get());
+        child->attach_builtin_devices();
+        child->restart_devices();
+        child->memory.clear_code_watch();
+        child->memory.set_output_sink(nullptr);
+        return child;
+    }
+    
+    // Pages written since the last snapshot or restore
+    size_t dirty_pages() const {
+        return memory.dirty_page_count();
+    }
+    
+    // Step one instruction; a WFI waits and an RTI returns within the step
+    void step() {
+        if (control_unit.is_halted()) return;
+        memory.tick_devices(control_unit.get_cycle_count());
+        take_interrupt();
+        control_unit.execute_cycle(memory, gprs, sprs, buses);
+        if (control_unit.is_halted()) resume_after_halt(UINT64_MAX);
     }
     
     // Reset CPU state
@@ -62,8 +475,11 @@ public:
         gprs = cpu::GPRs();
         sprs = cpu::SPRs();
         buses.reset();
+        control_unit.reset();
         running = false;
         sprs.PC = program_start;
+        restart_devices();
+        state_changed();
     }
     
     // Print CPU state
@@ -85,11 +501,69 @@ public:
         sprs.print();
     }
     
+    // Print engine statistics
+    void print_stats() const {
+        const cpu::DecodeCache& cache = control_unit.get_decode_cache();
+        uint64_t lookups = cache.get_hits() + cache.get_misses();
+        std::cout << "=== Engine Statistics ===" << std::endl;
+        std::cout << "Cycles: " << control_unit.get_cycle_count() << std::endl;
+        std::cout << "Decode cache: " << cache.get_hits() << " hits, "
+                  << cache.get_misses() << " misses, "
+                  << cache.get_invalidations() << " invalidations";
+        if (lookups > 0) {
+            std::cout << " (" << std::fixed << std::setprecision(2)
+                      << (100.0 * cache.get_hits() / lookups) << "% hit rate)"
+                      << std::defaultfloat;
+        }
+        std::cout << std::endl;
+        std::cout << "Threaded engine: " << control_unit.get_threaded_engine().get_translations()
+                  << " translations" << std::endl;
+        const cpu::BlockEngine& blocks = control_unit.get_block_engine();
+        std::cout << "Block engine: " << blocks.get_block_count() << " blocks, "
+                  << blocks.get_block_executions() << " block hits, "
+                  << "avg length " << std::fixed << std::setprecision(2)
+                  << blocks.average_block_length() << std::defaultfloat << ", "
+                  << blocks.get_chained_transitions() << " chained / "
+                  << blocks.get_dispatcher_lookups() << " dispatched, "
+                  << blocks.get_invalidations() << " invalidations" << std::endl;
+        uint64_t fused = 0;
+        for (int k = 0; k < cpu::BlockEngine::FUSION_KINDS; k++) {
+            fused += blocks.get_fusion_hits(static_cast<cpu::BlockEngine::FusionKind>(k));
+        }
+        std::cout << "Fusion: " << (blocks.get_fusion() ? "on" : "off") << ", "
+                  << fused << " fused ops executed (see 'fusion')" << std::endl;
+        const cpu::X86Jit* jit = control_unit.get_jit();
+        std::cout << "JIT: " << blocks.get_compiled_blocks() << " blocks compiled, "
+                  << blocks.get_native_executions() << " native block runs, "
+                  << (jit ? jit->get_bytes_used() : 0) << " bytes of code, "
+                  << (jit ? jit->get_flushes() : 0) << " flushes";
+        if (!cpu::X86Jit::available()) std::cout << " (backend unavailable on this host)";
+        std::cout << std::endl;
+        memory.console_stream().print_stats();
+        if (memory.get_input()) memory.get_input()->print_stats();
+        if (mmu) mmu->print_stats(memory);
+        dma->print_stats();
+        timer->print_stats(memory);
+        interrupts->print_stats(memory);
+        if (trace_writer) trace_writer->print_stats();
+    }
+    
     // Print RAM
     void print_ram(uint16_t start = 0, uint16_t length = 256) const {
         memory.print_dump(start, length);
     }
     
+    // RAM dump with the heat map's access glyphs beside each row
+    void print_ram_heat(uint16_t start = 0, uint16_t length = 256) const {
+        if (!heat_map) {
+            memory.print_dump(start, length);
+            return;
+        }
+        std::vector<char> overlay = heat_map->glyphs(start, length);
+        memory.print_dump(start, length, &overlay);
+        std::cout << "Heat: ' ' untouched, . : - = + * # % @ busier (log scale)" << std::endl;
+    }
+    
     // Print memory values as decimal numbers
     void print_decimal(uint16_t start = 0, uint16_t count = 10) const {
         std::cout << "\n=== Memory as Decimal Numbers ===" << std::endl;
@@ -109,11 +583,226 @@ public:
         memory.print_instructions(start, count);
     }
     
+    // Select the interpreter core used by run()
+    void set_engine(cpu::Engine engine) {
+        control_unit.set_engine(engine);
+    }
+    
+    cpu::Engine get_engine() const {
+        return control_unit.get_engine();
+    }
+    
+    // Superinstruction fusion for the block and jit engines
+    void set_fusion(bool enable) {
+        control_unit.set_fusion(enable);
+    }
+    
+    bool get_fusion() const {
+        return control_unit.get_fusion();
+    }
+    
+    // Print which fusions were translated and how often they ran
+    void print_fusion_report() const {
+        const cpu::BlockEngine& blocks = control_unit.get_block_engine();
+        std::cout << "=== Fusion Report (" << (blocks.get_fusion() ? "on" : "off") << ") ===" << std::endl;
+        for (int k = 0; k < cpu::BlockEngine::FUSION_KINDS; k++) {
+            auto kind = static_cast<cpu::BlockEngine::FusionKind>(k);
+            std::cout << std::left << std::setfill(' ') << std::setw(12) << cpu::BlockEngine::fusion_name(kind) << std::right
+                      << " sites: " << blocks.get_fusion_sites(kind)
+                      << "  executed: " << blocks.get_fusion_hits(kind) << std::endl;
+        }
+    }
+    
+    // Lazy condition flags for the switch interpreter
+    void set_lazy_flags(bool enable) {
+        control_unit.set_lazy_flags(enable);
+    }
+    
+    bool get_lazy_flags() const {
+        return control_unit.get_lazy_flags();
+    }
+    
+    void set_jit_threshold(uint64_t threshold) {
+        control_unit.set_jit_threshold(threshold);
+    }
+    
+    uint64_t get_jit_threshold() const {
+        return control_unit.get_jit_threshold();
+    }
+    
+    // Shadow every block the block/JIT engines run with the switch interpreter
+    void set_jit_validation(bool enable) {
+        if (enable && !validator) validator = std::make_unique<cpu::JitValidator>();
+        validate_jit = enable;
+        control_unit.set_block_observer(enable ? validator.get() : nullptr);
+    }
+    
     // Enable/disable trace
     void enable_trace(bool enable) {
         control_unit.enable_trace(enable);
     }
     
+    // Record every instruction from here on to a binary trace file (see
+    // cpu/trace.hpp), replacing any recording in progress. Runs use the
+    // switch interpreter while recording. Throws std::runtime_error if the
+    // file cannot be created.
+    void start_trace_file(const std::string& path, bool delta) {
+        stop_trace_file();
+        trace_writer = std::make_unique<cpu::TraceWriter>(path, delta);
+        control_unit.set_recorder(trace_writer.get());
+        trace_state();
+    }
+    
+    // Finish the trace file and print its statistics; false if none was open
+    bool stop_trace_file() {
+        if (!trace_writer) return false;
+        control_unit.set_recorder(nullptr);
+        trace_writer->finish();
+        trace_writer->print_stats();
+        trace_writer.reset();
+        return true;
+    }
+    
+    bool is_trace_file_open() const { return trace_writer != nullptr; }
+    
+    // Count executions per PC, opcode and jump outcome (see cpu/profiler.hpp).
+    // Runs use the switch interpreter while profiling. Counts accumulate
+    // across runs and stay readable after profiling is turned off.
+    void set_profiling(bool enable) {
+        if (enable && !profiler) profiler = std::make_unique<cpu::Profiler>();
+        control_unit.set_profiler(enable ? profiler.get() : nullptr);
+    }
+    
+    bool is_profiling() const { return control_unit.is_profiling(); }
+    
+    void clear_profile() {
+        if (profiler) profiler->clear();
+    }
+    
+    // nullptr if profiling was never enabled
+    const cpu::Profiler* get_profiler() const { return profiler.get(); }
+    
+    // Count fetches and LD/ST accesses per address (see cpu/heat_map.hpp);
+    // like the profiler, runs use the switch interpreter while it is on and
+    // the counts outlive it
+    void set_heat_map(bool enable) {
+        if (enable && !heat_map) heat_map = std::make_unique<cpu::HeatMap>();
+        control_unit.set_heat_map(enable ? heat_map.get() : nullptr);
+    }
+    
+    bool is_mapping_heat() const { return control_unit.is_mapping_heat(); }
+    
+    // Clears the counts too
+    void set_heat_window(uint64_t instructions) {
+        if (!heat_map) heat_map = std::make_unique<cpu::HeatMap>();
+        heat_map->set_window(instructions);
+    }
+    
+    void clear_heat_map() {
+        if (heat_map) heat_map->clear();
+    }
+    
+    // nullptr if the heat map was never enabled
+    const cpu::HeatMap* get_heat_map() const { return heat_map.get(); }
+    
+    void print_heat_map(size_t top = 10) const {
+        if (heat_map) heat_map->print_report(memory, top);
+    }
+    
+    // Throws std::runtime_error if the file cannot be written
+    void write_heat_map(const std::string& filename) const {
+        if (heat_map) heat_map->write_json(filename, memory);
+    }
+    
+    // Time each instruction on a five-stage pipeline model (see
+    // cpu/pipeline.hpp); runs use the switch interpreter while it is on and
+    // the counts outlive it
+    void set_pipeline(bool enable) {
+        if (enable && !pipeline) pipeline = std::make_unique<cpu::PipelineModel>();
+        control_unit.set_pipeline(enable ? pipeline.get() : nullptr);
+        label_pipeline();
+    }
+    
+    bool is_timing_pipeline() const { return control_unit.is_timing_pipeline(); }
+    
+    // Latencies, forwarding and branch penalty from a spec such as
+    // "forward=off,mem=2,LD=3"; clears the counts. Throws
+    // std::invalid_argument on a bad spec.
+    void configure_pipeline(const std::string& spec) {
+        cpu::PipelineModel::Config config = cpu::PipelineModel::parse_config(spec);
+        if (!pipeline) pipeline = std::make_unique<cpu::PipelineModel>();
+        pipeline->configure(config);
+    }
+    
+    void clear_pipeline() {
+        if (pipeline) pipeline->clear();
+    }
+    
+    // nullptr if the pipeline model was never enabled
+    const cpu::PipelineModel* get_pipeline() const { return pipeline.get(); }
+    
+    void print_pipeline() const {
+        if (pipeline) pipeline->print_report();
+    }
+    
+    // Run several branch predictors side by side on the executed JZ/JNZ
+    // stream (see cpu/branch_predictor.hpp). The first one decides the
+    // pipeline model's flushes while both are on. Counts outlive it.
+    void set_branch_prediction(bool enable) {
+        if (enable && !predictors) predictors = std::make_unique<cpu::BranchPredictorSet>();
+        control_unit.set_predictors(enable ? predictors.get() : nullptr);
+        label_pipeline();
+    }
+    
+    bool is_predicting_branches() const { return control_unit.is_predicting_branches(); }
+    
+    // Replace the predictors with those in spec, e.g. "gshare:12:8,btb:64",
+    // keeping prediction on or off. Throws std::invalid_argument on a bad spec.
+    void configure_branch_predictors(const std::string& spec) {
+        predictors = std::make_unique<cpu::BranchPredictorSet>(spec);
+        set_branch_prediction(control_unit.is_predicting_branches());
+    }
+    
+    void clear_branch_prediction() {
+        if (predictors) predictors->clear();
+    }
+    
+    // nullptr if branch prediction was never enabled
+    const cpu::BranchPredictorSet* get_branch_predictors() const { return predictors.get(); }
+    
+    void print_branch_prediction(size_t top = 10) const {
+        if (predictors) predictors->print_report(top);
+    }
+    
+    // Simulate L1 instruction and data caches on fetch and LD/ST (see
+    // cpu/cache.hpp). Their latencies feed the pipeline model while both are
+    // on. Counts outlive it.
+    void set_caches(bool enable) {
+        if (enable && !caches) caches = std::make_unique<cpu::CacheSystem>();
+        control_unit.set_caches(enable ? caches.get() : nullptr);
+        label_pipeline();
+    }
+    
+    bool is_caching() const { return control_unit.is_caching(); }
+    
+    // Geometry and policies from a spec such as "size=2048,d.ways=4,miss=20";
+    // empties the caches. Throws std::invalid_argument on a bad spec.
+    void configure_caches(const std::string& spec) {
+        if (!caches) caches = std::make_unique<cpu::CacheSystem>();
+        caches->configure(spec);
+    }
+    
+    void clear_caches() {
+        if (caches) caches->clear();
+    }
+    
+    // nullptr if the caches were never enabled
+    const cpu::CacheSystem* get_caches() const { return caches.get(); }
+    
+    const cpu::GPRs& get_gprs() const {
+        return gprs;
+    }
+    
     // Get current PC
     uint16_t get_pc() const {
         return sprs.PC;
@@ -129,12 +818,44 @@ public:
         return control_unit.get_cycle_count();
     }
     
-    // Memory dump to file
-    void memory_dump(const std::string& filename, uint16_t start = 0, uint16_t length = 0xFFFF) const {
-        // This would write memory to file - simplified for now
-        (void)start;  // Suppress unused parameter warning
-        (void)length; // Suppress unused parameter warning
-        std::cout << "Memory dump to " << filename << " (not implemented)" << std::endl;
+    // Write registers and the RAM pages covering [start, start + length) to a
+    // machine image file. changed_only keeps just the pages that differ from
+    // the last complete image saved or loaded (or from the mapped RAM image if
+    // there was none). Throws std::runtime_error on I/O errors.
+    cpu::ImageFile::Summary memory_dump(const std::string& filename, uint32_t start = 0,
+                                        uint32_t length = cpu::Memory::MEMORY_SIZE,
+                                        bool changed_only = false) {
+        cpu::ImageFile::Machine machine;
+        machine.gprs = gprs;
+        machine.sprs = sprs;
+        machine.cycle_count = control_unit.get_cycle_count();
+        machine.halted = control_unit.is_halted();
+        machine.program_start = program_start;
+        const uint8_t* base = nullptr;
+        if (changed_only) base = image_base ? image_base.get() : memory.shared_image().get();
+        cpu::ImageFile::Summary summary = cpu::ImageFile::save(filename, memory, &machine, start, length, base);
+        if (!changed_only && summary.pages == cpu::Memory::PAGE_COUNT) image_base = memory.share();
+        return summary;
+    }
+    
+    // Load a machine image file written by memory_dump. A complete image is
+    // mapped as RAM in place; a partial one is copied over the current RAM.
+    cpu::ImageFile::Summary memory_load(const std::string& filename) {
+        cpu::ImageFile::Machine machine;
+        cpu::ImageFile::Summary summary = cpu::ImageFile::load(filename, memory, machine);
+        if (summary.mapped) image_base = memory.shared_image();
+        if (mmu) mmu->remap(memory);
+        control_unit.flush_code();
+        if (summary.has_registers) {
+            gprs = machine.gprs;
+            sprs = machine.sprs;
+            program_start = machine.program_start;
+            control_unit.restore_state(machine.cycle_count, machine.halted);
+        }
+        restart_devices();
+        running = false;
+        state_changed();
+        return summary;
     }
 };
 
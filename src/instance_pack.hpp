@@ -0,0 +1,176 @@
+#pragma once
+
+#include "cpu/registers.hpp"
+#include "cpu/bus.hpp"
+#include "cpu/memory.hpp"
+#include "cpu/control_unit.hpp"
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <unistd.h>
+#endif
+
+namespace emulator {
+
+// Many small guests that share one read-only program image
+// An instance is a page table, registers and counters; its RAM maps the
+// image and gains a private 256-byte page only where the program stores.
+// One ControlUnit runs the instances in turn, dropping its decoded code
+// between them, so an instance costs its written pages plus a fixed
+// page-table-sized overhead.
+class InstancePack {
+public:
+    struct Instance {
+        cpu::Memory memory;
+        cpu::GPRs gprs;
+        cpu::SPRs sprs;
+        uint64_t cycles = 0;
+        bool halted = false;
+
+        explicit Instance(const cpu::Memory::SharedImage& image) : memory(image) {}
+    };
+
+private:
+    // Counts console lines; 100k guests printing to std::cout would drown the report
+    class LineCounter : public cpu::Memory::OutputSink {
+    public:
+        uint64_t lines = 0;
+        void write_line(const std::string&) override { lines++; }
+    };
+
+    cpu::Memory::SharedImage image;
+    std::vector<Instance> instances;
+    cpu::ControlUnit control_unit;
+    cpu::BusSystem buses;
+    LineCounter console;
+    uint64_t instructions = 0;
+    double seconds = 0;
+    size_t rss_before = 0;  // Process RSS before any instance existed
+
+    // Resident set size of this process, or 0 where it cannot be read
+    static size_t process_rss() {
+#if defined(__linux__)
+        std::ifstream statm("/proc/self/statm");
+        size_t total = 0, resident = 0;
+        if (statm >> total >> resident) {
+            return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+        }
+#endif
+        return 0;
+    }
+
+public:
+    InstancePack(const std::vector<uint16_t>& program, size_t count, uint16_t start_address = 0x0000) {
+        cpu::Memory staged;
+        staged.load_program(start_address, program);
+        image = staged.share();
+
+        rss_before = process_rss();
+        instances.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            instances.emplace_back(image);
+            instances.back().memory.set_output_sink(&console);
+            instances.back().sprs.PC = start_address;
+        }
+    }
+
+    void set_engine(cpu::Engine engine) { control_unit.set_engine(engine); }
+    void set_lazy_flags(bool enable) { control_unit.set_lazy_flags(enable); }
+
+    // Per-instance inputs, applied before run
+    void set_register(size_t index, int r, int16_t value) {
+        instances[index].gprs[r] = value;
+    }
+
+    void write_word(size_t index, uint16_t address, uint16_t value) {
+        instances[index].memory.write_word(address, value);
+    }
+
+    // Run each unhalted instance for at most max_cycles more instructions
+    void run(uint64_t max_cycles) {
+        auto start = std::chrono::steady_clock::now();
+        for (auto& instance : instances) {
+            if (instance.halted) continue;
+            control_unit.flush_code();
+            control_unit.restore_state(instance.cycles, false);
+            instructions += control_unit.run_fast(instance.memory, instance.gprs, instance.sprs, buses,
+                                                  max_cycles);
+            instance.cycles = control_unit.get_cycle_count();
+            instance.halted = control_unit.is_halted();
+            instance.memory.flush_output();
+            // The bitmap is 4KB; keeping it would dwarf the instance
+            instance.memory.clear_code_watch();
+        }
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    size_t size() const { return instances.size(); }
+    const Instance& instance(size_t index) const { return instances[index]; }
+    uint64_t get_instructions() const { return instructions; }
+
+    // Bytes owned by the instances themselves, excluding the shared image
+    size_t resident_bytes() const {
+        size_t total = 0;
+        for (const auto& instance : instances) {
+            total += sizeof(Instance) - sizeof(cpu::Memory) + instance.memory.resident_bytes();
+        }
+        return total;
+    }
+
+    size_t private_pages() const {
+        size_t total = 0;
+        for (const auto& instance : instances) total += instance.memory.private_pages();
+        return total;
+    }
+
+    void print_report(size_t samples = 4) const {
+        size_t count = instances.size();
+        uint64_t halted = 0;
+        for (const auto& instance : instances) halted += instance.halted ? 1 : 0;
+
+        std::cout << "\n=== Instance Pack Results ===" << std::endl;
+        for (size_t i = 0; i < count && i < samples; i++) {
+            const Instance& instance = instances[i];
+            std::cout << "[" << i << "] " << (instance.halted ? "halted" : "budget") << " after "
+                      << instance.cycles << " instructions, PC 0x" << std::hex << std::setw(4)
+                      << std::setfill('0') << instance.sprs.PC << ", regs";
+            for (int r = 0; r < 8; r++) {
+                std::cout << " " << std::setw(4) << static_cast<uint16_t>(instance.gprs[r]);
+            }
+            std::cout << std::dec << std::setfill(' ') << ", " << instance.memory.private_pages()
+                      << " private pages" << std::endl;
+        }
+        if (count > samples) std::cout << "... " << (count - samples) << " more" << std::endl;
+
+        std::cout << "=== Instance Pack Summary ===" << std::endl;
+        std::cout << "Instances: " << count << " sharing one " << cpu::Memory::MEMORY_SIZE << "-byte image ("
+                  << cpu::engine_name(control_unit.get_engine()) << " engine), " << halted << " halted, "
+                  << console.lines << " console lines" << std::endl;
+        std::cout << "Instructions: " << instructions << "  time: " << std::fixed << std::setprecision(3)
+                  << seconds << " s";
+        if (seconds > 0) {
+            std::cout << "  instances/s: " << std::setprecision(0) << (count / seconds)
+                      << "  MIPS: " << std::setprecision(1) << (instructions / seconds / 1e6);
+        }
+        std::cout << std::defaultfloat << std::endl;
+        if (count == 0) return;
+
+        size_t pages = private_pages();
+        std::cout << "Private pages: " << pages << " (" << std::fixed << std::setprecision(2)
+                  << static_cast<double>(pages) / count << " per instance)" << std::endl;
+        std::cout << "Resident bytes per instance: " << std::setprecision(0)
+                  << static_cast<double>(resident_bytes()) / count << " accounted";
+        size_t rss = process_rss();
+        if (rss > rss_before && rss_before > 0) {
+            std::cout << ", " << static_cast<double>(rss - rss_before) / count << " by process RSS";
+        }
+        std::cout << std::defaultfloat << std::endl;
+    }
+};
+
+} // namespace emulator
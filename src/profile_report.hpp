@@ -0,0 +1,216 @@
+#pragma once
+
+#include "assembler.hpp"
+#include "cpu/profiler.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace emulator {
+
+// An address range named after the label that starts it
+struct LabelRange {
+    std::string label;     // "(none)" before the first label, "(outside)" after the program
+    uint16_t start;
+    uint32_t end;          // Exclusive
+};
+
+// The program's label ranges in address order, covering all of memory.
+// Labels sharing an address are joined, and the last one ends with the
+// program.
+inline std::vector<LabelRange> label_ranges(const std::map<std::string, uint16_t>& label_map,
+                                            const std::vector<assembler::SourceLine>& source_lines) {
+    std::vector<LabelRange> ranges;
+    std::map<uint16_t, std::string> by_address;
+    for (const auto& entry : label_map) {
+        std::string& name = by_address[entry.second];
+        name += (name.empty() ? "" : "/") + entry.first;
+    }
+    size_t program_end = source_lines.size() * 2;
+    if (program_end < cpu::Memory::MEMORY_SIZE && !by_address.count(static_cast<uint16_t>(program_end))) {
+        by_address[static_cast<uint16_t>(program_end)] = "(outside)";
+    }
+    if (by_address.empty() || by_address.begin()->first != 0) ranges.push_back({"(none)", 0, 0});
+    for (const auto& entry : by_address) ranges.push_back({entry.second, entry.first, 0});
+    for (size_t i = 0; i < ranges.size(); i++) {
+        ranges[i].end = i + 1 < ranges.size() ? ranges[i + 1].start : cpu::Memory::MEMORY_SIZE;
+    }
+    return ranges;
+}
+
+// Profiler counts matched up with the program's labels and source lines
+// A label covers the addresses from it up to the next label. Instructions
+// outside the assembled program (code copied or jumped to elsewhere) are
+// reported by address with no source line.
+class ProfileReport {
+public:
+    struct LabelRow {
+        std::string label;     // "(none)" before the first label, "(outside)" after the program
+        uint16_t start;
+        uint32_t end;          // Exclusive
+        uint64_t count;
+    };
+
+    struct LineRow {
+        uint16_t pc;
+        int line;              // 0 = outside the program
+        std::string text;
+        std::string label;
+        uint64_t count;
+        uint64_t taken;        // Jumps only
+        uint64_t not_taken;
+    };
+
+private:
+    uint64_t total;
+    uint64_t opcodes[16];
+    std::vector<LabelRow> labels;   // Hottest first
+    std::vector<LineRow> lines;     // Hottest first
+
+    static double percent(uint64_t part, uint64_t whole) {
+        return whole ? 100.0 * static_cast<double>(part) / static_cast<double>(whole) : 0.0;
+    }
+
+    static std::string json_string(const std::string& text) {
+        std::string out = "\"";
+        for (char c : text) {
+            if (c == '"' || c == '\\') {
+                out += '\\';
+                out += c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[8];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out += escaped;
+            } else {
+                out += c;
+            }
+        }
+        return out + "\"";
+    }
+
+public:
+    ProfileReport(const cpu::Profiler& profiler, const std::map<std::string, uint16_t>& label_map,
+                  const std::vector<assembler::SourceLine>& source_lines)
+        : total(profiler.get_total()) {
+        for (int op = 0; op < 16; op++) opcodes[op] = profiler.get_opcode(static_cast<cpu::Opcode>(op));
+
+        std::vector<LabelRow> ranges;
+        for (const LabelRange& range : label_ranges(label_map, source_lines)) {
+            ranges.push_back({range.label, range.start, range.end, 0});
+        }
+
+        size_t range = 0;
+        for (uint32_t pc = 0; pc < cpu::Memory::MEMORY_SIZE; pc++) {
+            while (pc >= ranges[range].end) range++;
+            uint64_t count = profiler.get_executions(static_cast<uint16_t>(pc));
+            if (count == 0) continue;
+            ranges[range].count += count;
+            LineRow row{static_cast<uint16_t>(pc), 0, "", ranges[range].label, count,
+                        profiler.get_taken(static_cast<uint16_t>(pc)), profiler.get_not_taken(static_cast<uint16_t>(pc))};
+            if (pc % 2 == 0 && pc / 2 < source_lines.size()) {
+                row.line = source_lines[pc / 2].number;
+                row.text = source_lines[pc / 2].text;
+            }
+            lines.push_back(row);
+        }
+        for (const LabelRow& row : ranges) {
+            if (row.count > 0) labels.push_back(row);
+        }
+        std::stable_sort(labels.begin(), labels.end(),
+                         [](const LabelRow& a, const LabelRow& b) { return a.count > b.count; });
+        std::stable_sort(lines.begin(), lines.end(),
+                         [](const LineRow& a, const LineRow& b) { return a.count > b.count; });
+    }
+
+    const std::vector<LabelRow>& get_labels() const { return labels; }
+    const std::vector<LineRow>& get_lines() const { return lines; }
+
+    // Opcode mix, every label, and the top hottest lines and jumps
+    void print(size_t top = 10) const {
+        std::cout << "\n=== Profile ===" << std::endl;
+        std::cout << "Instructions: " << total << std::endl;
+        std::cout << std::fixed << std::setprecision(1) << std::setfill(' ');
+
+        std::cout << "By opcode:" << std::endl;
+        for (int op = 0; op < 16; op++) {
+            if (opcodes[op] == 0) continue;
+            std::cout << "  " << std::left << std::setw(5) << cpu::opcode_name(static_cast<cpu::Opcode>(op))
+                      << std::right << std::setw(14) << opcodes[op] << std::setw(7) << percent(opcodes[op], total)
+                      << "%" << std::endl;
+        }
+
+        std::cout << "By label:" << std::endl;
+        for (const LabelRow& row : labels) {
+            std::cout << "  " << std::left << std::setw(16) << row.label << std::right << " 0x" << std::hex
+                      << std::setw(4) << std::setfill('0') << row.start << "-0x" << std::setw(4) << (row.end - 1)
+                      << std::dec << std::setfill(' ') << std::setw(14) << row.count << std::setw(7)
+                      << percent(row.count, total) << "%" << std::endl;
+        }
+
+        std::cout << "Hot lines (top " << std::min(top, lines.size()) << "):" << std::endl;
+        for (size_t i = 0; i < lines.size() && i < top; i++) {
+            const LineRow& row = lines[i];
+            std::cout << "  0x" << std::hex << std::setw(4) << std::setfill('0') << row.pc << std::dec
+                      << std::setfill(' ') << "  line " << std::setw(4) << row.line << "  " << std::left
+                      << std::setw(22) << (row.line ? row.text : "?") << std::right << std::setw(14) << row.count
+                      << std::setw(7) << percent(row.count, total) << "%" << std::endl;
+        }
+
+        std::cout << "Jumps (top " << top << " by executions):" << std::endl;
+        size_t shown = 0;
+        for (const LineRow& row : lines) {
+            if (shown == top) break;
+            if (row.taken + row.not_taken == 0) continue;
+            std::cout << "  0x" << std::hex << std::setw(4) << std::setfill('0') << row.pc << std::dec
+                      << std::setfill(' ') << "  line " << std::setw(4) << row.line << "  " << std::left
+                      << std::setw(22) << (row.line ? row.text : "?") << std::right << " taken " << row.taken
+                      << ", not taken " << row.not_taken << " (" << percent(row.taken, row.taken + row.not_taken)
+                      << "% taken)" << std::endl;
+            shown++;
+        }
+        std::cout << std::defaultfloat;
+    }
+
+    // Every label and every executed line; throws std::runtime_error if the
+    // file cannot be written
+    void write_json(const std::string& filename) const {
+        std::ofstream out(filename);
+        if (!out) throw std::runtime_error("Cannot write profile: " + filename);
+        out << "{\n  \"instructions\": " << total << ",\n  \"opcodes\": {";
+        bool first = true;
+        for (int op = 0; op < 16; op++) {
+            if (opcodes[op] == 0) continue;
+            out << (first ? "" : ",") << "\n    " << json_string(cpu::opcode_name(static_cast<cpu::Opcode>(op)))
+                << ": " << opcodes[op];
+            first = false;
+        }
+        out << (first ? "" : "\n  ") << "},\n  \"labels\": [";
+        for (size_t i = 0; i < labels.size(); i++) {
+            const LabelRow& row = labels[i];
+            out << (i ? "," : "") << "\n    {\"label\": " << json_string(row.label) << ", \"start\": " << row.start
+                << ", \"end\": " << row.end << ", \"count\": " << row.count << "}";
+        }
+        out << (labels.empty() ? "" : "\n  ") << "],\n  \"lines\": [";
+        for (size_t i = 0; i < lines.size(); i++) {
+            const LineRow& row = lines[i];
+            out << (i ? "," : "") << "\n    {\"pc\": " << row.pc << ", \"line\": " << row.line
+                << ", \"text\": " << json_string(row.text) << ", \"label\": " << json_string(row.label)
+                << ", \"count\": " << row.count;
+            if (row.taken + row.not_taken > 0) {
+                out << ", \"taken\": " << row.taken << ", \"not_taken\": " << row.not_taken;
+            }
+            out << "}";
+        }
+        out << (lines.empty() ? "" : "\n  ") << "]\n}\n";
+        if (!out) throw std::runtime_error("Cannot write profile: " + filename);
+    }
+};
+
+} // namespace emulator
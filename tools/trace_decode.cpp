@@ -0,0 +1,154 @@
+// Binary trace decoder
+// Renders a trace recorded with --trace-file or 'trace file' in the same
+// text format as 'trace on', so the two can be compared line for line.
+//   make trace_decode
+//   ./trace_decode run.trace [--states] [--summary]
+#include "../src/cpu/trace.hpp"
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Where a taken jump went: the same base rule as the control unit
+uint16_t jump_target(const cpu::TraceReader::Record& record) {
+    int16_t base = record.before[record.instr.rs1];
+    uint16_t from = base == 0 ? static_cast<uint16_t>(record.pc + 2) : static_cast<uint16_t>(base);
+    return static_cast<uint16_t>(from + record.instr.imm);
+}
+
+// The [EXECUTE] line of 'trace on' for one instruction (empty for NOP and NOT)
+void print_execute(std::ostream& out, const cpu::TraceReader::Record& record) {
+    using cpu::Opcode;
+    const cpu::Instruction& instr = record.instr;
+    const int rd = instr.rd;
+    const int16_t value = static_cast<int16_t>(record.value);
+    switch (instr.opcode) {
+        case Opcode::ADD:
+        case Opcode::SUB:
+        case Opcode::AND:
+        case Opcode::OR:
+        case Opcode::XOR: {
+            int16_t operand = instr.is_immediate ? instr.imm : record.before[instr.rs2];
+            out << "[EXECUTE] R" << rd << " = " << record.before[instr.rs1] << " op " << operand << " = "
+                << value << '\n';
+            break;
+        }
+        case Opcode::SHL:
+        case Opcode::SHR:
+            out << "[EXECUTE] R" << rd << " = R" << static_cast<int>(instr.rs1) << " shift "
+                << static_cast<int>(instr.imm) << '\n';
+            break;
+        case Opcode::LDI:
+            out << "[EXECUTE] R" << rd << " = " << static_cast<int>(instr.imm) << '\n';
+            break;
+        case Opcode::LD:
+            out << "[EXECUTE] R" << rd << " = MEM[0x" << std::hex << record.address << "] = " << std::dec << value
+                << '\n';
+            break;
+        case Opcode::ST:
+            out << "[EXECUTE] MEM[0x" << std::hex << record.address << "] = R" << std::dec << rd << " = "
+                << value << '\n';
+            break;
+        case Opcode::JMP:
+            out << "[EXECUTE] Jump to 0x" << std::hex << jump_target(record) << std::dec << '\n';
+            break;
+        case Opcode::JZ:
+            if (record.taken) {
+                out << "[EXECUTE] Jump (Z=1) to 0x" << std::hex << jump_target(record) << std::dec << '\n';
+            } else {
+                out << "[EXECUTE] Jump skipped (Z=0)" << '\n';
+            }
+            break;
+        case Opcode::JNZ:
+            if (record.taken) {
+                out << "[EXECUTE] Jump (Z=0) to 0x" << std::hex << jump_target(record) << std::dec << '\n';
+            } else {
+                out << "[EXECUTE] Jump skipped (Z=1)" << '\n';
+            }
+            break;
+        case Opcode::HLT:
+            out << "[EXECUTE] HALT" << '\n';
+            break;
+        default:
+            break;
+    }
+}
+
+void print_hex4(std::ostream& out, const char* label, uint16_t value) {
+    out << label << std::hex << std::setw(4) << std::setfill('0') << value << std::dec << '\n';
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string path;
+    bool show_states = false;
+    bool summary = false;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--states") {
+            show_states = true;
+        } else if (arg == "--summary") {
+            summary = true;
+        } else if (path.empty() && arg.rfind("--", 0) != 0) {
+            path = arg;
+        } else {
+            path.clear();
+            break;
+        }
+    }
+    if (path.empty()) {
+        std::cerr << "Usage: " << argv[0] << " <trace> [--states] [--summary]" << std::endl;
+        std::cerr << "  --states   Also print the register state records (interrupts, WFI, restores)" << std::endl;
+        std::cerr << "  --summary  Print only record counts" << std::endl;
+        return 1;
+    }
+
+    std::ios::sync_with_stdio(false);
+    std::ostream& out = std::cout;
+    // Mnemonics are built once per distinct instruction word
+    std::vector<std::string> mnemonics(65536);
+    uint64_t steps = 0;
+    uint64_t states = 0;
+    try {
+        cpu::TraceReader reader(path);
+        cpu::TraceReader::Record record;
+        while (reader.next(record)) {
+            if (record.is_state) {
+                states++;
+                if (show_states && !summary) {
+                    out << "\n=== State at cycle " << record.cycle << " ===" << '\n';
+                    print_hex4(out, "PC: 0x", record.pc);
+                    out << "Flags: 0x" << std::hex << static_cast<int>(record.flags) << std::dec;
+                    for (int r = 0; r < 8; r++) out << " R" << r << '=' << record.before[r];
+                    out << '\n';
+                }
+                continue;
+            }
+            steps++;
+            if (summary) continue;
+            out << "\n=== Cycle " << record.cycle << " ===" << '\n';
+            print_hex4(out, "PC: 0x", record.pc);
+            print_hex4(out, "[FETCH] Instruction at PC: 0x", record.word);
+            std::string& mnemonic = mnemonics[record.word];
+            if (mnemonic.empty()) mnemonic = record.instr.mnemonic();
+            out << "[DECODE] " << mnemonic << '\n';
+            print_execute(out, record);
+            if (record.instr.opcode == cpu::Opcode::HLT) continue;
+            uint16_t next_pc = record.taken ? jump_target(record) : static_cast<uint16_t>(record.pc + 2);
+            print_hex4(out, "[STORE] PC updated to 0x", next_pc);
+        }
+        if (summary) {
+            out << path << ": " << (reader.is_delta() ? "delta" : "raw") << " trace, " << steps << " instructions, "
+                << states << " state records" << '\n';
+        }
+    } catch (const std::exception& e) {
+        out.flush();
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}